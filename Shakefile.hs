@@ -668,6 +668,16 @@ main = do
                 removeFilesAfter "." [bldDir]
                 putNormal "All clean.\n"
 
+            -- Checks that the parallel model import gives the same bytes as the serial one
+            "check" ~> do
+                need [mainTgt]
+                cmd mainTgt ["--check-import"] :: Action ()
+
+            -- Times the AABB tree against brute force, up to 100k objects
+            "bench" ~> do
+                need [mainTgt]
+                cmd mainTgt ["--bench-aabb-tree"] :: Action ()
+
             mainTgt %> \out -> do
                 -- Initial banner
                 need ["banner"]
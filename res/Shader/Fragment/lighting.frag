@@ -1,8 +1,17 @@
 #version 330 core
+// Variants (see ShaderVariants): NR_POINT_LIGHTS, HAS_SPECULAR_MAP, ALPHA_TEST
+#ifndef NR_POINT_LIGHTS
+#define NR_POINT_LIGHTS 2
+#endif
+
 struct Material
 {
-    sampler2D texture_diffuse1;
-    sampler2D texture_specular1;
+    sampler2DArray texture_diffuse1;
+    int texture_diffuse1_layer;
+#ifdef HAS_SPECULAR_MAP
+    sampler2DArray texture_specular1;
+    int texture_specular1_layer;
+#endif
     float shininess;
 };
 /* Note: because we now use a material struct again you want to change your
@@ -12,17 +21,24 @@ texture_diffuseN. */
 struct PointLight
 {
     vec3 position;
-
     float constant;
-    float linear;
-    float quadratic;
-
     vec3 ambient;
+    float linear;
     vec3 diffuse;
+    float quadratic;
     vec3 specular;
 };
 
-#define NR_POINT_LIGHTS 2
+#define MAX_POINT_LIGHTS 2
+
+// Camera and lights every shader shares (see FrameUniforms)
+layout(std140) uniform Frame
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    PointLight pointLights[MAX_POINT_LIGHTS];
+};
 
 in vec3 fragPosition;
 in vec3 Normal;
@@ -30,44 +46,54 @@ in vec2 TexCoords;
 
 out vec4 color;
 
-uniform vec3 viewPos;
-uniform PointLight pointLights[NR_POINT_LIGHTS];
 uniform Material material;
 
 // Function prototypes
-vec4 CalcPointLight(PointLight light, Material mat, vec3 normal, vec3 fragPos, vec3 viewDir);
+vec4 CalcPointLight(PointLight light, vec4 diffuseColor, vec4 specularColor, vec3 normal, vec3 fragPos, vec3 viewDir);
 
 void main()
 {
-    vec4 result;
+    // Sample the maps once, every light uses them
+    vec4 diffuseColor = texture(material.texture_diffuse1, vec3(TexCoords, material.texture_diffuse1_layer));
+#ifdef ALPHA_TEST
+    if(diffuseColor.a < 0.1)
+        discard;
+#endif
+#ifdef HAS_SPECULAR_MAP
+    vec4 specularColor = texture(material.texture_specular1, vec3(TexCoords, material.texture_specular1_layer));
+#else
+    vec4 specularColor = vec4(0.0);
+#endif
+
+    vec4 result = vec4(0.0);
     vec3 viewDir = normalize(viewPos - fragPosition);
     vec3 norm = normalize(Normal);
 
     for(int i = 0; i < NR_POINT_LIGHTS; i++)
-        result += CalcPointLight(pointLights[i], material, norm, fragPosition, viewDir);
+        result += CalcPointLight(pointLights[i], diffuseColor, specularColor, norm, fragPosition, viewDir);
 
     color = result;
 }
 
 
 // Calculates the color when using a point light.
-vec4 CalcPointLight(PointLight light, Material mat, vec3 normal, vec3 fragPos, vec3 viewDir)
+vec4 CalcPointLight(PointLight light, vec4 diffuseColor, vec4 specularColor, vec3 normal, vec3 fragPos, vec3 viewDir)
 {
     vec3 lightDir = normalize(light.position - fragPos);
     // Diffuse shading
     float diff = max(dot(normal, lightDir), 0.0);
-    // Specular shading
-    vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), mat.shininess);
     // Attenuation
     float distance = length(light.position - fragPos);
     float attenuation = 1.0f / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
     // Combine results
-    vec4 ambient = vec4(light.ambient, 1.0f)          * texture(mat.texture_diffuse1, TexCoords);
-    vec4 diffuse = vec4(light.diffuse * diff, 1.0f)   * texture(mat.texture_diffuse1, TexCoords);
-    vec4 specular = vec4(light.specular * spec, 1.0f) * texture(mat.texture_specular1, TexCoords);
-    ambient *= attenuation;
-    diffuse *= attenuation;
-    specular *= attenuation;
-    return (ambient + diffuse + specular);
+    vec4 ambient = vec4(light.ambient, 1.0f)          * diffuseColor;
+    vec4 diffuse = vec4(light.diffuse * diff, 1.0f)   * diffuseColor;
+    vec4 result = ambient + diffuse;
+#ifdef HAS_SPECULAR_MAP
+    // Specular shading
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+    result += vec4(light.specular * spec, 1.0f) * specularColor;
+#endif
+    return result * attenuation;
 }
\ No newline at end of file
@@ -3,11 +3,12 @@ in vec2 TexCoord;
 
 out vec4 color;
 
-uniform sampler2D ourTexture;
+uniform sampler2DArray ourTexture;
+uniform int ourTextureLayer;
 
 void main()
 {
-    vec4 texColor = texture(ourTexture, TexCoord);
+    vec4 texColor = texture(ourTexture, vec3(TexCoord, ourTextureLayer));
     if(texColor.a < 0.1)
         discard;
     color = texColor;
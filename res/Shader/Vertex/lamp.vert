@@ -1,11 +1,35 @@
 #version 330 core
 layout(location = 0) in vec3 position;
 
+#ifdef INSTANCED
+layout(location = 3) in mat4 instanceModel;   // Per instance (see ModelInstanceSet)
+#else
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#endif
+
+// Camera, the start of the Frame block every shader shares (see FrameUniforms)
+layout(std140) uniform Frame
+{
+    mat4 view;
+    mat4 projection;
+};
+
+#ifdef COMPACT_VERTICES
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+#endif
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(position, 1.0f);
+#ifdef INSTANCED
+    mat4 model = instanceModel;
+#endif
+
+#ifdef COMPACT_VERTICES
+    vec3 objPosition = position * positionScale + positionOffset;
+#else
+    vec3 objPosition = position;
+#endif
+
+    gl_Position = projection * view * model * vec4(objPosition, 1.0f);
 }
\ No newline at end of file
@@ -1,20 +1,78 @@
 #version 330 core
 layout(location = 0) in vec3 position;
+#ifdef COMPACT_VERTICES
+layout(location = 1) in vec2 normal;    // Octahedral encoded
+#else
 layout(location = 1) in vec3 normal;
+#endif
 layout(location = 2) in vec2 texCoords;
 
 out vec2 TexCoords;
 out vec3 fragPosition;
 out vec3 Normal;
 
+#ifdef INSTANCED
+layout(location = 3) in mat4 instanceModel;   // Per instance (see ModelInstanceSet)
+layout(location = 7) in mat3 instanceNormal;  // Transposed inverse of instanceModel
+#else
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#endif
+
+struct PointLight
+{
+    vec3 position;
+    float constant;
+    vec3 ambient;
+    float linear;
+    vec3 diffuse;
+    float quadratic;
+    vec3 specular;
+};
+
+#define MAX_POINT_LIGHTS 2
+
+// Camera and lights every shader shares (see FrameUniforms)
+layout(std140) uniform Frame
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    PointLight pointLights[MAX_POINT_LIGHTS];
+};
+
+#ifdef COMPACT_VERTICES
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+
+vec3 OctahedralDecode(vec2 e)
+{
+    vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += (n.x >= 0.0) ? -t : t;
+    n.y += (n.y >= 0.0) ? -t : t;
+    return normalize(n);
+}
+#endif
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(position, 1.0f);
-    fragPosition = vec3(model * vec4(position, 1.0f));
-    Normal = mat3(transpose(inverse(model))) * normal;
+#ifdef INSTANCED
+    mat4 model = instanceModel;
+    mat3 normalMatrix = instanceNormal;
+#else
+    mat3 normalMatrix = mat3(transpose(inverse(model)));
+#endif
+
+#ifdef COMPACT_VERTICES
+    vec3 objPosition = position * positionScale + positionOffset;
+    vec3 objNormal = OctahedralDecode(normal);
+#else
+    vec3 objPosition = position;
+    vec3 objNormal = normal;
+#endif
+
+    gl_Position = projection * view * model * vec4(objPosition, 1.0f);
+    fragPosition = vec3(model * vec4(objPosition, 1.0f));
+    Normal = normalMatrix * objNormal;
     TexCoords = texCoords;
 }
\ No newline at end of file
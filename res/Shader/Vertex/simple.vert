@@ -4,7 +4,14 @@ layout (location = 1) in vec2 texCoord;
 
 out vec2 TexCoord;
 
-uniform mat4 model, view, projection;
+uniform mat4 model;
+
+// Camera, the start of the Frame block every shader shares (see FrameUniforms)
+layout(std140) uniform Frame
+{
+    mat4 view;
+    mat4 projection;
+};
 
 void main()
 {
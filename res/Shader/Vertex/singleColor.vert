@@ -1,16 +1,31 @@
 #version 330 core
 layout(location = 0) in vec3 position;
-layout(location = 1) in vec3 normal;
 layout(location = 2) in vec2 texCoords;
 
 out vec2 TexCoords;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+// Camera, the start of the Frame block every shader shares (see FrameUniforms)
+layout(std140) uniform Frame
+{
+    mat4 view;
+    mat4 projection;
+};
+
+#ifdef COMPACT_VERTICES
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+#endif
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(position, 1.0f);
+#ifdef COMPACT_VERTICES
+    vec3 objPosition = position * positionScale + positionOffset;
+#else
+    vec3 objPosition = position;
+#endif
+
+    gl_Position = projection * view * model * vec4(objPosition, 1.0f);
     TexCoords = texCoords;
 }
\ No newline at end of file
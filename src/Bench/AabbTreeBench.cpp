@@ -0,0 +1,256 @@
+#include "AabbTreeBench.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "../Util/WarnGuard.hpp"
+WARN_GUARD_ON
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+WARN_GUARD_OFF
+
+#include "../Render/AabbTree.hpp"
+#include "../Render/Frustum.hpp"
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    /// Object counts timed, the last one is what the tree has to hold
+    const std::size_t ObjectCounts[] = { 1000, 10000, 100000 };
+
+    /// Space per object. The world grows with the count, so the density stays the same
+    const float VolumePerObject = 64.0f;
+
+    /// Queries timed per count, results are averaged
+    const int FrustumQueries = 100;
+    const int RayCasts = 1000;
+
+    /// Farthest the frustums and the rays reach
+    const float ViewDistance = 50.0f;
+
+    /// Distance moves that leave the fat boxes go
+    const float FarMove = 2.0f;
+
+    /// Fixed, so runs can be compared
+    const std::uint32_t Seed = 2016;
+
+    /// A test object
+    struct Object
+    {
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+        std::int32_t proxy;
+    };
+
+    double MillisecondsSince(Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    /// Copy of the test QueryFrustum does on a box, not an independent check of it
+    bool BoxInFrustum(const Frustum& frustum, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+    {
+        const glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+        const glm::vec3 extents = (boundsMax - boundsMin) * 0.5f;
+        for(const glm::vec4& plane : frustum.planes)
+        {
+            const float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+            const float reach = glm::dot(glm::abs(glm::vec3(plane)), extents);
+            if(distance + reach < 0.0f)
+                return false;
+        }
+        return true;
+    }
+
+    /// Copy of the slab test RayCast does on a box, not an independent check of it. Negative if the ray misses it
+    float RayEnter(const glm::vec3& origin, const glm::vec3& invDirection, float maxDistance, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+    {
+        const glm::vec3 t1 = (boundsMin - origin) * invDirection;
+        const glm::vec3 t2 = (boundsMax - origin) * invDirection;
+        const glm::vec3 closer = glm::min(t1, t2);
+        const glm::vec3 further = glm::max(t1, t2);
+        const float enter = std::max(std::max(closer.x, closer.y), std::max(closer.z, 0.0f));
+        const float exit = std::min(std::min(further.x, further.y), std::min(further.z, maxDistance));
+        return enter <= exit ? enter : -1.0f;
+    }
+
+    /// A random unit vector
+    glm::vec3 RandomDirection(std::mt19937& random)
+    {
+        std::normal_distribution<float> normal;
+        glm::vec3 direction;
+        do
+            direction = glm::vec3(normal(random), normal(random), normal(random));
+        while(glm::dot(direction, direction) < 1e-6f);
+        return glm::normalize(direction);
+    }
+
+    /// Times every case for given object count. Returns false if a query differs from brute force
+    bool Run(std::size_t count, std::mt19937& random)
+    {
+        const float worldSize = std::cbrt(VolumePerObject * (float)count);
+        std::uniform_real_distribution<float> position(0.0f, worldSize);
+        std::uniform_real_distribution<float> size(0.1f, 1.0f);
+        std::uniform_real_distribution<float> nearMove(-0.5f * AabbTree::Margin, 0.5f * AabbTree::Margin);
+        std::uniform_real_distribution<float> farMove(-FarMove, FarMove);
+
+        std::vector<Object> objects(count);
+        for(Object& object : objects)
+        {
+            object.boundsMin = glm::vec3(position(random), position(random), position(random));
+            object.boundsMax = object.boundsMin + glm::vec3(size(random), size(random), size(random));
+        }
+
+        // Build
+        AabbTree tree;
+        Clock::time_point start = Clock::now();
+        for(Object& object : objects)
+            object.proxy = tree.CreateProxy(object.boundsMin, object.boundsMax, &object);
+        const double buildMs = MillisecondsSince(start);
+
+        // Moves that stay inside the fat boxes, then moves that mostly reinsert
+        std::vector<glm::vec3> offsets(count);
+        for(glm::vec3& offset : offsets)
+            offset = glm::vec3(nearMove(random), nearMove(random), nearMove(random));
+
+        start = Clock::now();
+        for(std::size_t i = 0; i < count; i++)
+            tree.MoveProxy(objects[i].proxy, objects[i].boundsMin + offsets[i], objects[i].boundsMax + offsets[i]);
+        const double nearMoveMs = MillisecondsSince(start);
+
+        for(std::size_t i = 0; i < count; i++)
+        {
+            objects[i].boundsMin += offsets[i];
+            objects[i].boundsMax += offsets[i];
+            offsets[i] = glm::vec3(farMove(random), farMove(random), farMove(random));
+        }
+
+        std::size_t reinserted = 0;
+        start = Clock::now();
+        for(std::size_t i = 0; i < count; i++)
+            reinserted += tree.MoveProxy(objects[i].proxy, objects[i].boundsMin + offsets[i], objects[i].boundsMax + offsets[i]) ? 1 : 0;
+        const double farMoveMs = MillisecondsSince(start);
+
+        for(std::size_t i = 0; i < count; i++)
+        {
+            objects[i].boundsMin += offsets[i];
+            objects[i].boundsMax += offsets[i];
+        }
+
+        // The queries report fat boxes, brute force tests the same ones
+        std::vector<glm::vec3> fatMin(count), fatMax(count);
+        for(std::size_t i = 0; i < count; i++)
+            tree.GetFatBounds(objects[i].proxy, fatMin[i], fatMax[i]);
+
+        bool match = true;
+
+        // Frustums from random points of the world, looking in random directions
+        const glm::mat4 proj = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, ViewDistance);
+        std::vector<Frustum> frustums(FrustumQueries);
+        for(Frustum& frustum : frustums)
+        {
+            const glm::vec3 eye(position(random), position(random), position(random));
+            const glm::vec3 forward = RandomDirection(random);
+            const glm::vec3 up = std::abs(forward.y) < 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+            frustum = Frustum::FromMatrix(proj * glm::lookAt(eye, eye + forward, up));
+        }
+
+        std::vector<std::vector<std::int32_t>> treeFound(FrustumQueries), bruteFound(FrustumQueries);
+        start = Clock::now();
+        for(int q = 0; q < FrustumQueries; q++)
+        {
+            std::vector<std::int32_t>& found = treeFound[q];
+            tree.QueryFrustum(frustums[q], [&found](std::int32_t proxy) { found.push_back(proxy); return true; });
+        }
+        const double frustumMs = MillisecondsSince(start) / FrustumQueries;
+
+        start = Clock::now();
+        for(int q = 0; q < FrustumQueries; q++)
+        {
+            for(std::size_t i = 0; i < count; i++)
+            {
+                if(BoxInFrustum(frustums[q], fatMin[i], fatMax[i]))
+                    bruteFound[q].push_back(objects[i].proxy);
+            }
+        }
+        const double bruteFrustumMs = MillisecondsSince(start) / FrustumQueries;
+
+        std::size_t frustumObjects = 0;
+        for(int q = 0; q < FrustumQueries; q++)
+        {
+            std::sort(treeFound[q].begin(), treeFound[q].end());
+            std::sort(bruteFound[q].begin(), bruteFound[q].end());
+            match = match && treeFound[q] == bruteFound[q];
+            frustumObjects += treeFound[q].size();
+        }
+
+        // Rays from random points, the hit is where they enter the closest fat box
+        std::vector<glm::vec3> origins(RayCasts), directions(RayCasts);
+        for(int r = 0; r < RayCasts; r++)
+        {
+            origins[r] = glm::vec3(position(random), position(random), position(random));
+            directions[r] = RandomDirection(random);
+        }
+
+        std::vector<float> treeHits(RayCasts), bruteHits(RayCasts);
+        start = Clock::now();
+        for(int r = 0; r < RayCasts; r++)
+        {
+            float distance;
+            const std::int32_t hit = tree.RayCast(origins[r], directions[r], ViewDistance, [](std::int32_t, float boxDistance) { return boxDistance; }, distance);
+            treeHits[r] = hit == AabbTree::Null ? -1.0f : distance;
+        }
+        const double rayMs = MillisecondsSince(start) / RayCasts;
+
+        start = Clock::now();
+        for(int r = 0; r < RayCasts; r++)
+        {
+            const glm::vec3 invDirection = 1.0f / directions[r];
+            float closest = -1.0f;
+            for(std::size_t i = 0; i < count; i++)
+            {
+                const float enter = RayEnter(origins[r], invDirection, ViewDistance, fatMin[i], fatMax[i]);
+                if(enter >= 0.0f && (closest < 0.0f || enter < closest))
+                    closest = enter;
+            }
+            bruteHits[r] = closest;
+        }
+        const double bruteRayMs = MillisecondsSince(start) / RayCasts;
+
+        match = match && treeHits == bruteHits;
+
+        std::printf("%7zu | %8.2f | %6d | %8.2f | %8.2f (%3.0f%%) | %8.4f / %8.4f (%5zu found) | %8.4f / %8.4f | %s\n",
+            count,
+            buildMs,
+            tree.GetHeight(),
+            nearMoveMs,
+            farMoveMs,
+            100.0 * (double)reinserted / (double)count,
+            frustumMs,
+            bruteFrustumMs,
+            frustumObjects / FrustumQueries,
+            rayMs,
+            bruteRayMs,
+            match ? "yes" : "NO");
+        return match;
+    }
+}
+
+int RunAabbTreeBench()
+{
+    std::mt19937 random(Seed);
+    bool match = true;
+
+    std::printf("Times in ms. Moves are of every object, queries are per query, tree / brute force\n");
+    std::printf("%7s | %8s | %6s | %8s | %15s | %32s | %19s | %s\n",
+        "objects", "build", "height", "in place", "reinserting", "frustum (average found)", "ray", "match");
+    for(std::size_t count : ObjectCounts)
+        match = Run(count, random) && match;
+
+    return match ? 0 : 1;
+}
@@ -0,0 +1,12 @@
+#ifndef ELESWORD_AABB_TREE_BENCH_HPP
+#define ELESWORD_AABB_TREE_BENCH_HPP
+
+/// Times AabbTree on random boxes, up to 100k of them: building, moves that stay
+/// in the fat boxes and moves that reinsert, frustum queries and ray casts, the
+/// queries against brute force too. Prints a table and needs no GL context.
+/// Returns 0 if every query found what brute force found, 1 otherwise.
+/// Brute force runs copies of the tree's own box tests, so a match only
+/// vouches for the tree walk, not for the frustum and ray tests themselves
+int RunAabbTreeBench();
+
+#endif //~ ELESWORD_AABB_TREE_BENCH_HPP
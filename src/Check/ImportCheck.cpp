@@ -0,0 +1,329 @@
+#include "ImportCheck.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "../Model/AssimpLoader.hpp"
+#include "../Util/ThreadPool.hpp"
+
+namespace
+{
+    /// Models shipped in res/ that the scene loads
+    const char* const BundledModels[] =
+    {
+        "res/Model/Lamp/lamp.obj",
+        "res/Model/Nanosuit/nanosuit.obj"
+    };
+
+    /// Retrieves the offset of the first byte that differs, or the shorter size if one is a prefix of the other
+    std::size_t FirstMismatch(const std::vector<GLubyte>& a, const std::vector<GLubyte>& b)
+    {
+        const std::size_t size = std::min(a.size(), b.size());
+        for(std::size_t i = 0; i < size; i++)
+        {
+            if(a[i] != b[i])
+                return i;
+        }
+        return size;
+    }
+
+    /// Compares a buffer of the reference with the imported one. Returns true if they match
+    bool CompareBytes(const std::string& what, const std::vector<GLubyte>& reference, const std::vector<GLubyte>& imported)
+    {
+        if(reference.size() == imported.size() && std::memcmp(reference.data(), imported.data(), reference.size()) == 0)
+            return true;
+
+        std::cout << "FAILED::IMPORT_CHECK:: " << what << " differs at byte " << FirstMismatch(reference, imported)
+                  << " (" << reference.size() << " reference, " << imported.size() << " imported bytes)" << std::endl;
+        return false;
+    }
+
+    /// Prints what differs unless equal. Returns equal
+    bool Expect(bool equal, const std::string& what)
+    {
+        if(!equal)
+            std::cout << "FAILED::IMPORT_CHECK:: " << what << " differs" << std::endl;
+        return equal;
+    }
+
+    bool SameMeshlet(const Meshlet& a, const Meshlet& b)
+    {
+        return a.firstIndex == b.firstIndex
+            && a.indexCount == b.indexCount
+            && a.center == b.center
+            && a.radius == b.radius
+            && a.coneApex == b.coneApex
+            && a.coneAxis == b.coneAxis
+            && a.coneCutoff == b.coneCutoff;
+    }
+
+    /// Compares everything Import fills in a mesh but its textures. Returns true if they match
+    bool CompareMesh(const std::string& what, const Mesh& reference, const Mesh& imported)
+    {
+        bool lods = reference.lods.size() == imported.lods.size();
+        for(std::size_t i = 0; lods && i < reference.lods.size(); i++)
+        {
+            lods = reference.lods[i].indexOffset == imported.lods[i].indexOffset
+                && reference.lods[i].indexCount == imported.lods[i].indexCount;
+        }
+
+        bool meshlets = reference.meshlets.size() == imported.meshlets.size();
+        for(std::size_t i = 0; meshlets && i < reference.meshlets.size(); i++)
+            meshlets = SameMeshlet(reference.meshlets[i], imported.meshlets[i]);
+
+        bool match = true;
+        match = Expect(reference.indices == imported.indices, what + " indices") && match;
+        match = Expect(reference.indexOffset == imported.indexOffset, what + " indexOffset") && match;
+        match = Expect(reference.indexCount == imported.indexCount, what + " indexCount") && match;
+        match = Expect(reference.indexType == imported.indexType, what + " indexType") && match;
+        match = Expect(reference.baseVertex == imported.baseVertex, what + " baseVertex") && match;
+        match = Expect(reference.vertexCount == imported.vertexCount, what + " vertexCount") && match;
+        match = Expect(lods, what + " lods") && match;
+        match = Expect(meshlets, what + " meshlets") && match;
+        match = Expect(reference.positionScale == imported.positionScale && reference.positionOffset == imported.positionOffset, what + " position transform") && match;
+        match = Expect(reference.boundsMin == imported.boundsMin && reference.boundsMax == imported.boundsMax, what + " bounding box") && match;
+        match = Expect(reference.boundsCenter == imported.boundsCenter && reference.boundsRadius == imported.boundsRadius, what + " bounding sphere") && match;
+        return match;
+    }
+
+    /// Appends the bytes of an index narrowed to indexType
+    void AppendIndex(GLuint index, GLenum indexType, std::vector<GLubyte>& out)
+    {
+        if(indexType == GL_UNSIGNED_SHORT)
+        {
+            const GLushort narrow = (GLushort)index;
+            out.insert(out.end(), reinterpret_cast<const GLubyte*>(&narrow), reinterpret_cast<const GLubyte*>(&narrow) + sizeof(narrow));
+        }
+        else
+            out.insert(out.end(), reinterpret_cast<const GLubyte*>(&index), reinterpret_cast<const GLubyte*>(&index) + sizeof(index));
+    }
+
+    /// Imports a model the plain way, one mesh and one vertex after the other, appending
+    /// to the streams as it goes. It runs the same optimizer, simplifier and meshlet passes
+    /// as AssimpLoader::Import but none of its prefix sums, slices or chunks
+    bool ImportReference(const std::string& filepath, VertexFormat format, ModelData& model)
+    {
+        Assimp::Importer importer;
+        const aiScene* scene = importer.ReadFile(filepath, AssimpLoader::ImportFlags);
+        if(!scene || scene->mFlags == AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+            return false;
+
+        const GLsizei stride = VertexStride(format);
+        std::vector<GLubyte> vertex(stride);
+        glm::vec3 lo(std::numeric_limits<float>::max());
+        glm::vec3 hi(-std::numeric_limits<float>::max());
+
+        model.format = format;
+        for(unsigned int i = 0, offset = 0; i < scene->mNumMeshes; i++)
+        {
+            const aiMesh* curMesh = scene->mMeshes[i];
+            Mesh newMesh;
+            newMesh.baseVertex = offset;
+            newMesh.vertexCount = curMesh->mNumVertices;
+            offset += curMesh->mNumVertices;
+
+            // Bounds
+            std::vector<glm::vec3> positions;
+            for(unsigned int j = 0; j < curMesh->mNumVertices; j++)
+                positions.push_back(glm::vec3(curMesh->mVertices[j].x, curMesh->mVertices[j].y, curMesh->mVertices[j].z));
+            if(!positions.empty())
+            {
+                newMesh.boundsMin = newMesh.boundsMax = positions[0];
+                for(const glm::vec3& p : positions)
+                {
+                    newMesh.boundsMin = glm::min(newMesh.boundsMin, p);
+                    newMesh.boundsMax = glm::max(newMesh.boundsMax, p);
+                }
+                newMesh.boundsCenter = (newMesh.boundsMin + newMesh.boundsMax) * 0.5f;
+                newMesh.boundsRadius = 0.0f;
+                for(const glm::vec3& p : positions)
+                    newMesh.boundsRadius = std::max(newMesh.boundsRadius, glm::length(p - newMesh.boundsCenter));
+
+                lo = glm::min(lo, newMesh.boundsMin);
+                hi = glm::max(hi, newMesh.boundsMax);
+            }
+            if(format == VertexFormat::Compact)
+            {
+                newMesh.positionOffset = (newMesh.boundsMin + newMesh.boundsMax) * 0.5f;
+                newMesh.positionScale = glm::max((newMesh.boundsMax - newMesh.boundsMin) * 0.5f, glm::vec3(1e-6f));
+            }
+
+            // Indices
+            bool triangles = true;
+            for(GLuint h = 0; h < curMesh->mNumFaces; h++)
+            {
+                const aiFace& face = curMesh->mFaces[h];
+                triangles = triangles && face.mNumIndices == 3;
+                for(GLuint j = 0; j < face.mNumIndices; j++)
+                    newMesh.indices.push_back(face.mIndices[j]);
+            }
+            newMesh.indexCount = (GLsizei)newMesh.indices.size();
+            newMesh.indexType = (format == VertexFormat::Compact && newMesh.vertexCount <= 65536) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+            // Optimized order and LODs, points and lines are left as they are
+            std::vector<GLuint> order;
+            std::vector<std::vector<GLuint>> lods;
+            if(triangles && !newMesh.indices.empty())
+            {
+                const float* source = &curMesh->mVertices[0].x;
+                std::vector<std::size_t> clusters = MeshOptimizer::OptimizeVertexCache(newMesh.indices, newMesh.vertexCount);
+                MeshOptimizer::OptimizeOverdraw(newMesh.indices, clusters, source, sizeof(aiVector3D), newMesh.vertexCount);
+
+                const float meshRadius = glm::length(newMesh.boundsMax - newMesh.boundsMin) * 0.5f;
+                for(unsigned int lod = 1; lod < ModelData::MaxLods; lod++)
+                {
+                    const std::vector<GLuint>& previous = lods.empty() ? newMesh.indices : lods.back();
+                    std::vector<GLuint> simplified = MeshSimplifier::Simplify(
+                        previous,
+                        source,
+                        sizeof(aiVector3D),
+                        newMesh.vertexCount,
+                        previous.size() / 6 * 3,
+                        meshRadius * AssimpLoader::LodBaseError * (float)(1u << (lod - 1)));
+                    if(simplified.empty() || simplified.size() > previous.size() * 9 / 10)
+                        break;
+
+                    MeshOptimizer::OptimizeVertexCache(simplified, newMesh.vertexCount);
+                    lods.push_back(std::move(simplified));
+                }
+
+                newMesh.meshlets = MeshletBuilder::Build(newMesh.indices, source, sizeof(aiVector3D), newMesh.vertexCount);
+                order = MeshOptimizer::OptimizeVertexFetch(newMesh.indices, newMesh.vertexCount);
+
+                std::vector<GLuint> remap(newMesh.vertexCount);
+                for(GLuint v = 0; v < newMesh.vertexCount; v++)
+                    remap[order[v]] = v;
+                for(std::vector<GLuint>& lod : lods)
+                {
+                    for(GLuint& index : lod)
+                        index = remap[index];
+                }
+            }
+            else
+            {
+                for(GLuint v = 0; v < newMesh.vertexCount; v++)
+                    order.push_back(v);
+            }
+
+            // Vertices, one at a time
+            for(GLuint v = 0; v < newMesh.vertexCount; v++)
+            {
+                const GLuint j = order[v];
+                const glm::vec3 normal(curMesh->mNormals[j].x, curMesh->mNormals[j].y, curMesh->mNormals[j].z);
+                glm::vec2 texCoords(0.0f, 0.0f);
+                if(curMesh->HasTextureCoords(0))
+                    texCoords = glm::vec2(curMesh->mTextureCoords[0][j].x, curMesh->mTextureCoords[0][j].y);
+
+                PackVertex(format, positions[j], normal, texCoords, newMesh.positionScale, newMesh.positionOffset, vertex.data());
+                model.data.insert(model.data.end(), vertex.begin(), vertex.end());
+            }
+
+            // Indices of the mesh then of its LODs, the mesh's aligned to its index size
+            const std::size_t indexSize = (std::size_t)IndexTypeSize(newMesh.indexType);
+            while(model.indexData.size() % indexSize != 0)
+                model.indexData.push_back(0);
+
+            newMesh.indexOffset = (GLuint)model.indexData.size();
+            for(GLuint index : newMesh.indices)
+                AppendIndex(index, newMesh.indexType, model.indexData);
+            for(const std::vector<GLuint>& lod : lods)
+            {
+                newMesh.lods.push_back({ (GLuint)model.indexData.size(), (GLsizei)lod.size() });
+                for(GLuint index : lod)
+                    AppendIndex(index, newMesh.indexType, model.indexData);
+            }
+
+            model.lodCount = std::max(model.lodCount, 1 + (unsigned int)newMesh.lods.size());
+            model.meshes.push_back(newMesh);
+        }
+
+        // Bounds of the whole model
+        model.boundsMin = model.boundsMax = model.boundsCenter = glm::vec3(0.0f);
+        model.boundsRadius = 0.0f;
+        if(lo.x <= hi.x)
+        {
+            model.boundsMin = lo;
+            model.boundsMax = hi;
+            model.boundsCenter = (lo + hi) * 0.5f;
+            for(unsigned int i = 0; i < scene->mNumMeshes; i++)
+            {
+                const aiMesh* curMesh = scene->mMeshes[i];
+                for(unsigned int j = 0; j < curMesh->mNumVertices; j++)
+                {
+                    const glm::vec3 p(curMesh->mVertices[j].x, curMesh->mVertices[j].y, curMesh->mVertices[j].z);
+                    model.boundsRadius = std::max(model.boundsRadius, glm::length(p - model.boundsCenter));
+                }
+            }
+        }
+        return true;
+    }
+
+    /// Compares an import with the reference. Returns true if they match
+    bool CompareModel(const std::string& name, const ModelData& reference, const ModelData& imported)
+    {
+        bool match = true;
+        match = CompareBytes(name + " vertex stream", reference.data, imported.data) && match;
+        match = CompareBytes(name + " indices", reference.indexData, imported.indexData) && match;
+        match = Expect(reference.lodCount == imported.lodCount, name + " lodCount") && match;
+        match = Expect(reference.boundsMin == imported.boundsMin && reference.boundsMax == imported.boundsMax, name + " bounding box") && match;
+        match = Expect(reference.boundsCenter == imported.boundsCenter && reference.boundsRadius == imported.boundsRadius, name + " bounding sphere") && match;
+
+        if(!Expect(reference.meshes.size() == imported.meshes.size(), name + " mesh count"))
+            return false;
+        for(std::size_t i = 0; i < reference.meshes.size(); i++)
+            match = CompareMesh(name + " mesh " + std::to_string(i), reference.meshes[i], imported.meshes[i]) && match;
+        return match;
+    }
+}
+
+int RunImportCheck()
+{
+    ThreadPool threadPool;
+    bool passed = true;
+
+    for(VertexFormat format : { VertexFormat::Float, VertexFormat::Compact })
+    {
+        // Import only, no textures are loaded
+        AssimpLoader loader(nullptr, &threadPool, format);
+        const std::string formatName = (format == VertexFormat::Float) ? "float" : "compact";
+
+        for(const char* path : BundledModels)
+        {
+            ModelData reference;
+            if(!ImportReference(path, format, reference))
+            {
+                std::cout << "FAILED::IMPORT_CHECK:: Could not import " << path << std::endl;
+                passed = false;
+                continue;
+            }
+
+            for(bool parallel : { false, true })
+            {
+                const std::string name = std::string(path) + " (" + formatName + (parallel ? ", parallel)" : ", serial)");
+
+                ModelData imported;
+                if(!loader.Import(path, imported, parallel))
+                {
+                    std::cout << "FAILED::IMPORT_CHECK:: Could not import " << name << std::endl;
+                    passed = false;
+                    continue;
+                }
+
+                const bool match = CompareModel(name, reference, imported);
+                if(match)
+                {
+                    std::cout << "PASSED::IMPORT_CHECK:: " << name << ": "
+                              << imported.data.size() << " vertex bytes, "
+                              << imported.indexData.size() << " index bytes, "
+                              << imported.meshes.size() << " meshes" << std::endl;
+                }
+                passed = passed && match;
+            }
+        }
+    }
+
+    return passed ? 0 : 1;
+}
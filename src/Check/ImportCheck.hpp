@@ -0,0 +1,11 @@
+#ifndef ELESWORD_IMPORT_CHECK_HPP
+#define ELESWORD_IMPORT_CHECK_HPP
+
+/// Imports the bundled models serially and on the thread pool, in every vertex
+/// format, and compares both with a plain one vertex at a time reference: the
+/// vertex streams and packed indices byte for byte, then the index ranges, LODs,
+/// meshlets and bounds of every mesh. Needs no GL context. Returns 0 when all of
+/// them match, 1 otherwise
+int RunImportCheck();
+
+#endif //~ ELESWORD_IMPORT_CHECK_HPP
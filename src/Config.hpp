@@ -3,5 +3,6 @@
 
 #define SHADER_TEXTURE_DIFFUSE_PREFIX "texture_diffuse"
 #define SHADER_TEXTURE_SPECULAR_PREFIX "texture_specular"
+#define SHADER_TEXTURE_LAYER_SUFFIX "_layer"
 
 #endif //~ ELESWORD_CONFIG_HPP
\ No newline at end of file
@@ -4,9 +4,12 @@
 #include <Windows.h>
 #endif
 
+#include <algorithm>
+#include <cstdio>
 #include <iostream>
 #include <memory>
 #include <functional>
+#include <string>
 
 #define GLEW_STATIC
 #include <GL/glew.h>
@@ -19,13 +22,26 @@ WARN_GUARD_ON
 #include <glm/gtc/type_ptr.hpp>
 WARN_GUARD_OFF
 
+#include "Bench/AabbTreeBench.hpp"
 #include "Camera.hpp"
+#include "Check/ImportCheck.hpp"
 #include "Movement.hpp"
 #include "Model/Model.hpp"
+#include "Model/ModelInstanceSet.hpp"
 #include "Model/AssimpLoader.hpp"
+#include "Render/AabbTree.hpp"
+#include "Render/FrameUniforms.hpp"
+#include "Render/Frustum.hpp"
+#include "Render/FrustumCuller.hpp"
+#include "Render/GpuCulling.hpp"
+#include "Render/HiZBuffer.hpp"
 #include "Render/Light.hpp"
+#include "Render/RenderQueue.hpp"
 #include "Render/Shader.hpp"
+#include "Render/ShaderBatch.hpp"
+#include "Render/ShaderVariants.hpp"
 #include "Texture/TextureStore.hpp"
+#include "Util/ThreadPool.hpp"
 
 //-----------------------------------------------------
 // Data
@@ -36,11 +52,39 @@ GLsizei width = 800, height = 600;
 
 GLenum polygonMode = GL_FILL;
 
+// Time per frame spent uploading streamed models
+const double UploadBudgetMilliseconds = 2.0;
+
+// Bytes of decoded images uploaded per frame
+const std::size_t TextureUploadBudgetBytes = 4 << 20;
+
+// Texture memory the store evicts unused textures to stay under
+const std::size_t TextureMemoryBudgetBytes = 256 << 20;
+
+// Farthest a click picks a model at
+const float PickDistance = 100.0f;
+
 // World
 Camera* worldCam;
 
 // Shaders
-Shader lightingShader, lampShader, singleColorShader, simpleShader;
+ShaderVariants lightingShaders;
+Shader lampShader, singleColorShader, simpleShader;
+
+// Mesh bounds of the frame, culled before anything is queued
+FrustumCuller frustumCuller;
+
+// Culls the instance sets on the GPU instead, when the driver can
+GpuCulling gpuCulling;
+
+// Depth pyramid of the instances drawn last frame, the others are tested against it on the GPU
+HiZBuffer hiZBuffer;
+
+// Draws of the frame, sorted to change state as little as possible
+RenderQueue renderQueue;
+
+// Uniforms set every frame, resolved once the shaders are built
+Uniform<GLint> grassLayerUniform;
 
 // Models
 struct World
@@ -48,17 +92,31 @@ struct World
     // Camera
     Camera camera;
 
-    // Models
-    std::unique_ptr<Model> nanosuit, nanosuit2, lamp1, lamp2;
+    // Boxes of every model, the models leave it when destroyed
+    AabbTree sceneIndex;
+
+    // Models. Instances of the same data are drawn by their set
+    std::unique_ptr<ModelInstanceSet> nanosuits, lamps;
+    Model *nanosuit, *nanosuit2, *lamp1, *lamp2;
+
+    // Model the arrows move, picked with a click
+    Model* selected;
     std::vector<glm::vec3> vegetation;
     GLuint transparentVAO, transparentVBO;
     GLint transparentTexture;
 
+    // Texture arrays and the painter that keeps them bound
+    TextureStore* textureStore;
+    const AssimpPainter* painter;
+
+    // Uniform buffer shared by the shaders
+    FrameUniforms* frameUniforms;
+
     // Other matrices
     glm::mat4 view, proj;
 
     // Light attributes
-    PointLight pointLights[2];
+    PointLight pointLights[FrameUniforms::MaxPointLights];
 
     World()
         : camera(glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f))
@@ -95,6 +153,7 @@ struct World
 bool keys[1024];
 GLfloat lastX = 400, lastY = 300;
 bool firstMouse = true;
+bool pickRequested = false;
 //-----------------------------------------------------
 
 void keyCallback(GLFWwindow* wnd, int key, int scancode, int action, int mode)
@@ -140,6 +199,16 @@ void mouse_callback(GLFWwindow* wnd, double xpos, double ypos)
     worldCam->RotateCamera(xoffset, yoffset);
 }
 
+void mouseButtonCallback(GLFWwindow* wnd, int button, int action, int mods)
+{
+    (void)wnd;
+    (void)mods;
+
+    // Pick the model at the center of the screen
+    if(button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS)
+        pickRequested = true;
+}
+
 inline void doMovement(World& world, GLfloat deltaTime)
 {
     // Camera controls
@@ -156,16 +225,36 @@ inline void doMovement(World& world, GLfloat deltaTime)
 
     GLfloat modelSpeed = 2.0f;
     if(keys[GLFW_KEY_UP])
-        world.nanosuit->Move<Movement::MoveDirection::Up>(modelSpeed);
+        world.selected->Move<Movement::MoveDirection::Up>(modelSpeed);
 
     if(keys[GLFW_KEY_DOWN])
-        world.nanosuit->Move<Movement::MoveDirection::Down>(modelSpeed);
+        world.selected->Move<Movement::MoveDirection::Down>(modelSpeed);
 
     if(keys[GLFW_KEY_RIGHT])
-        world.nanosuit->Move<Movement::MoveDirection::Right>(modelSpeed);
+        world.selected->Move<Movement::MoveDirection::Right>(modelSpeed);
 
     if(keys[GLFW_KEY_LEFT])
-        world.nanosuit->Move<Movement::MoveDirection::Left>(modelSpeed);
+        world.selected->Move<Movement::MoveDirection::Left>(modelSpeed);
+}
+
+void Pick(World& world)
+{
+    // The cursor is hidden, the ray goes straight out of the camera
+    float distance;
+    const std::int32_t proxy = world.sceneIndex.RayCast(
+        world.camera.mCameraPos,
+        world.camera.mCameraFront,
+        PickDistance,
+        [&world](std::int32_t candidate, float) -> float
+        {
+            float hit;
+            const Model* model = static_cast<const Model*>(world.sceneIndex.GetUserData(candidate));
+            return model->IntersectRay(world.camera.mCameraPos, world.camera.mCameraFront, hit) ? hit : -1.0f;
+        },
+        distance);
+
+    if(proxy != AabbTree::Null)
+        world.selected = static_cast<Model*>(world.sceneIndex.GetUserData(proxy));
 }
 
 GLFWwindow* CreateContext()
@@ -187,6 +276,7 @@ GLFWwindow* CreateContext()
     }
     glfwSetKeyCallback(wnd, keyCallback);
     glfwSetCursorPosCallback(wnd, mouse_callback);
+    glfwSetMouseButtonCallback(wnd, mouseButtonCallback);
     glfwSetInputMode(wnd, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     glfwMakeContextCurrent(wnd);
 
@@ -215,10 +305,42 @@ void Update(World& world, float deltaTime)
     glfwPollEvents();
     doMovement(world, deltaTime);
 
+    if(pickRequested)
+    {
+        Pick(world);
+        pickRequested = false;
+    }
+
     // Camera
     world.view = world.camera.GetView();
 }
 
+void ReportCulling(const FrustumCuller::Stats& stats)
+{
+    // Only touch the title when the counts change
+    static std::size_t reportedVisible = 0, reportedCulled = 0;
+    if(stats.visible == reportedVisible && stats.culled == reportedCulled)
+        return;
+    reportedVisible = stats.visible;
+    reportedCulled = stats.culled;
+
+    char title[128];
+    std::snprintf(title, sizeof(title), "LearnOpenGL - %u meshes visible, %u culled", (unsigned int)stats.visible, (unsigned int)stats.culled);
+    glfwSetWindowTitle(window, title);
+}
+
+void ReportOcclusion(std::size_t occluded)
+{
+    static std::size_t reportedOccluded = (std::size_t)-1;
+    if(occluded == reportedOccluded)
+        return;
+    reportedOccluded = occluded;
+
+    char title[128];
+    std::snprintf(title, sizeof(title), "LearnOpenGL - %u instances occluded", (unsigned int)occluded);
+    glfwSetWindowTitle(window, title);
+}
+
 void Render(const World& world)
 {
     //glClearColor(0.2f, 0.3f, 0.3f, 1.0f);     // blue(ish)
@@ -226,54 +348,45 @@ void Render(const World& world)
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
     glStencilMask(0x00);
 
-    // Setup Shaders
-        // lightingShader
-    {
-        lightingShader.Use();
-        GLuint id = lightingShader.GetProgID();
-        lightingShader.LoadView(world.view);
-        lightingShader.LoadProjection(world.proj);
-
-        // Set the lighting uniforms
-        glUniform3f(glGetUniformLocation(id, "viewPos"), world.camera.mCameraPos.x, world.camera.mCameraPos.y, world.camera.mCameraPos.z);
+    // Camera and lights, read by every shader
+    world.frameUniforms->Update(world.view, world.proj, world.camera.mCameraPos, world.pointLights, FrameUniforms::MaxPointLights);
 
-        // Load point lights to GPU
-        LoadLight<PointLight>(id, world.pointLights[0], "pointLights[0]");
-        LoadLight<PointLight>(id, world.pointLights[1], "pointLights[1]");
-    }
-        // singleColorShader
+    // Cull the meshes of the models the scene index finds in view before queueing anything.
+    // The others aren't added, Submit skips them. Sets culled on the GPU don't need it
+    const FrustumCuller* culler = nullptr;
+    if(!gpuCulling.IsReady())
     {
-        singleColorShader.Use();
-        GLuint id = singleColorShader.GetProgID();
-        singleColorShader.LoadView(world.view);
-        singleColorShader.LoadProjection(world.proj);
-
-        // Set the lighting uniforms
-        glUniform3f(glGetUniformLocation(id, "viewPos"), world.camera.mCameraPos.x, world.camera.mCameraPos.y, world.camera.mCameraPos.z);
-
-        // Load point lights to GPU
-        LoadLight<PointLight>(id, world.pointLights[0], "pointLights[0]");
-        LoadLight<PointLight>(id, world.pointLights[1], "pointLights[1]");
+        const Frustum frustum = Frustum::FromMatrix(world.proj * world.view);
+        frustumCuller.Clear();
+        world.sceneIndex.QueryFrustum(frustum, [&world](std::int32_t proxy)
+        {
+            static_cast<const Model*>(world.sceneIndex.GetUserData(proxy))->AddBounds(frustumCuller);
+            return true;
+        });
+        frustumCuller.Cull(frustum);
+        ReportCulling(frustumCuller.GetStats());
+        culler = &frustumCuller;
     }
-        // lampShader
-    {
-        lampShader.Use();
-        lampShader.LoadView(world.view);
-        lampShader.LoadProjection(world.proj);
-    }
-        // simpleShader
+
+    // Draw models. With occlusion culling only the instances drawn last frame
+    const HiZBuffer* hiZ = hiZBuffer.IsReady() ? &hiZBuffer : nullptr;
+    const RenderView view = { world.view, world.proj, world.camera.mCameraPos, (float)height, culler, hiZ };
+    renderQueue.Clear();
+    world.nanosuits->Submit(renderQueue, lightingShaders, FrameUniforms::MaxPointLights, view);
+    world.lamps->Submit(renderQueue, lampShader, view);
+    renderQueue.Execute();
+
+    // Then the other instances the early draws don't hide. The outline goes over every model
+    renderQueue.Clear();
+    if(hiZ != nullptr)
     {
-        simpleShader.Use();
-        simpleShader.LoadView(world.view);
-        simpleShader.LoadProjection(world.proj);
+        hiZBuffer.Build(width, height);
+        world.nanosuits->SubmitLate(renderQueue, lightingShaders, FrameUniforms::MaxPointLights, view);
+        world.lamps->SubmitLate(renderQueue, lampShader, view);
+        ReportOcclusion(world.nanosuits->GetOccludedCount() + world.lamps->GetOccludedCount());
     }
-
-    // Draw models
-    world.nanosuit->Render(lightingShader);
-    world.nanosuit->RenderOutline(singleColorShader);
-    world.nanosuit2->Render(lightingShader);
-    world.lamp1->Render(lampShader);
-    world.lamp2->Render(lampShader);
+    world.selected->SubmitOutline(renderQueue, singleColorShader);
+    renderQueue.Execute();
 
     // Vegetation
     glStencilFunc(GL_ALWAYS, 1, 0xFF);
@@ -281,29 +394,43 @@ void Render(const World& world)
 
     simpleShader.Use();
     glBindVertexArray(world.transparentVAO);
-    glBindTexture(GL_TEXTURE_2D, world.transparentTexture);
+    const TextureSlot& grass = world.textureStore->GetSlot(world.transparentTexture);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, grass.array);
+    grassLayerUniform.Set(grass.layer);
     for(GLuint i = 0; i < world.vegetation.size(); i++)
     {
+        // Quads are a unit tall, the grass streams for the closest one
+        float distance = std::max(glm::length(world.vegetation[i] - view.position), 0.1f);
+        world.textureStore->RequestDetail(world.transparentTexture, view.proj[1][1] / (2.0f * distance) * view.viewportHeight);
+
         glm::mat4 model = glm::mat4();
         model = glm::translate(model, world.vegetation[i]);
-        glUniformMatrix4fv(glGetUniformLocation(simpleShader.GetProgID(), "model"), 1, GL_FALSE, glm::value_ptr(model));
+        simpleShader.LoadModel(model);
         // Draw container
         glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
     }
-    glBindTexture(GL_TEXTURE_2D, 0);
-    glActiveTexture(0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
     glBindVertexArray(0);
+    world.painter->InvalidateBindings();
 
     // Swap the screen buffers
     glfwSwapBuffers(window);
 }
 
-int main()
+int main(int argc, char* argv[])
 {
 #ifdef _WIN32
     //FreeConsole();
 #endif
 
+    // Checks and benchmarks run instead of the scene, without a window
+    const std::string mode = (argc > 1) ? argv[1] : "";
+    if(mode == "--check-import")
+        return RunImportCheck();
+    if(mode == "--bench-aabb-tree")
+        return RunAabbTreeBench();
+
     window = CreateContext();
     if(window == nullptr)
     {
@@ -314,22 +441,50 @@ int main()
     World world;
     worldCam = &world.camera;
 
-    // Load shaders        Vertex shader path                    Fragment shader path
-    lightingShader.Init   ("res/Shader/Vertex/lighting.vert",    "res/Shader/Fragment/lighting.frag");
-    lampShader.Init       ("res/Shader/Vertex/lamp.vert",        "res/Shader/Fragment/lamp.frag");
-    singleColorShader.Init("res/Shader/Vertex/singleColor.vert", "res/Shader/Fragment/singleColor.frag");
-    simpleShader.Init     ("res/Shader/Vertex/simple.vert",      "res/Shader/Fragment/simple.frag");
+    // Layout of model vertices. Model shaders are built to read it
+    const VertexFormat vertexFormat = VertexFormat::Compact;
+    const std::vector<std::string> modelDefines = VertexFormatDefines(vertexFormat);
+    std::vector<std::string> instancedDefines = modelDefines;
+    instancedDefines.push_back("INSTANCED");
+
+    // Load shaders. The driver compiles them while the rest loads
+    ShaderBatch shaderBatch;
+    //                Shader             Vertex shader path                    Fragment shader path                   Defines
+    shaderBatch.Add(lampShader,        "res/Shader/Vertex/lamp.vert",        "res/Shader/Fragment/lamp.frag",        instancedDefines);
+    shaderBatch.Add(singleColorShader, "res/Shader/Vertex/singleColor.vert", "res/Shader/Fragment/singleColor.frag", modelDefines);
+    shaderBatch.Add(simpleShader,      "res/Shader/Vertex/simple.vert",      "res/Shader/Fragment/simple.frag");
+
+    // Lit variants the models are expected to need, any other one is built when first drawn
+    lightingShaders.Init("res/Shader/Vertex/lighting.vert", "res/Shader/Fragment/lighting.frag", modelDefines);
+    for(bool specularMap : { false, true })
+    {
+        ShaderFeatures features;
+        features.pointLights = FrameUniforms::MaxPointLights;
+        features.specularMap = specularMap;
+        features.instanced = true;
+        lightingShaders.Prepare(features, shaderBatch);
+    }
+
+    // Create worker threads
+    std::unique_ptr<ThreadPool> threadPool(std::make_unique<ThreadPool>());
 
     // Create texture store
-    std::unique_ptr<TextureStore> textureStore(std::make_unique<TextureStore>());
+    std::unique_ptr<TextureStore> textureStore(std::make_unique<TextureStore>(threadPool.get()));
+    textureStore->SetBudget(TextureMemoryBudgetBytes);
 
     // Create Models
-    std::unique_ptr<AssimpLoader> assimpLoader = std::make_unique<AssimpLoader>(textureStore.get());
-    std::unique_ptr<AssimpPainter> assimpPainter = std::make_unique<AssimpPainter>();
+    std::unique_ptr<AssimpLoader> assimpLoader = std::make_unique<AssimpLoader>(textureStore.get(), threadPool.get(), vertexFormat);
+    std::unique_ptr<AssimpPainter> assimpPainter = std::make_unique<AssimpPainter>(textureStore.get());
+    world.textureStore = textureStore.get();
+    world.painter = assimpPainter.get();
+
+    // Create the frame uniform buffer
+    std::unique_ptr<FrameUniforms> frameUniforms(std::make_unique<FrameUniforms>());
+    world.frameUniforms = frameUniforms.get();
 
-    // Load data
-    std::unique_ptr<ModelData> nanosuitData(assimpLoader->LoadData("res/Model/Nanosuit/nanosuit.obj"));
+    // Load data. The lamp is small and stands in for the nanosuit while it streams in
     std::unique_ptr<ModelData> lampData(assimpLoader->LoadData("res/Model/Lamp/lamp.obj"));
+    std::shared_ptr<ModelData> nanosuitData(assimpLoader->LoadDataAsync("res/Model/Nanosuit/nanosuit.obj"));
 
     Model::RenderMeshCb rmcb = std::bind(
         &AssimpPainter::DrawMesh,
@@ -338,10 +493,12 @@ int main()
         std::placeholders::_2,
         std::placeholders::_3);
 
-    world.nanosuit = Model::CreateModel(nanosuitData.get(), rmcb);
-    world.nanosuit2 = Model::CreateModel(nanosuitData.get(), rmcb);
-    world.lamp1 = Model::CreateModel(lampData.get(), rmcb);
-    world.lamp2 = Model::CreateModel(lampData.get(), rmcb);
+    world.nanosuits = std::make_unique<ModelInstanceSet>(nanosuitData.get(), rmcb, lampData.get());
+    world.lamps = std::make_unique<ModelInstanceSet>(lampData.get(), rmcb);
+    world.nanosuit = world.nanosuits->AddInstance();
+    world.nanosuit2 = world.nanosuits->AddInstance();
+    world.lamp1 = world.lamps->AddInstance();
+    world.lamp2 = world.lamps->AddInstance();
 
     GLfloat deltaTime = 0.0f;   // Time between current frame and last frame
     GLfloat lastFrame = 0.0f;   // Time of last frame
@@ -358,6 +515,11 @@ int main()
     world.lamp2->Translate(world.pointLights[1].attr.position);   // Move it to its position
     world.lamp2->Scale(glm::vec3(0.2f));                          // Make it a smaller cube
 
+    // Index the models where they stand, they keep their boxes up to date from now on
+    world.nanosuits->Attach(world.sceneIndex);
+    world.lamps->Attach(world.sceneIndex);
+    world.selected = world.nanosuit;
+
     // Set up vertex data (and buffer(s)) and attribute pointers
     GLfloat transparentVertices[] = {
         // Positions       // Texture Coords
@@ -393,6 +555,22 @@ int main()
 
     world.transparentTexture = textureStore->LoadTexture("res/Image/grass.png", true);
 
+    // Every shader has to be ready for the first frame
+    shaderBatch.Wait();
+
+    // Every set goes out with an indirect draw per mesh where compute shaders are available
+    if(GpuCulling::IsSupported())
+        gpuCulling.Init("res/Shader/Compute/cull.comp");
+    if(gpuCulling.IsReady())
+    {
+        world.nanosuits->EnableGpuCulling(gpuCulling);
+        world.lamps->EnableGpuCulling(gpuCulling);
+        hiZBuffer.Init("res/Shader/Compute/hiz.comp");
+    }
+
+    // Resolve the uniforms Render sets
+    grassLayerUniform = simpleShader.GetUniform<GLint>("ourTextureLayer");
+
     // Game loop
     while(!glfwWindowShouldClose(window))
     {
@@ -401,6 +579,15 @@ int main()
         lastFrame = currentFrame;
 
         Update(world, deltaTime);
+
+        // Move streamed models to the GPU without stalling the frame
+        assimpLoader->ProcessUploads(UploadBudgetMilliseconds);
+        textureStore->ProcessUploads(TextureUploadBudgetBytes);
+
+        // Models whose data just arrived get the box of the real data
+        world.nanosuits->UpdateIndex();
+        world.lamps->UpdateIndex();
+
         Render(world);
     }
 
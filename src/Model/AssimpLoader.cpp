@@ -1,27 +1,319 @@
 #include "AssimpLoader.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
 #include <iostream>
+#include <limits>
 #include <SOIL.h>
 
+namespace
+{
+    /// Vertices converted by a single job of the thread pool
+    const unsigned int VerticesPerJob = 16384;
+
+    /// Bytes of vertex or index data an upload step sends to the GPU
+    const GLsizeiptr UploadChunkBytes = 1 << 20;
+
+    /// Writes the vertices [first, last) of a mesh to out in given format.
+    /// Output vertex i is read from source vertex order[i]
+    void ConvertVertices(
+        const aiMesh* mesh,
+        const Mesh& target,
+        const GLuint* order,
+        VertexFormat format,
+        unsigned int first,
+        unsigned int last,
+        GLubyte* out)
+    {
+        const bool hasTexCoords = mesh->HasTextureCoords(0);
+        const GLsizei stride = VertexStride(format);
+
+        for(unsigned int i = first; i < last; i++, out += stride)
+        {
+            const GLuint j = order[i];
+            glm::vec3 position(mesh->mVertices[j].x, mesh->mVertices[j].y, mesh->mVertices[j].z);
+            glm::vec3 normal(mesh->mNormals[j].x, mesh->mNormals[j].y, mesh->mNormals[j].z);
+
+            // Meshes without TexCoords keep the stride and get zeroes
+            glm::vec2 texCoords(0.0f, 0.0f);
+            if(hasTexCoords)
+                texCoords = glm::vec2(mesh->mTextureCoords[0][j].x, mesh->mTextureCoords[0][j].y);
+
+            PackVertex(format, position, normal, texCoords, target.positionScale, target.positionOffset, out);
+        }
+    }
+
+    /// Writes the indices of all faces of a mesh to target.indices.
+    /// Returns false if some faces are not triangles
+    bool GatherIndices(const aiMesh* mesh, Mesh& target)
+    {
+        bool triangles = true;
+        GLuint* out = target.indices.data();
+        for(GLuint h = 0; h < mesh->mNumFaces; h++)
+        {
+            const aiFace& face = mesh->mFaces[h];
+            triangles = triangles && face.mNumIndices == 3;
+
+            for(GLuint j = 0; j < face.mNumIndices; j++)
+                *out++ = face.mIndices[j];
+        }
+        return triangles;
+    }
+
+    /// Writes indices narrowed to indexType to packed
+    void PackIndices(const std::vector<GLuint>& indices, GLenum indexType, GLubyte* packed)
+    {
+        if(indexType == GL_UNSIGNED_SHORT)
+        {
+            GLushort* shorts = reinterpret_cast<GLushort*>(packed);
+            for(GLuint index : indices)
+                *shorts++ = (GLushort)index;
+        }
+        else
+            std::copy(indices.begin(), indices.end(), reinterpret_cast<GLuint*>(packed));
+    }
+
+    /// Retrieves half the diagonal of a mesh's bounding box
+    float MeshRadius(const aiMesh* mesh)
+    {
+        if(mesh->mNumVertices == 0)
+            return 0.0f;
+
+        glm::vec3 lo(mesh->mVertices[0].x, mesh->mVertices[0].y, mesh->mVertices[0].z);
+        glm::vec3 hi = lo;
+        for(unsigned int j = 1; j < mesh->mNumVertices; j++)
+        {
+            glm::vec3 p(mesh->mVertices[j].x, mesh->mVertices[j].y, mesh->mVertices[j].z);
+            lo = glm::min(lo, p);
+            hi = glm::max(hi, p);
+        }
+        return glm::length(hi - lo) * 0.5f;
+    }
+
+    /// Computes the bounding box of all meshes of a scene, and a bounding sphere centered on it
+    void ComputeBounds(const aiScene* scene, ModelData& model)
+    {
+        glm::vec3 lo(std::numeric_limits<float>::max());
+        glm::vec3 hi(-std::numeric_limits<float>::max());
+        for(unsigned int i = 0; i < scene->mNumMeshes; i++)
+        {
+            const aiMesh* mesh = scene->mMeshes[i];
+            for(unsigned int j = 0; j < mesh->mNumVertices; j++)
+            {
+                glm::vec3 p(mesh->mVertices[j].x, mesh->mVertices[j].y, mesh->mVertices[j].z);
+                lo = glm::min(lo, p);
+                hi = glm::max(hi, p);
+            }
+        }
+
+        model.boundsMin = glm::vec3(0.0f);
+        model.boundsMax = glm::vec3(0.0f);
+        model.boundsCenter = glm::vec3(0.0f);
+        model.boundsRadius = 0.0f;
+        if(lo.x > hi.x)
+            return;
+
+        model.boundsMin = lo;
+        model.boundsMax = hi;
+        model.boundsCenter = (lo + hi) * 0.5f;
+        for(unsigned int i = 0; i < scene->mNumMeshes; i++)
+        {
+            const aiMesh* mesh = scene->mMeshes[i];
+            for(unsigned int j = 0; j < mesh->mNumVertices; j++)
+            {
+                glm::vec3 p(mesh->mVertices[j].x, mesh->mVertices[j].y, mesh->mVertices[j].z);
+                model.boundsRadius = std::max(model.boundsRadius, glm::length(p - model.boundsCenter));
+            }
+        }
+    }
+
+    /// Computes the bounding box of a mesh, and a bounding sphere centered on it
+    void ComputeMeshBounds(const aiMesh* mesh, Mesh& target)
+    {
+        if(mesh->mNumVertices == 0)
+            return;
+
+        glm::vec3 lo(mesh->mVertices[0].x, mesh->mVertices[0].y, mesh->mVertices[0].z);
+        glm::vec3 hi = lo;
+        for(unsigned int j = 1; j < mesh->mNumVertices; j++)
+        {
+            glm::vec3 p(mesh->mVertices[j].x, mesh->mVertices[j].y, mesh->mVertices[j].z);
+            lo = glm::min(lo, p);
+            hi = glm::max(hi, p);
+        }
+
+        target.boundsMin = lo;
+        target.boundsMax = hi;
+        target.boundsCenter = (lo + hi) * 0.5f;
+        target.boundsRadius = 0.0f;
+        for(unsigned int j = 0; j < mesh->mNumVertices; j++)
+        {
+            glm::vec3 p(mesh->mVertices[j].x, mesh->mVertices[j].y, mesh->mVertices[j].z);
+            target.boundsRadius = std::max(target.boundsRadius, glm::length(p - target.boundsCenter));
+        }
+    }
+
+    /// Computes the dequantization transform that maps a mesh's bounding box to [-1, 1]
+    void ComputePositionTransform(Mesh& target)
+    {
+        target.positionOffset = (target.boundsMin + target.boundsMax) * 0.5f;
+        target.positionScale = glm::max((target.boundsMax - target.boundsMin) * 0.5f, glm::vec3(1e-6f));
+    }
+}
+
 //--------------------------------------------------
 // AssimpLoader
 //--------------------------------------------------
-AssimpLoader::AssimpLoader(TextureStore* textureStore) : mTextureStore(textureStore)
+const unsigned int AssimpLoader::ImportFlags = aiProcess_GenNormals            |
+                                               aiProcess_CalcTangentSpace      |
+                                               aiProcess_JoinIdenticalVertices |
+                                               //aiProcess_SortByPType           |
+                                               aiProcess_Triangulate           |
+                                               aiProcess_FlipUVs;
+
+const float AssimpLoader::LodBaseError = 0.01f;
+
+AssimpLoader::AssimpLoader(TextureStore* textureStore, ThreadPool* threadPool, VertexFormat format)
+    : mTextureStore(textureStore)
+    , mThreadPool(threadPool)
+    , mFormat(format)
 {
 }
 
+AssimpLoader::~AssimpLoader()
+{
+    // Background imports use this loader
+    for(const std::shared_ptr<PendingUpload>& upload : mUploads)
+    {
+        if(upload->import.valid())
+            upload->import.wait();
+    }
+}
+
 std::unique_ptr<ModelData> AssimpLoader::LoadData(const std::string& filepath)
 {
     std::unique_ptr<ModelData> rVal(std::make_unique<ModelData>());
+    PendingUpload upload;
+
+    if(!Prepare(filepath, *rVal, upload))
+        return nullptr;
+
+    Upload(*rVal, upload.vertices, upload.vertexBytes, upload.indexData, upload.indexBytes);
+    for(Mesh& mesh : rVal->meshes)
+    {
+        for(Texture& texture : mesh.textures)
+            texture.handle = mTextureStore->LoadTexture(texture.path, mesh.NeedsAlpha(texture));
+    }
+    rVal->state = ModelData::State::Resident;
+
+    return rVal;
+}
+
+std::shared_ptr<ModelData> AssimpLoader::LoadDataAsync(const std::string& filepath)
+{
+    std::shared_ptr<ModelData> model(std::make_shared<ModelData>());
+    std::shared_ptr<PendingUpload> upload(std::make_shared<PendingUpload>());
+    upload->model = model;
+
+    // The job only touches the model and the pending upload, which the GL thread
+    // leaves alone until the job is done. It doesn't hold a reference so the model
+    // data, and its GL objects, are always released on the GL thread
+    PendingUpload* pending = upload.get();
+    upload->import = mThreadPool->Submit([this, filepath, pending]()
+    {
+        return Prepare(filepath, *pending->model, *pending);
+    });
+
+    mUploads.push_back(upload);
+    return model;
+}
+
+void AssimpLoader::ProcessUploads(double budgetMilliseconds)
+{
+    using Clock = std::chrono::steady_clock;
+    const Clock::time_point start = Clock::now();
+
+    auto it = mUploads.begin();
+    while(it != mUploads.end())
+    {
+        PendingUpload& upload = **it;
+
+        if(upload.import.valid())
+        {
+            // Still importing, try the next one
+            if(upload.import.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            {
+                ++it;
+                continue;
+            }
+            upload.imported = upload.import.get();
+        }
+
+        // At least one step per call so a tight budget still makes progress
+        bool done = UploadStep(upload);
+        while(!done && std::chrono::duration<double, std::milli>(Clock::now() - start).count() < budgetMilliseconds)
+            done = UploadStep(upload);
+
+        if(!done)
+            return;
+
+        it = mUploads.erase(it);
+    }
+}
+
+std::size_t AssimpLoader::GetPendingUploads() const
+{
+    return mUploads.size();
+}
+
+bool AssimpLoader::Prepare(const std::string& filepath, ModelData& model, PendingUpload& upload) const
+{
+    const std::string cookedPath = ModelCache::CookedPath(filepath);
+    const std::uint64_t sourceHash = ModelCache::HashSource(filepath);
+
+    // Warm start: hand the mapped cooked file straight to the GPU
+    if(sourceHash != 0 && ModelCache::Load(cookedPath, sourceHash, ImportFlags, mFormat, upload.cooked))
+    {
+        FillFromCooked(upload.cooked, model);
+        upload.vertices    = upload.cooked.vertices;
+        upload.vertexBytes = upload.cooked.vertexBytes;
+        upload.indexData   = upload.cooked.indexData;
+        upload.indexBytes  = upload.cooked.indexBytes;
+        return true;
+    }
+
+    // Cold start: import with Assimp and cook the result for the next run
+    if(!Import(filepath, model))
+        return false;
+
+    if(sourceHash != 0 && !ModelCache::Save(cookedPath, sourceHash, ImportFlags, model))
+        std::cout << "WARNING::MODEL_CACHE:: Could not write " << cookedPath << std::endl;
+
+    upload.vertices    = model.data.data();
+    upload.vertexBytes = (GLsizeiptr)model.data.size();
+    upload.indexData   = model.indexData.data();
+    upload.indexBytes  = (GLsizeiptr)model.indexData.size();
+    return true;
+}
+
+bool AssimpLoader::Import(const std::string& filepath, ModelData& model, bool parallel) const
+{
+    // Every job writes its own slice, so running them in order gives the same bytes
+    auto forEach = [this, parallel](std::size_t count, const std::function<void(std::size_t)>& body)
+    {
+        if(parallel)
+            mThreadPool->ParallelFor(count, body);
+        else
+        {
+            for(std::size_t i = 0; i < count; i++)
+                body(i);
+        }
+    };
+
     Assimp::Importer importer;
 
-    const aiScene* scene = importer.ReadFile(filepath,
-                                             aiProcess_GenNormals            |
-                                             aiProcess_CalcTangentSpace      |
-                                             aiProcess_JoinIdenticalVertices |
-                                             //aiProcess_SortByPType           |
-                                             aiProcess_Triangulate           |
-                                             aiProcess_FlipUVs
-                                             );
+    const aiScene* scene = importer.ReadFile(filepath, ImportFlags);
 
     if(!scene || scene->mFlags == AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
     {
@@ -29,58 +321,204 @@ std::unique_ptr<ModelData> AssimpLoader::LoadData(const std::string& filepath)
         return false;
     }
 
-    // Put vertices to data
-    for(unsigned int i = 0, offset = 0; i < scene->mNumMeshes; i++)
+    const unsigned int meshCount = scene->mNumMeshes;
+    const GLsizei stride = VertexStride(mFormat);
+    model.format = mFormat;
+    model.meshes.resize(meshCount);
+
+    // Phase 1: Prefix sum of every mesh's vertex count, so that each mesh knows
+    // its slice of the vertex stream before any conversion starts
+    for(unsigned int i = 0, offset = 0; i < meshCount; i++)
     {
-        aiMesh* curMesh = scene->mMeshes[i];
+        const aiMesh* curMesh = scene->mMeshes[i];
+        Mesh& newMesh = model.meshes[i];
 
-        // Create new Mesh
-        Mesh newMesh;
+        newMesh.baseVertex = offset;
+        newMesh.vertexCount = curMesh->mNumVertices;
+        offset += curMesh->mNumVertices;
 
-        // Update its info
-        newMesh.dataOffset = offset;
+        GLsizei indexCount = 0;
+        for(GLuint h = 0; h < curMesh->mNumFaces; h++)
+            indexCount += (GLsizei)curMesh->mFaces[h].mNumIndices;
 
-        // Update offset
-        offset += curMesh->mNumVertices;
+        newMesh.indices.resize(indexCount);
+        newMesh.indexCount = indexCount;
 
-        // Add Data to rVal->data vector
-        for(unsigned int j = 0; j < curMesh->mNumVertices; j++)
-        {
-            // Vertices
-            rVal->data.push_back(curMesh->mVertices[j].x);
-            rVal->data.push_back(curMesh->mVertices[j].y);
-            rVal->data.push_back(curMesh->mVertices[j].z);
+        // Indices are relative to baseVertex, so small meshes of the compact format fit in 16 bits
+        newMesh.indexType = (mFormat == VertexFormat::Compact && newMesh.vertexCount <= 65536)
+                          ? GL_UNSIGNED_SHORT
+                          : GL_UNSIGNED_INT;
+    }
+    model.data.resize((std::size_t)(model.meshes.empty() ? 0 : model.meshes.back().baseVertex + model.meshes.back().vertexCount) * stride);
+    ComputeBounds(scene, model);
 
-            // Normals
-            rVal->data.push_back(curMesh->mNormals[j].x);
-            rVal->data.push_back(curMesh->mNormals[j].y);
-            rVal->data.push_back(curMesh->mNormals[j].z);
+    // Bounds of every mesh. Compact positions are quantized against them
+    forEach(meshCount, [&](std::size_t i)
+    {
+        ComputeMeshBounds(scene->mMeshes[i], model.meshes[i]);
+        if(mFormat == VertexFormat::Compact)
+            ComputePositionTransform(model.meshes[i]);
+    });
+
+    // Phase 2: Indices, one mesh per job. Triangles are reordered for the post-transform
+    // cache and for overdraw, and simplified into the LOD chain. Then vertices get
+    // renumbered in the order the full detail mesh fetches them
+    std::vector<std::vector<GLuint>> vertexOrders(meshCount);
+    std::vector<std::vector<std::vector<GLuint>>> lodIndices(meshCount);
+    std::vector<MeshOptimizer::CacheStats> statsBefore(meshCount), statsAfter(meshCount);
+
+    forEach(meshCount, [&](std::size_t i)
+    {
+        const aiMesh* curMesh = scene->mMeshes[i];
+        Mesh& newMesh = model.meshes[i];
+        std::vector<GLuint>& order = vertexOrders[i];
+        std::vector<std::vector<GLuint>>& lods = lodIndices[i];
 
-            // TexCoords
-            if(curMesh->HasTextureCoords(0))
+        const bool triangles = GatherIndices(curMesh, newMesh);
+        if(triangles && !newMesh.indices.empty())
+        {
+            const float* positions = &curMesh->mVertices[0].x;
+            statsBefore[i] = MeshOptimizer::AnalyzeVertexCache(newMesh.indices, newMesh.vertexCount);
+
+            std::vector<std::size_t> clusters = MeshOptimizer::OptimizeVertexCache(newMesh.indices, newMesh.vertexCount);
+            MeshOptimizer::OptimizeOverdraw(
+                newMesh.indices,
+                clusters,
+                positions,
+                sizeof(aiVector3D),
+                newMesh.vertexCount);
+
+            // Each LOD halves the previous one, within an error that doubles
+            const float meshRadius = MeshRadius(curMesh);
+            const std::vector<GLuint>* previous = &newMesh.indices;
+            for(unsigned int lod = 1; lod < ModelData::MaxLods; lod++)
             {
-                rVal->data.push_back(curMesh->mTextureCoords[0][j].x);
-                rVal->data.push_back(curMesh->mTextureCoords[0][j].y);
-                rVal->data.push_back(curMesh->mTextureCoords[0][j].z);
+                std::vector<GLuint> simplified = MeshSimplifier::Simplify(
+                    *previous,
+                    positions,
+                    sizeof(aiVector3D),
+                    newMesh.vertexCount,
+                    previous->size() / 6 * 3,
+                    meshRadius * LodBaseError * (float)(1u << (lod - 1)));
+
+                // Not worth a LOD of its own
+                if(simplified.empty() || simplified.size() > previous->size() * 9 / 10)
+                    break;
+
+                MeshOptimizer::OptimizeVertexCache(simplified, newMesh.vertexCount);
+                lods.push_back(std::move(simplified));
+                previous = &lods.back();
             }
-            else
+
+            // Meshlets follow the final triangle order of the full detail mesh
+            newMesh.meshlets = MeshletBuilder::Build(newMesh.indices, positions, sizeof(aiVector3D), newMesh.vertexCount);
+
+            order = MeshOptimizer::OptimizeVertexFetch(newMesh.indices, newMesh.vertexCount);
+
+            // LODs use the same vertices, follow the new numbering
+            std::vector<GLuint> remap(newMesh.vertexCount);
+            for(GLuint v = 0; v < newMesh.vertexCount; v++)
+                remap[order[v]] = v;
+            for(std::vector<GLuint>& lod : lods)
             {
-                // TODO: Handle that case
-                // rVal->data.push_back(0);
-                // rVal->data.push_back(0);
-                // rVal->data.push_back(0);
+                for(GLuint& index : lod)
+                    index = remap[index];
             }
-        }
 
-        // Add Indices to vector
-        for(GLuint h = 0; h < curMesh->mNumFaces; h++)
+            statsAfter[i] = MeshOptimizer::AnalyzeVertexCache(newMesh.indices, newMesh.vertexCount);
+        }
+        else
         {
-            aiFace* face = &(curMesh->mFaces[h]);
+            // Points and lines are left as they are
+            order.resize(newMesh.vertexCount);
+            for(GLuint v = 0; v < newMesh.vertexCount; v++)
+                order[v] = v;
+
+            statsBefore[i] = statsAfter[i] = MeshOptimizer::CacheStats{ 0.0f, 0.0f };
+        }
+    });
+
+    for(unsigned int i = 0; i < meshCount; i++)
+    {
+        if(statsBefore[i].acmr == 0.0f)
+            continue;
+
+        std::cout << "INFO::MESH_OPTIMIZER:: " << filepath << " mesh " << i
+                  << ": ACMR " << statsBefore[i].acmr << " -> " << statsAfter[i].acmr
+                  << ", ATVR " << statsBefore[i].atvr << " -> " << statsAfter[i].atvr
+                  << ", LOD triangles " << model.meshes[i].indexCount / 3;
+        for(const std::vector<GLuint>& lod : lodIndices[i])
+            std::cout << " / " << lod.size() / 3;
+        std::cout << std::endl;
+    }
+
+    // Lay out the index ranges of every mesh and LOD, each aligned to its index size
+    GLuint indexBytes = 0;
+    for(unsigned int i = 0; i < meshCount; i++)
+    {
+        Mesh& newMesh = model.meshes[i];
+        const GLuint indexSize = (GLuint)IndexTypeSize(newMesh.indexType);
 
-            for(GLuint j = 0; j < face->mNumIndices; j++)
-                newMesh.indices.push_back(face->mIndices[j] + newMesh.dataOffset);
+        newMesh.indexOffset = (indexBytes + indexSize - 1) / indexSize * indexSize;
+        indexBytes = newMesh.indexOffset + newMesh.indexCount * indexSize;
+
+        for(const std::vector<GLuint>& lod : lodIndices[i])
+        {
+            newMesh.lods.push_back({ indexBytes, (GLsizei)lod.size() });
+            indexBytes += (GLuint)lod.size() * indexSize;
         }
 
+        model.lodCount = std::max(model.lodCount, 1 + (unsigned int)newMesh.lods.size());
+    }
+    model.indexData.resize(indexBytes);
+
+    forEach(meshCount, [&](std::size_t i)
+    {
+        const Mesh& newMesh = model.meshes[i];
+
+        PackIndices(newMesh.indices, newMesh.indexType, model.indexData.data() + newMesh.indexOffset);
+        for(std::size_t lod = 0; lod < newMesh.lods.size(); lod++)
+            PackIndices(lodIndices[i][lod], newMesh.indexType, model.indexData.data() + newMesh.lods[lod].indexOffset);
+    });
+
+    // Phase 3: Vertices on the thread pool. Big meshes are split in chunks so that
+    // a model made of a few large meshes still spreads over all cores
+    struct ConversionJob
+    {
+        unsigned int mesh;
+        unsigned int firstVertex;
+        unsigned int lastVertex;
+    };
+
+    std::vector<ConversionJob> jobs;
+    for(unsigned int i = 0; i < meshCount; i++)
+    {
+        const unsigned int numVertices = scene->mMeshes[i]->mNumVertices;
+        for(unsigned int first = 0; first < numVertices; first += VerticesPerJob)
+            jobs.push_back({ i, first, std::min(first + VerticesPerJob, numVertices) });
+    }
+
+    forEach(jobs.size(), [&](std::size_t j)
+    {
+        const ConversionJob& job = jobs[j];
+        const Mesh& newMesh = model.meshes[job.mesh];
+
+        ConvertVertices(
+            scene->mMeshes[job.mesh],
+            newMesh,
+            vertexOrders[job.mesh].data(),
+            mFormat,
+            job.firstVertex,
+            job.lastVertex,
+            model.data.data() + ((std::size_t)newMesh.baseVertex + job.firstVertex) * stride);
+    });
+
+    // Phase 4: Materials. Only the texture paths, the textures are loaded on the GL thread
+    for(unsigned int i = 0; i < meshCount; i++)
+    {
+        const aiMesh* curMesh = scene->mMeshes[i];
+        Mesh& newMesh = model.meshes[i];
+
         // Materials
         if(curMesh->mMaterialIndex >= 0)
         {
@@ -101,63 +539,149 @@ std::unique_ptr<ModelData> AssimpLoader::LoadData(const std::string& filepath)
                 SHADER_TEXTURE_SPECULAR_PREFIX,
                 filepath.substr(0, filepath.find_last_of('/')));
             newMesh.textures.insert(newMesh.textures.end(), specularMaps.begin(), specularMaps.end());
+
+            // Cut outs. The shaders test the diffuse map's alpha, the opacity map only flags the mesh
+            newMesh.alphaTested = material->GetTextureCount(aiTextureType_OPACITY) > 0;
+        }
+    }
+
+    return true;
+}
+
+void AssimpLoader::FillFromCooked(const CookedModel& cooked, ModelData& model)
+{
+    model.format       = cooked.format;
+    model.lodCount     = cooked.lodCount;
+    model.boundsCenter = cooked.boundsCenter;
+    model.boundsRadius = cooked.boundsRadius;
+    model.boundsMin    = cooked.boundsMin;
+    model.boundsMax    = cooked.boundsMax;
+
+    for(const CookedMesh& cookedMesh : cooked.meshes)
+    {
+        Mesh newMesh;
+        newMesh.indexOffset    = cookedMesh.indexOffset;
+        newMesh.indexCount     = cookedMesh.indexCount;
+        newMesh.indexType      = cookedMesh.indexType;
+        newMesh.baseVertex     = cookedMesh.baseVertex;
+        newMesh.vertexCount    = cookedMesh.vertexCount;
+        newMesh.positionScale  = cookedMesh.positionScale;
+        newMesh.positionOffset = cookedMesh.positionOffset;
+        newMesh.alphaTested    = cookedMesh.alphaTested;
+        newMesh.boundsMin      = cookedMesh.boundsMin;
+        newMesh.boundsMax      = cookedMesh.boundsMax;
+        newMesh.boundsCenter   = cookedMesh.boundsCenter;
+        newMesh.boundsRadius   = cookedMesh.boundsRadius;
+        newMesh.lods           = cookedMesh.lods;
+        newMesh.meshlets       = cookedMesh.meshlets;
+
+        for(const auto& cookedTexture : cookedMesh.textures)
+        {
+            Texture texture;
+            texture.handle = TextureStore::FallbackHandle;
+            texture.type   = cookedTexture.first;
+            texture.path   = cookedTexture.second;
+            newMesh.textures.push_back(texture);
         }
 
-        // Add new mesh to vector
-        rVal->meshes.push_back(newMesh);
+        model.meshes.push_back(newMesh);
     }
+}
 
-    // Load to gpu
-    glGenBuffers(1, &(rVal->vbo));
-    glGenVertexArrays(1, &(rVal->vao));
+void AssimpLoader::Upload(
+    ModelData& model,
+    const GLvoid* vertices,
+    GLsizeiptr vertexBytes,
+    const GLvoid* indexData,
+    GLsizeiptr indexBytes)
+{
+    glGenBuffers(1, &(model.vbo));
+    glGenBuffers(1, &(model.ebo));
+    glGenVertexArrays(1, &(model.vao));
 
-    glBindVertexArray(rVal->vao);
+    glBindVertexArray(model.vao);
     {
-        glBindBuffer(GL_ARRAY_BUFFER, rVal->vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, model.vbo);
         {
             // Bind data
             glBufferData(
                 GL_ARRAY_BUFFER,
-                rVal->data.size() * sizeof(GLfloat),
-                rVal->data.data(),
+                vertexBytes,
+                vertices,
                 GL_STATIC_DRAW);
 
-            // Vertices
-            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(float), (GLvoid*)0);
-            glEnableVertexAttribArray(0);
-
-            // Normals
-            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(float), (GLvoid*)(3 * sizeof(GLfloat)));
-            glEnableVertexAttribArray(1);
-
-            // TexCoords
-            glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(float), (GLvoid*)(6 * sizeof(GLfloat)));
-            glEnableVertexAttribArray(2);
+            // Vertices, Normals, TexCoords
+            SetupVertexAttributes(model.format);
         }
         glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-        for(Mesh& mesh : rVal->meshes)
-        {
-            glGenBuffers(1, &mesh.ebo);
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
-            glBufferData(
-                GL_ELEMENT_ARRAY_BUFFER,
-                mesh.indices.size() * sizeof(GLuint),
-                mesh.indices.data(),
-                GL_STATIC_DRAW);
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-        }
+        // Indices of all meshes. The binding is recorded in the VAO so it stays bound
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, model.ebo);
+        glBufferData(
+            GL_ELEMENT_ARRAY_BUFFER,
+            indexBytes,
+            indexData,
+            GL_STATIC_DRAW);
     }
     glBindVertexArray(0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+bool AssimpLoader::UploadStep(PendingUpload& upload)
+{
+    ModelData& model = *upload.model;
+
+    if(!upload.imported)
+    {
+        model.state = ModelData::State::Failed;
+        return true;
+    }
+
+    // Buffers first, without data. The VAO records the attributes and the EBO right away
+    if(!upload.created)
+    {
+        Upload(model, nullptr, upload.vertexBytes, nullptr, upload.indexBytes);
+        upload.created = true;
+        return false;
+    }
+
+    // Then the data, a chunk per step. GL_COPY_WRITE_BUFFER leaves the VAO bindings alone
+    if(upload.vertexBytesDone < upload.vertexBytes)
+    {
+        GLsizeiptr size = std::min(UploadChunkBytes, upload.vertexBytes - upload.vertexBytesDone);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, model.vbo);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, upload.vertexBytesDone, size, static_cast<const GLubyte*>(upload.vertices) + upload.vertexBytesDone);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        upload.vertexBytesDone += size;
+        return false;
+    }
+
+    if(upload.indexBytesDone < upload.indexBytes)
+    {
+        GLsizeiptr size = std::min(UploadChunkBytes, upload.indexBytes - upload.indexBytesDone);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, model.ebo);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, upload.indexBytesDone, size, static_cast<const GLubyte*>(upload.indexData) + upload.indexBytesDone);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        upload.indexBytesDone += size;
+        return false;
+    }
+
+    // Then the textures. The store decodes them in the background and shows a fallback meanwhile
+    for(Mesh& mesh : model.meshes)
+    {
+        for(Texture& texture : mesh.textures)
+            texture.handle = mTextureStore->LoadTexture(texture.path, mesh.NeedsAlpha(texture));
+    }
 
-    return std::move(rVal);
+    model.state = ModelData::State::Resident;
+    return true;
 }
 
 std::vector<Texture> AssimpLoader::LoadMaterialTextures(
     aiMaterial* mat,
     aiTextureType type,
     std::string typeName,
-    std::string assetRootDir)
+    std::string assetRootDir) const
 {
     std::vector<Texture> textures;
 
@@ -169,7 +693,8 @@ std::vector<Texture> AssimpLoader::LoadMaterialTextures(
         std::string absPath(assetRootDir + '/' + path.C_Str());
 
         Texture texture;
-        texture.id = mTextureStore->LoadTexture(absPath);
+        texture.handle = TextureStore::FallbackHandle;
+        texture.path = absPath;
 
         auto it = std::find(TextureTypeNames.begin(), TextureTypeNames.end(), typeName);
         texture.type = (TextureType)std::distance(TextureTypeNames.begin(), it);
@@ -183,72 +708,134 @@ std::vector<Texture> AssimpLoader::LoadMaterialTextures(
 //--------------------------------------------------
 // AssimpPainter
 //--------------------------------------------------
+AssimpPainter::AssimpPainter(TextureStore* textureStore)
+    : mTextureStore(textureStore)
+{
+    InvalidateBindings();
+}
+
+void AssimpPainter::InvalidateBindings() const
+{
+    for(GLuint& array : mBoundArrays)
+        array = 0;
+}
+
 void AssimpPainter::DrawMesh(
     const Shader& shader,
-    GLuint vao,
-    const Mesh& mesh) const
+    const Mesh& mesh,
+    const MeshDraw& draw) const
 {
-    shader.Use();
+    const MaterialUniforms& uniforms = GetMaterialUniforms(shader);
 
     // Bind appropriate textures
-    GLuint diffuseNr = 1;
-    GLuint specularNr = 1;
+    GLuint diffuseNr = 0;
+    GLuint specularNr = 0;
 
-    // Bind textures
-    std::vector<Texture>::size_type index2 = 0;
-    for(Texture texture : mesh.textures)
+    // Bind textures. Meshes whose textures share arrays only switch layers
+    GLuint unit = 0;
+    for(const Texture& texture : mesh.textures)
     {
-        glActiveTexture(GL_TEXTURE0 + (GLuint)index2);
+        if(unit >= MaxTextureUnits)
+            break;
 
-        // Retrieve texture number (the N in diffuse_textureN)
-        std::string number;
+        // Retrieve texture index (the N - 1 in diffuse_textureN)
+        GLuint number = 0;
         TextureType type = texture.type;
 
-        // Transfer GLuint to stream
         switch(type)
         {
             case TextureType::DIFFUSE:
-                number += (char)diffuseNr++;
+                number = diffuseNr++;
                 break;
 
             case TextureType::SPECULAR:
-                number += (char)specularNr++;
+                number = specularNr++;
                 break;
             default:
                 break;
         }
 
-        // Now set the sampler to the correct texture unit
-        glUniform1i(
-            glGetUniformLocation(shader.GetProgID(), ("material." + TextureTypeNames[(size_t)type] + number).c_str()),
-            (GLuint)index2);
+        // Now set the sampler to the correct texture unit, and the layer to sample
+        const TextureSlot& slot = mTextureStore->GetSlot(texture.handle);
+        if(draw.screenPixels > 0.0f)
+            mTextureStore->RequestDetail(texture.handle, draw.screenPixels);
+        const TextureUniforms& textureUniforms = uniforms.textures[(size_t)type][number];
+        textureUniforms.sampler.Set((GLint)unit);
+        textureUniforms.layer.Set(slot.layer);
 
-        // And finally bind the texture
-        glBindTexture(GL_TEXTURE_2D, texture.id);
+        // And finally bind the array, if it isn't already
+        if(mBoundArrays[unit] != slot.array)
+        {
+            glActiveTexture(GL_TEXTURE0 + unit);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, slot.array);
+            mBoundArrays[unit] = slot.array;
+        }
 
-        index2++;
+        unit++;
     }
 
     // Also set each mesh's shininess property to a default value
     // (if you want you could extend this to another mesh property and possibly change this value)
-    glUniform1f(glGetUniformLocation(shader.GetProgID(), "material.shininess"), 16.0f);
+    uniforms.shininess.Set(16.0f);
 
-    // Draw mesh
-    glBindVertexArray(vao);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
-    glDrawElements(
+    // Dequantization of compact positions (no-op for shaders that read float positions)
+    uniforms.positionScale.Set(mesh.positionScale);
+    uniforms.positionOffset.Set(mesh.positionOffset);
+
+    // Commands the GPU wrote, their instance counts never come back to the CPU
+    if(draw.indirectCount > 0)
+    {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, draw.indirectBuffer);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, mesh.indexType, (const GLvoid*)draw.indirectOffset, draw.indirectCount, 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        return;
+    }
+
+    // Instances step through the VAO's instance attributes, range by range
+    if(draw.instanceCount > 0)
+    {
+        for(std::size_t i = 0; i < draw.counts.size(); i++)
+            glDrawElementsInstancedBaseVertex(
+                GL_TRIANGLES,
+                draw.counts[i],
+                mesh.indexType,
+                draw.offsets[i],
+                draw.instanceCount,
+                draw.baseVertices[i]);
+        return;
+    }
+
+    // Draw the mesh's ranges of the model's EBO. Older GLEW headers take non const arrays
+    glMultiDrawElementsBaseVertex(
         GL_TRIANGLES,
-        (GLsizei)mesh.indices.size(),
-        GL_UNSIGNED_INT,
-        0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+        const_cast<GLsizei*>(draw.counts.data()),
+        mesh.indexType,
+        const_cast<GLvoid**>(draw.offsets.data()),
+        (GLsizei)draw.counts.size(),
+        const_cast<GLint*>(draw.baseVertices.data()));
+}
+
+const AssimpPainter::MaterialUniforms& AssimpPainter::GetMaterialUniforms(const Shader& shader) const
+{
+    for(const MaterialUniforms& uniforms : mMaterialUniforms)
+        if(uniforms.program == shader.GetProgID())
+            return uniforms;
 
-    // "Unbind" textures
-    index2 = 0;
-    for(Texture texture : mesh.textures)
+    MaterialUniforms uniforms;
+    uniforms.program = shader.GetProgID();
+    for(size_t type = 0; type < uniforms.textures.size(); type++)
     {
-        glActiveTexture(GL_TEXTURE0 + (GLuint)index2);
-        glBindTexture(GL_TEXTURE_2D, 0);
+        for(GLuint i = 0; i < MaxTextureUnits; i++)
+        {
+            const std::string name = "material." + TextureTypeNames[type] + std::to_string(i + 1);
+            uniforms.textures[type][i].sampler = shader.GetUniform<GLint>(name);
+            uniforms.textures[type][i].layer = shader.GetUniform<GLint>(name + SHADER_TEXTURE_LAYER_SUFFIX);
+        }
     }
+    uniforms.shininess = shader.GetUniform<GLfloat>("material.shininess");
+    uniforms.positionScale = shader.GetUniform<glm::vec3>("positionScale");
+    uniforms.positionOffset = shader.GetUniform<glm::vec3>("positionOffset");
+
+    mMaterialUniforms.push_back(uniforms);
+    return mMaterialUniforms.back();
 }
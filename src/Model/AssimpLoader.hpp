@@ -1,9 +1,12 @@
 #ifndef ELESWORD_ASSIMPLOADER_HPP
 #define ELESWORD_ASSIMPLOADER_HPP
 
+#include <array>
 #include <vector>
 #include <string>
 #include <memory>
+#include <future>
+#include <list>
 
 #define GLEW_STATIC
 #include <GL/glew.h>
@@ -12,35 +15,142 @@
 #include <assimp/scene.h>           // Output data structure
 #include <assimp/postprocess.h>     // Post processing flags
 
+#include "MeshletBuilder.hpp"
+#include "MeshOptimizer.hpp"
+#include "MeshSimplifier.hpp"
 #include "Model.hpp"
+#include "ModelCache.hpp"
+#include "VertexFormat.hpp"
 #include "../Render/Shader.hpp"
 #include "../Texture/TextureStore.hpp"
+#include "../Util/ThreadPool.hpp"
 
 class AssimpLoader
 {
 public:
-    /// Constructor
-    AssimpLoader(TextureStore* texStore);
+    /// Post processing flags given to Assimp. Part of the cooked cache key
+    static const unsigned int ImportFlags;
 
+    /// Error allowed for LOD 1 as a fraction of the mesh's radius. Doubles with every LOD
+    static const float LodBaseError;
+
+    /// Constructor. Imported models get their vertices in given format
+    AssimpLoader(TextureStore* texStore, ThreadPool* threadPool, VertexFormat format = VertexFormat::Float);
+
+    /// Loads the model with given path. Uses the cooked file if it's up to date,
+    /// otherwise imports the source with Assimp and cooks it for the next run
     std::unique_ptr<ModelData> LoadData(const std::string& filepath);
 
+    /// Loads the model with given path like LoadData, without blocking.
+    /// The import runs on the thread pool and ProcessUploads moves the result
+    /// to the GPU. The returned data stays in the Loading state until then
+    std::shared_ptr<ModelData> LoadDataAsync(const std::string& filepath);
+
+    /// Uploads the imported models to the GPU for at most about given time.
+    /// Call once per frame from the GL thread
+    void ProcessUploads(double budgetMilliseconds);
+
+    /// Retrieves the number of async loads not resident yet
+    std::size_t GetPendingUploads() const;
+
+    /// Imports the model with given path with Assimp, skipping the cooked file.
+    /// Touches no GL state. The conversion jobs run on the thread pool, or in
+    /// order on the calling thread when parallel is false. Returns false on failure
+    bool Import(const std::string& filepath, ModelData& model, bool parallel = true) const;
+
+    /// Destructor. Waits for the background imports
+    ~AssimpLoader();
+
 private:
+    /// An async load on its way to the GPU
+    struct PendingUpload
+    {
+        std::shared_ptr<ModelData> model;     /// Data the load fills
+        CookedModel       cooked;             /// Keeps a cooked file mapped until it's uploaded
+        std::future<bool> import;             /// Result of the background import
+        bool              imported = false;   /// Import succeeded, valid once import was read
+        bool              created = false;    /// The VAO and the buffers exist
+        const GLvoid*     vertices = nullptr; /// Vertex stream to upload
+        GLsizeiptr        vertexBytes = 0;
+        GLsizeiptr        vertexBytesDone = 0;
+        const GLvoid*     indexData = nullptr; /// Packed indices to upload
+        GLsizeiptr        indexBytes = 0;
+        GLsizeiptr        indexBytesDone = 0;
+    };
+
     TextureStore* mTextureStore;
+    ThreadPool*   mThreadPool;
+    VertexFormat  mFormat;
+    std::list<std::shared_ptr<PendingUpload>> mUploads; /// Async loads in submission order
+
+    /// Fills given model data and the upload source from the cooked file or an
+    /// import. Touches no GL state. Returns false on failure
+    bool Prepare(const std::string& filepath, ModelData& model, PendingUpload& upload) const;
+
+    /// Fills model data from a mapped cooked file
+    static void FillFromCooked(const CookedModel& cooked, ModelData& model);
+
+    /// Does one bounded piece of work of an async upload. Returns true when it's done
+    bool UploadStep(PendingUpload& upload);
+
+    /// Creates the VAO, VBO and EBO of given model data.
+    /// Null vertices and indexData only allocate the buffers
+    static void Upload(
+        ModelData& model,
+        const GLvoid* vertices,
+        GLsizeiptr vertexBytes,
+        const GLvoid* indexData,
+        GLsizeiptr indexBytes);
 
     std::vector<Texture> LoadMaterialTextures(
         aiMaterial* mat,
         aiTextureType type,
         std::string typeName,
-        std::string assetRootDir);
+        std::string assetRootDir) const;
 }; //~ AssimpLoader
 
 class AssimpPainter
 {
 public:
+    /// Texture units a mesh can use
+    static const GLuint MaxTextureUnits = 8;
+
+    /// Constructor. Mesh textures are resolved with given store
+    explicit AssimpPainter(TextureStore* textureStore);
+
+    /// Forgets the texture arrays it bound. Call when other code binds textures
+    void InvalidateBindings() const;
+
     void DrawMesh(
         const Shader& shader,
-        GLuint vao,
-        const Mesh& mesh) const;
+        const Mesh& mesh,
+        const MeshDraw& draw) const;
+
+private:
+    /// Sampler and layer of the Nth texture of a type
+    struct TextureUniforms
+    {
+        Uniform<GLint> sampler;
+        Uniform<GLint> layer;
+    };
+
+    /// Uniforms DrawMesh sets, resolved once per shader
+    struct MaterialUniforms
+    {
+        GLuint program;
+        std::array<std::array<TextureUniforms, MaxTextureUnits>, std::tuple_size<decltype(TextureTypeNames)>::value> textures;
+        Uniform<GLfloat>   shininess;
+        Uniform<glm::vec3> positionScale;
+        Uniform<glm::vec3> positionOffset;
+    };
+
+    TextureStore* mTextureStore;
+
+    mutable GLuint mBoundArrays[MaxTextureUnits]; /// Array bound to each unit by the last draws
+    mutable std::vector<MaterialUniforms> mMaterialUniforms; /// Of every shader drawn with, few of them
+
+    /// Retrieves the uniforms of given shader, resolving them on first use
+    const MaterialUniforms& GetMaterialUniforms(const Shader& shader) const;
 
 }; //~ AssimpPainter
 
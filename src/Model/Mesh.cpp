@@ -1,8 +1,80 @@
 #include "Model.hpp"
+#include <algorithm>
+#include <cstdint>
 
 Mesh::Mesh()
-    : ebo(0)
-    , vbo(0)
-    , dataOffset(0)
+    : indexOffset(0)
+    , indexCount(0)
+    , indexType(GL_UNSIGNED_INT)
+    , baseVertex(0)
+    , vertexCount(0)
+    , positionScale(1.0f)
+    , positionOffset(0.0f)
+    , alphaTested(false)
+    , boundsMin(0.0f)
+    , boundsMax(0.0f)
+    , boundsCenter(0.0f)
+    , boundsRadius(0.0f)
 {
+}
+
+bool Mesh::HasTexture(TextureType type) const
+{
+    for(const Texture& texture : textures)
+        if(texture.type == type)
+            return true;
+
+    return false;
+}
+
+bool Mesh::NeedsAlpha(const Texture& texture) const
+{
+    return alphaTested && texture.type == TextureType::DIFFUSE;
+}
+
+bool Meshlet::IsBackfacing(const glm::vec3& cameraPosition) const
+{
+    if(coneCutoff >= 1.0f)
+        return false;
+
+    glm::vec3 toApex = coneApex - cameraPosition;
+    float distance = glm::length(toApex);
+    return distance > 0.0f && glm::dot(toApex, coneAxis) >= coneCutoff * distance;
+}
+
+MeshLod Mesh::GetLod(unsigned int lod) const
+{
+    if(lod == 0 || lods.empty())
+        return MeshLod{ indexOffset, indexCount };
+
+    return lods[std::min<std::size_t>(lod, lods.size()) - 1];
+}
+
+void MeshDraw::Clear()
+{
+    counts.clear();
+    offsets.clear();
+    baseVertices.clear();
+    screenPixels = 0.0f;
+    instanceCount = 0;
+    indirectBuffer = 0;
+    indirectOffset = 0;
+    indirectCount = 0;
+}
+
+void MeshDraw::Add(GLuint indexOffset, GLsizei indexCount, GLenum indexType, GLint baseVertex)
+{
+    if(!counts.empty() && baseVertices.back() == baseVertex)
+    {
+        std::uintptr_t end = (std::uintptr_t)offsets.back() + (std::uintptr_t)counts.back() * IndexTypeSize(indexType);
+        if(end == indexOffset)
+        {
+            counts.back() += indexCount;
+            return;
+        }
+    }
+
+    counts.push_back(indexCount);
+    offsets.push_back((GLvoid*)(std::uintptr_t)indexOffset);
+    baseVertices.push_back(baseVertex);
 }
\ No newline at end of file
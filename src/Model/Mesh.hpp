@@ -16,18 +16,85 @@ WARN_GUARD_OFF
 
 #include "../Texture/Texture.hpp"
 
+/// A simplified version of a mesh: another range of the model's EBO over the same vertices
+struct MeshLod
+{
+    GLuint  indexOffset;            /// Byte offset of this LOD's indices in the model's EBO
+    GLsizei indexCount;             /// Number of indices of this LOD
+
+}; //~ MeshLod
+
+/// A cluster of up to 64 vertices and 124 triangles of a mesh, with the bounds used to cull it.
+/// Meshlets are consecutive runs of the mesh's full detail indices
+struct Meshlet
+{
+    GLuint    firstIndex;           /// First index of this meshlet, relative to the mesh's indexOffset
+    GLsizei   indexCount;           /// Number of indices of this meshlet
+    glm::vec3 center;               /// Bounding sphere
+    float     radius;
+    glm::vec3 coneApex;             /// Normal cone. Every triangle faces away from cameras inside it
+    glm::vec3 coneAxis;
+    float     coneCutoff;           /// Sine of the cone's half angle. 1 or more when it can't be culled
+
+    /// Checks if every triangle of this meshlet faces away from given camera position
+    bool IsBackfacing(const glm::vec3& cameraPosition) const;
+
+}; //~ Meshlet
+
 /// Mesh class to bundle a mesh's properties
 struct Mesh
 {
-    GLuint ebo;                     /// EBO for this mesh
-    GLuint vbo;                     /// VBO for this mesh
-    std::vector<GLuint> indices;    /// Indices of this mesh
+    std::vector<GLuint> indices;    /// Indices of this mesh, relative to baseVertex. Empty when loaded from a cooked file
+    GLuint indexOffset;             /// Byte offset of this mesh's indices in the model's EBO (and ModelData::indexData)
+    GLsizei indexCount;             /// Number of indices of this mesh
+    GLenum indexType;               /// GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    unsigned int baseVertex;        /// First vertex of this mesh in the model's VBO, added to every index when drawing
+    std::vector<MeshLod> lods;      /// Simplified versions of this mesh, LOD 1 first. LOD 0 is the range above
+    std::vector<Meshlet> meshlets;  /// Clusters of the full detail mesh, in index order
     std::vector<Texture> textures;  /// Textures of this mesh
-    unsigned int dataOffset;        /// Starting position in mData
+    unsigned int vertexCount;       /// Number of vertices of this mesh
+    glm::vec3 positionScale;        /// Dequantization of compact positions: position * scale + offset
+    glm::vec3 positionOffset;
+    bool alphaTested;               /// Cut out where the diffuse map is transparent (the material has an opacity map)
+    glm::vec3 boundsMin;            /// Bounding box, in model space
+    glm::vec3 boundsMax;
+    glm::vec3 boundsCenter;         /// Bounding sphere centered on the box, in model space
+    float boundsRadius;
 
     /// Constructor
     Mesh();
 
+    /// Checks if this mesh has a texture of given type
+    bool HasTexture(TextureType type) const;
+
+    /// Checks if given texture has to be loaded with its alpha channel
+    bool NeedsAlpha(const Texture& texture) const;
+
+    /// Retrieves the index range of given LOD. LODs past the coarsest one get the coarsest one
+    MeshLod GetLod(unsigned int lod) const;
+
 }; //~ Mesh
 
-#endif //~ ELESWORD_MESH_HPP
+/// Index ranges of a mesh, submitted with a single glMultiDrawElementsBaseVertex call,
+/// or with one glDrawElementsInstancedBaseVertex call per range when instanced.
+/// Draws written by the GPU go with one glMultiDrawElementsIndirect call instead
+struct MeshDraw
+{
+    std::vector<GLsizei> counts;       /// Number of indices of every range
+    std::vector<GLvoid*> offsets;      /// Byte offset of every range in the model's EBO
+    std::vector<GLint>   baseVertices; /// Base vertex of every range
+    float                screenPixels = 0.0f; /// Size of the mesh on screen in pixels, 0 if unknown. Drives texture streaming
+    GLsizei              instanceCount = 0;   /// Instances to draw, 0 when the model matrix comes from the model uniform
+    GLuint               indirectBuffer = 0;  /// Buffer of DrawElementsIndirectCommands to draw instead of the ranges, 0 if none
+    GLintptr             indirectOffset = 0;  /// Byte offset of the first command in indirectBuffer
+    GLsizei              indirectCount = 0;   /// Number of commands, tightly packed
+
+    /// Removes all ranges and forgets the screen size, instance count and indirect commands
+    void Clear();
+
+    /// Appends a range. Merged with the previous one when they are contiguous
+    void Add(GLuint indexOffset, GLsizei indexCount, GLenum indexType, GLint baseVertex);
+
+}; //~ MeshDraw
+
+#endif //~ ELESWORD_MESH_HPP
\ No newline at end of file
@@ -0,0 +1,374 @@
+#include "MeshOptimizer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include "../Util/WarnGuard.hpp"
+
+WARN_GUARD_ON
+#include <glm/glm.hpp>
+WARN_GUARD_OFF
+
+namespace
+{
+    const GLuint Unused = ~0u;
+
+    /// Triangles that use each vertex, in a flat list indexed by per vertex offsets
+    struct Adjacency
+    {
+        std::vector<unsigned int> offsets;   /// vertexCount + 1 offsets into triangles
+        std::vector<unsigned int> triangles; /// Triangle ids grouped by vertex
+    };
+
+    Adjacency BuildAdjacency(const std::vector<GLuint>& indices, unsigned int vertexCount)
+    {
+        Adjacency adjacency;
+        adjacency.offsets.assign(vertexCount + 1, 0);
+        for(GLuint index : indices)
+            adjacency.offsets[index + 1]++;
+        for(unsigned int v = 0; v < vertexCount; v++)
+            adjacency.offsets[v + 1] += adjacency.offsets[v];
+
+        std::vector<unsigned int> fill(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+        adjacency.triangles.resize(indices.size());
+        for(std::size_t i = 0; i < indices.size(); i++)
+            adjacency.triangles[fill[indices[i]]++] = (unsigned int)(i / 3);
+
+        return adjacency;
+    }
+
+    /// FIFO post-transform cache. A vertex is cached until size other vertices missed after it
+    class FifoCache
+    {
+    public:
+        FifoCache(unsigned int vertexCount, unsigned int size)
+            : mStamps(vertexCount, 0)
+            , mTime(size + 1)
+            , mSize(size)
+        {
+        }
+
+        /// Retrieves the number of misses (0 - 3) of given triangle
+        unsigned int Triangle(const std::vector<GLuint>& indices, std::size_t triangle)
+        {
+            unsigned int misses = 0;
+            for(std::size_t c = 0; c < 3; c++)
+            {
+                GLuint v = indices[triangle * 3 + c];
+                if(mTime - mStamps[v] > mSize)
+                {
+                    mStamps[v] = mTime++;
+                    misses++;
+                }
+            }
+            return misses;
+        }
+
+        /// Evicts everything
+        void Flush()
+        {
+            mTime += mSize + 1;
+        }
+
+    private:
+        std::vector<unsigned int> mStamps;
+        unsigned int              mTime;
+        unsigned int              mSize;
+    };
+
+    /// Tipsify fallback when the fanning vertex has no candidate left: the most recent
+    /// live vertex on the dead end stack, otherwise the next live vertex in input order.
+    /// cold is set when the cursor had to be used. Returns -1 when everything was emitted
+    long SkipDeadEnd(
+        std::vector<GLuint>& deadEnd,
+        const std::vector<unsigned int>& live,
+        unsigned int& cursor,
+        bool& cold)
+    {
+        while(!deadEnd.empty())
+        {
+            GLuint v = deadEnd.back();
+            deadEnd.pop_back();
+            if(live[v] > 0)
+            {
+                cold = false;
+                return (long)v;
+            }
+        }
+
+        for(; cursor < live.size(); cursor++)
+        {
+            if(live[cursor] > 0)
+            {
+                cold = true;
+                return (long)cursor;
+            }
+        }
+
+        return -1;
+    }
+
+    glm::vec3 ReadPosition(const float* positions, std::size_t stride, GLuint v)
+    {
+        const float* p = reinterpret_cast<const float*>(reinterpret_cast<const unsigned char*>(positions) + v * stride);
+        return glm::vec3(p[0], p[1], p[2]);
+    }
+}
+
+//--------------------------------------------------
+// MeshOptimizer
+//--------------------------------------------------
+namespace MeshOptimizer
+{
+    CacheStats AnalyzeVertexCache(
+        const std::vector<GLuint>& indices,
+        unsigned int vertexCount,
+        unsigned int cacheSize)
+    {
+        CacheStats stats = { 0.0f, 0.0f };
+        const std::size_t triangleCount = indices.size() / 3;
+        if(triangleCount == 0)
+            return stats;
+
+        FifoCache cache(vertexCount, cacheSize);
+        std::vector<bool> referenced(vertexCount, false);
+        std::size_t misses = 0;
+        std::size_t uniqueVertices = 0;
+
+        for(std::size_t t = 0; t < triangleCount; t++)
+            misses += cache.Triangle(indices, t);
+
+        for(GLuint index : indices)
+        {
+            if(!referenced[index])
+            {
+                referenced[index] = true;
+                uniqueVertices++;
+            }
+        }
+
+        stats.acmr = (float)misses / (float)triangleCount;
+        stats.atvr = (float)misses / (float)uniqueVertices;
+        return stats;
+    }
+
+    std::vector<std::size_t> OptimizeVertexCache(
+        std::vector<GLuint>& indices,
+        unsigned int vertexCount,
+        unsigned int cacheSize)
+    {
+        std::vector<std::size_t> clusters;
+        const std::size_t triangleCount = indices.size() / 3;
+        if(triangleCount == 0 || indices.size() % 3 != 0)
+            return clusters;
+
+        const Adjacency adjacency = BuildAdjacency(indices, vertexCount);
+
+        // Triangles not emitted yet per vertex
+        std::vector<unsigned int> live(vertexCount);
+        for(unsigned int v = 0; v < vertexCount; v++)
+            live[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+
+        std::vector<unsigned int> stamps(vertexCount, 0);
+        std::vector<bool> emitted(triangleCount, false);
+        std::vector<GLuint> deadEnd;
+        std::vector<GLuint> candidates;
+        std::vector<GLuint> result;
+        result.reserve(indices.size());
+
+        unsigned int time = cacheSize + 1;
+        unsigned int cursor = 0;
+        bool cold = true;
+        long fanning = SkipDeadEnd(deadEnd, live, cursor, cold);
+
+        while(fanning >= 0)
+        {
+            if(cold)
+                clusters.push_back(result.size() / 3);
+
+            // Emit every remaining triangle around the fanning vertex
+            candidates.clear();
+            for(unsigned int k = adjacency.offsets[fanning]; k < adjacency.offsets[fanning + 1]; k++)
+            {
+                const unsigned int t = adjacency.triangles[k];
+                if(emitted[t])
+                    continue;
+
+                for(std::size_t c = 0; c < 3; c++)
+                {
+                    GLuint v = indices[t * 3 + c];
+                    result.push_back(v);
+                    deadEnd.push_back(v);
+                    candidates.push_back(v);
+                    live[v]--;
+
+                    if(time - stamps[v] > cacheSize)
+                        stamps[v] = time++;
+                }
+                emitted[t] = true;
+            }
+
+            // Next fanning vertex: the oldest candidate that stays cached while its triangles are emitted
+            long next = -1;
+            long bestPriority = -1;
+            for(GLuint v : candidates)
+            {
+                if(live[v] == 0)
+                    continue;
+
+                long priority = 0;
+                if(time - stamps[v] + 2 * live[v] <= cacheSize)
+                    priority = (long)(time - stamps[v]);
+
+                if(priority > bestPriority)
+                {
+                    bestPriority = priority;
+                    next = (long)v;
+                }
+            }
+
+            cold = false;
+            if(next < 0)
+                next = SkipDeadEnd(deadEnd, live, cursor, cold);
+
+            fanning = next;
+        }
+
+        indices.swap(result);
+        return clusters;
+    }
+
+    void OptimizeOverdraw(
+        std::vector<GLuint>& indices,
+        const std::vector<std::size_t>& clusters,
+        const float* positions,
+        std::size_t positionStride,
+        unsigned int vertexCount,
+        float threshold,
+        unsigned int cacheSize)
+    {
+        const std::size_t triangleCount = indices.size() / 3;
+        if(triangleCount == 0 || clusters.empty() || indices.size() % 3 != 0)
+            return;
+
+        // Split the clusters wherever the part so far already reaches the ACMR
+        // of the whole cluster, give or take the threshold
+        std::vector<std::size_t> softClusters;
+        FifoCache cache(vertexCount, cacheSize);
+
+        for(std::size_t c = 0; c < clusters.size(); c++)
+        {
+            const std::size_t first = clusters[c];
+            const std::size_t last = (c + 1 < clusters.size()) ? clusters[c + 1] : triangleCount;
+
+            cache.Flush();
+            std::size_t misses = 0;
+            for(std::size_t t = first; t < last; t++)
+                misses += cache.Triangle(indices, t);
+            const float clusterAcmr = (float)misses / (float)(last - first);
+
+            cache.Flush();
+            softClusters.push_back(first);
+            std::size_t start = first;
+            misses = 0;
+            for(std::size_t t = first; t + 1 < last; t++)
+            {
+                misses += cache.Triangle(indices, t);
+                if((float)misses / (float)(t + 1 - start) <= clusterAcmr * threshold)
+                {
+                    softClusters.push_back(t + 1);
+                    start = t + 1;
+                    misses = 0;
+                    cache.Flush();
+                }
+            }
+        }
+
+        // Area weighted centroid and normal of every cluster
+        const std::size_t clusterCount = softClusters.size();
+        std::vector<glm::vec3> centroids(clusterCount, glm::vec3(0.0f));
+        std::vector<glm::vec3> normals(clusterCount, glm::vec3(0.0f));
+        std::vector<float> areas(clusterCount, 0.0f);
+        glm::vec3 meshCentroid(0.0f);
+        float meshArea = 0.0f;
+
+        for(std::size_t c = 0; c < clusterCount; c++)
+        {
+            const std::size_t last = (c + 1 < clusterCount) ? softClusters[c + 1] : triangleCount;
+            for(std::size_t t = softClusters[c]; t < last; t++)
+            {
+                glm::vec3 p0 = ReadPosition(positions, positionStride, indices[t * 3 + 0]);
+                glm::vec3 p1 = ReadPosition(positions, positionStride, indices[t * 3 + 1]);
+                glm::vec3 p2 = ReadPosition(positions, positionStride, indices[t * 3 + 2]);
+
+                glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+                float area = glm::length(normal);
+
+                centroids[c] += (p0 + p1 + p2) * (area / 3.0f);
+                normals[c] += normal;
+                areas[c] += area;
+            }
+
+            meshCentroid += centroids[c];
+            meshArea += areas[c];
+            if(areas[c] > 0.0f)
+                centroids[c] /= areas[c];
+        }
+        if(meshArea > 0.0f)
+            meshCentroid /= meshArea;
+
+        // Clusters far out and facing away from the center are likely to occlude the rest
+        std::vector<float> sortKeys(clusterCount, 0.0f);
+        for(std::size_t c = 0; c < clusterCount; c++)
+        {
+            float length = glm::length(normals[c]);
+            if(length > 0.0f)
+                sortKeys[c] = glm::dot(centroids[c] - meshCentroid, normals[c] / length);
+        }
+
+        std::vector<std::size_t> order(clusterCount);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&sortKeys](std::size_t a, std::size_t b)
+        {
+            return sortKeys[a] > sortKeys[b];
+        });
+
+        std::vector<GLuint> result;
+        result.reserve(indices.size());
+        for(std::size_t c : order)
+        {
+            const std::size_t last = (c + 1 < clusterCount) ? softClusters[c + 1] : triangleCount;
+            result.insert(result.end(), indices.begin() + softClusters[c] * 3, indices.begin() + last * 3);
+        }
+
+        indices.swap(result);
+    }
+
+    std::vector<GLuint> OptimizeVertexFetch(
+        std::vector<GLuint>& indices,
+        unsigned int vertexCount)
+    {
+        std::vector<GLuint> remap(vertexCount, Unused);
+        std::vector<GLuint> order;
+        order.reserve(vertexCount);
+
+        for(GLuint& index : indices)
+        {
+            if(remap[index] == Unused)
+            {
+                remap[index] = (GLuint)order.size();
+                order.push_back(index);
+            }
+            index = remap[index];
+        }
+
+        for(GLuint v = 0; v < vertexCount; v++)
+        {
+            if(remap[v] == Unused)
+                order.push_back(v);
+        }
+
+        return order;
+    }
+
+} //~ namespace MeshOptimizer
\ No newline at end of file
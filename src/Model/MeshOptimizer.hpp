@@ -0,0 +1,64 @@
+#ifndef ELESWORD_MESH_OPTIMIZER_HPP
+#define ELESWORD_MESH_OPTIMIZER_HPP
+
+#include <cstddef>
+#include <vector>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+/// Triangle and vertex reordering of indexed triangle lists, run once at import.
+/// All functions work on indices local to a single mesh.
+namespace MeshOptimizer
+{
+    /// Size of the FIFO post-transform cache the reordering targets
+    const unsigned int CacheSize = 16;
+
+    /// Default ACMR slack allowed when splitting clusters for overdraw
+    const float OverdrawThreshold = 1.05f;
+
+    /// Vertex shader invocations of a triangle list on a FIFO cache
+    struct CacheStats
+    {
+        float acmr; /// Average cache miss ratio: transformed vertices per triangle (0.5 - 3)
+        float atvr; /// Average transformed vertex ratio: transformed vertices per vertex (1 is optimal)
+
+    }; //~ CacheStats
+
+    /// Simulates a FIFO post-transform cache of given size over the indices
+    CacheStats AnalyzeVertexCache(
+        const std::vector<GLuint>& indices,
+        unsigned int vertexCount,
+        unsigned int cacheSize = CacheSize);
+
+    /// Reorders triangles for the post-transform cache (Tipsify, Sander et al. 2007).
+    /// Returns the first triangle of every cluster, i.e. the points where the
+    /// ordering hit a dead end and the cache got cold
+    std::vector<std::size_t> OptimizeVertexCache(
+        std::vector<GLuint>& indices,
+        unsigned int vertexCount,
+        unsigned int cacheSize = CacheSize);
+
+    /// Reorders the clusters of OptimizeVertexCache so that outer, outward facing
+    /// ones come first and occlude the rest. Clusters are split further where that
+    /// costs less than threshold times their ACMR. Positions are read as 3 floats
+    /// every positionStride bytes
+    void OptimizeOverdraw(
+        std::vector<GLuint>& indices,
+        const std::vector<std::size_t>& clusters,
+        const float* positions,
+        std::size_t positionStride,
+        unsigned int vertexCount,
+        float threshold = OverdrawThreshold,
+        unsigned int cacheSize = CacheSize);
+
+    /// Renumbers vertices in the order the indices first reference them and
+    /// rewrites the indices. Returns the new vertex order: order[new] = old.
+    /// Unreferenced vertices are kept at the end
+    std::vector<GLuint> OptimizeVertexFetch(
+        std::vector<GLuint>& indices,
+        unsigned int vertexCount);
+
+} //~ namespace MeshOptimizer
+
+#endif //~ ELESWORD_MESH_OPTIMIZER_HPP
\ No newline at end of file
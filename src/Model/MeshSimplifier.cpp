@@ -0,0 +1,292 @@
+#include "MeshSimplifier.hpp"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include "../Util/WarnGuard.hpp"
+
+WARN_GUARD_ON
+#include <glm/glm.hpp>
+WARN_GUARD_OFF
+
+namespace
+{
+    /// Sum of squared distances to a set of planes, as a symmetric 4x4 matrix
+    struct Quadric
+    {
+        double a00, a01, a02, a11, a12, a22;
+        double b0, b1, b2;
+        double c;
+
+        static Quadric FromPlane(const glm::dvec3& n, double d)
+        {
+            Quadric q;
+            q.a00 = n.x * n.x; q.a01 = n.x * n.y; q.a02 = n.x * n.z;
+            q.a11 = n.y * n.y; q.a12 = n.y * n.z; q.a22 = n.z * n.z;
+            q.b0  = n.x * d;   q.b1  = n.y * d;   q.b2  = n.z * d;
+            q.c   = d * d;
+            return q;
+        }
+
+        Quadric& operator+=(const Quadric& o)
+        {
+            a00 += o.a00; a01 += o.a01; a02 += o.a02;
+            a11 += o.a11; a12 += o.a12; a22 += o.a22;
+            b0  += o.b0;  b1  += o.b1;  b2  += o.b2;
+            c   += o.c;
+            return *this;
+        }
+
+        double Evaluate(const glm::dvec3& p) const
+        {
+            double r = a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z
+                     + 2.0 * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z)
+                     + 2.0 * (b0 * p.x + b1 * p.y + b2 * p.z)
+                     + c;
+            return std::max(r, 0.0);
+        }
+    };
+
+    /// Moving vertex 'from' onto vertex 'to'
+    struct Collapse
+    {
+        GLuint from;
+        GLuint to;
+        double cost;
+    };
+
+    /// Marks vertices that share their position with another vertex, i.e. that lie on a seam
+    void LockSeams(const std::vector<glm::vec3>& positions, std::vector<bool>& locked)
+    {
+        std::vector<GLuint> sorted(positions.size());
+        std::iota(sorted.begin(), sorted.end(), 0);
+        auto less = [&positions](GLuint a, GLuint b)
+        {
+            const glm::vec3& p = positions[a];
+            const glm::vec3& q = positions[b];
+            if(p.x != q.x) return p.x < q.x;
+            if(p.y != q.y) return p.y < q.y;
+            return p.z < q.z;
+        };
+        std::sort(sorted.begin(), sorted.end(), less);
+
+        for(std::size_t i = 1; i < sorted.size(); i++)
+        {
+            if(positions[sorted[i]] == positions[sorted[i - 1]])
+                locked[sorted[i]] = locked[sorted[i - 1]] = true;
+        }
+    }
+
+    /// Marks the vertices of edges used by a single triangle
+    void LockBorders(const std::vector<GLuint>& indices, std::vector<bool>& locked)
+    {
+        std::vector<std::pair<GLuint, GLuint>> edges;
+        edges.reserve(indices.size());
+        for(std::size_t i = 0; i < indices.size(); i += 3)
+        {
+            for(std::size_t e = 0; e < 3; e++)
+            {
+                GLuint a = indices[i + e];
+                GLuint b = indices[i + (e + 1) % 3];
+                edges.emplace_back(std::min(a, b), std::max(a, b));
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+
+        for(std::size_t i = 0; i < edges.size();)
+        {
+            std::size_t j = i + 1;
+            while(j < edges.size() && edges[j] == edges[i])
+                j++;
+
+            if(j - i == 1)
+                locked[edges[i].first] = locked[edges[i].second] = true;
+            i = j;
+        }
+    }
+
+    glm::vec3 TriangleNormal(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2)
+    {
+        return glm::cross(p1 - p0, p2 - p0);
+    }
+}
+
+//--------------------------------------------------
+// MeshSimplifier
+//--------------------------------------------------
+namespace MeshSimplifier
+{
+    std::vector<GLuint> Simplify(
+        const std::vector<GLuint>& indices,
+        const float* positions,
+        std::size_t positionStride,
+        unsigned int vertexCount,
+        std::size_t targetIndexCount,
+        float maxError,
+        float* resultError)
+    {
+        std::vector<GLuint> result(indices);
+        const double costLimit = (double)maxError * maxError;
+        double maxCost = 0.0;
+
+        if(resultError)
+            *resultError = 0.0f;
+        if(result.size() <= targetIndexCount || result.size() % 3 != 0)
+            return result;
+
+        std::vector<glm::vec3> points(vertexCount);
+        for(unsigned int v = 0; v < vertexCount; v++)
+        {
+            const float* p = reinterpret_cast<const float*>(reinterpret_cast<const unsigned char*>(positions) + v * positionStride);
+            points[v] = glm::vec3(p[0], p[1], p[2]);
+        }
+
+        std::vector<bool> locked(vertexCount, false);
+        LockSeams(points, locked);
+        LockBorders(result, locked);
+
+        // Plane quadrics of every triangle, summed per vertex
+        std::vector<Quadric> quadrics(vertexCount, Quadric::FromPlane(glm::dvec3(0.0), 0.0));
+        for(std::size_t i = 0; i < result.size(); i += 3)
+        {
+            glm::dvec3 n(TriangleNormal(points[result[i]], points[result[i + 1]], points[result[i + 2]]));
+            double length = glm::length(n);
+            if(length == 0.0)
+                continue;
+
+            n /= length;
+            Quadric q = Quadric::FromPlane(n, -glm::dot(n, glm::dvec3(points[result[i]])));
+            for(std::size_t c = 0; c < 3; c++)
+                quadrics[result[i + c]] += q;
+        }
+
+        std::vector<unsigned int> offsets;
+        std::vector<unsigned int> adjacency;
+        std::vector<Collapse> collapses;
+        std::vector<GLuint> remap(vertexCount);
+        std::vector<bool> touched(vertexCount);
+
+        // Each pass collapses the cheapest edges that don't share triangles, then compacts
+        for(;;)
+        {
+            const std::size_t triangleCount = result.size() / 3;
+
+            // Triangles around every vertex
+            offsets.assign(vertexCount + 1, 0);
+            for(GLuint index : result)
+                offsets[index + 1]++;
+            for(unsigned int v = 0; v < vertexCount; v++)
+                offsets[v + 1] += offsets[v];
+            adjacency.resize(result.size());
+            {
+                std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+                for(std::size_t i = 0; i < result.size(); i++)
+                    adjacency[fill[result[i]]++] = (unsigned int)(i / 3);
+            }
+
+            // Candidate collapses along every edge, both ways
+            collapses.clear();
+            for(std::size_t i = 0; i < result.size(); i += 3)
+            {
+                for(std::size_t e = 0; e < 3; e++)
+                {
+                    GLuint a = result[i + e];
+                    GLuint b = result[i + (e + 1) % 3];
+
+                    Quadric q = quadrics[a];
+                    q += quadrics[b];
+                    if(!locked[a])
+                        collapses.push_back({ a, b, q.Evaluate(glm::dvec3(points[b])) });
+                    if(!locked[b])
+                        collapses.push_back({ b, a, q.Evaluate(glm::dvec3(points[a])) });
+                }
+            }
+            std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y)
+            {
+                return x.cost < y.cost;
+            });
+
+            std::iota(remap.begin(), remap.end(), 0);
+            std::fill(touched.begin(), touched.end(), false);
+
+            std::size_t remaining = triangleCount;
+            std::size_t collapsed = 0;
+            for(const Collapse& collapse : collapses)
+            {
+                if(remaining * 3 <= targetIndexCount || collapse.cost > costLimit)
+                    break;
+
+                const GLuint a = collapse.from;
+                const GLuint b = collapse.to;
+                if(touched[a] || touched[b])
+                    continue;
+
+                // Reject collapses that flip a triangle around a
+                bool flips = false;
+                std::size_t removed = 0;
+                for(unsigned int k = offsets[a]; k < offsets[a + 1] && !flips; k++)
+                {
+                    const GLuint* tri = &result[adjacency[k] * 3];
+                    if(tri[0] == b || tri[1] == b || tri[2] == b)
+                    {
+                        removed++;
+                        continue;
+                    }
+
+                    glm::vec3 p[3], q[3];
+                    for(std::size_t c = 0; c < 3; c++)
+                    {
+                        p[c] = points[tri[c]];
+                        q[c] = (tri[c] == a) ? points[b] : p[c];
+                    }
+                    glm::vec3 before = TriangleNormal(p[0], p[1], p[2]);
+                    glm::vec3 after = TriangleNormal(q[0], q[1], q[2]);
+                    flips = glm::dot(before, after) <= 0.0f;
+                }
+                if(flips)
+                    continue;
+
+                remap[a] = b;
+                quadrics[b] += quadrics[a];
+                maxCost = std::max(maxCost, collapse.cost);
+                remaining -= removed;
+                collapsed++;
+
+                // The triangles around a changed, keep their vertices out of this pass
+                for(unsigned int k = offsets[a]; k < offsets[a + 1]; k++)
+                {
+                    const GLuint* tri = &result[adjacency[k] * 3];
+                    touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = true;
+                }
+            }
+
+            if(collapsed == 0)
+                break;
+
+            // Apply the collapses and drop the triangles that became degenerate
+            std::size_t out = 0;
+            for(std::size_t i = 0; i < result.size(); i += 3)
+            {
+                GLuint a = remap[result[i]];
+                GLuint b = remap[result[i + 1]];
+                GLuint c = remap[result[i + 2]];
+                if(a == b || b == c || c == a)
+                    continue;
+
+                result[out++] = a;
+                result[out++] = b;
+                result[out++] = c;
+            }
+            result.resize(out);
+
+            if(result.size() <= targetIndexCount)
+                break;
+        }
+
+        if(resultError)
+            *resultError = (float)std::sqrt(maxCost);
+
+        return result;
+    }
+
+} //~ namespace MeshSimplifier
\ No newline at end of file
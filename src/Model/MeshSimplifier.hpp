@@ -0,0 +1,32 @@
+#ifndef ELESWORD_MESH_SIMPLIFIER_HPP
+#define ELESWORD_MESH_SIMPLIFIER_HPP
+
+#include <cstddef>
+#include <vector>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+/// Quadric error edge collapse (Garland & Heckbert 1997) of indexed triangle lists.
+/// Collapses move a vertex onto one of its neighbours, so the simplified indices
+/// reuse the original vertices and their normals and texcoords are kept as they are.
+/// Vertices on UV/normal seams (distinct vertices sharing a position) and on open
+/// borders never move, so seams don't tear and silhouettes of open meshes stay put.
+namespace MeshSimplifier
+{
+    /// Simplifies the triangles until there are at most targetIndexCount indices
+    /// left, or no collapse within maxError (in model units) is possible.
+    /// Positions are read as 3 floats every positionStride bytes. Optionally
+    /// returns the largest error of the collapses that were made
+    std::vector<GLuint> Simplify(
+        const std::vector<GLuint>& indices,
+        const float* positions,
+        std::size_t positionStride,
+        unsigned int vertexCount,
+        std::size_t targetIndexCount,
+        float maxError,
+        float* resultError = nullptr);
+
+} //~ namespace MeshSimplifier
+
+#endif //~ ELESWORD_MESH_SIMPLIFIER_HPP
\ No newline at end of file
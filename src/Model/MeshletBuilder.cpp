@@ -0,0 +1,147 @@
+#include "MeshletBuilder.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+    glm::vec3 ReadPosition(const float* positions, std::size_t stride, GLuint v)
+    {
+        const float* p = reinterpret_cast<const float*>(reinterpret_cast<const unsigned char*>(positions) + v * stride);
+        return glm::vec3(p[0], p[1], p[2]);
+    }
+
+    /// Fills the bounding sphere and normal cone of the triangles [first, last)
+    void ComputeBounds(
+        const std::vector<GLuint>& indices,
+        std::size_t first,
+        std::size_t last,
+        const float* positions,
+        std::size_t positionStride,
+        Meshlet& meshlet)
+    {
+        // Sphere around the bounding box
+        glm::vec3 lo(std::numeric_limits<float>::max());
+        glm::vec3 hi(-std::numeric_limits<float>::max());
+        for(std::size_t i = first * 3; i < last * 3; i++)
+        {
+            glm::vec3 p = ReadPosition(positions, positionStride, indices[i]);
+            lo = glm::min(lo, p);
+            hi = glm::max(hi, p);
+        }
+
+        meshlet.center = (lo + hi) * 0.5f;
+        meshlet.radius = 0.0f;
+        for(std::size_t i = first * 3; i < last * 3; i++)
+            meshlet.radius = std::max(meshlet.radius, glm::length(ReadPosition(positions, positionStride, indices[i]) - meshlet.center));
+
+        // Cone around the average triangle normal
+        std::vector<glm::vec3> normals;
+        std::vector<glm::vec3> corners;
+        glm::vec3 axis(0.0f);
+        for(std::size_t t = first; t < last; t++)
+        {
+            glm::vec3 p0 = ReadPosition(positions, positionStride, indices[t * 3 + 0]);
+            glm::vec3 p1 = ReadPosition(positions, positionStride, indices[t * 3 + 1]);
+            glm::vec3 p2 = ReadPosition(positions, positionStride, indices[t * 3 + 2]);
+
+            glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+            float area = glm::length(normal);
+            if(area == 0.0f)
+                continue;
+
+            normals.push_back(normal / area);
+            corners.push_back(p0);
+            axis += normals.back();
+        }
+
+        meshlet.coneApex = meshlet.center;
+        meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+        meshlet.coneCutoff = 1.0f;
+
+        float axisLength = glm::length(axis);
+        if(axisLength == 0.0f)
+            return;
+        axis /= axisLength;
+
+        float minDot = 1.0f;
+        for(const glm::vec3& normal : normals)
+            minDot = std::min(minDot, glm::dot(normal, axis));
+
+        // Normals spread over a hemisphere or more, some triangle always faces the camera
+        if(minDot <= 0.1f)
+            return;
+
+        // Move the apex back along the axis until it is behind every triangle's plane
+        float maxT = 0.0f;
+        for(std::size_t i = 0; i < normals.size(); i++)
+            maxT = std::max(maxT, glm::dot(meshlet.center - corners[i], normals[i]) / glm::dot(axis, normals[i]));
+
+        meshlet.coneApex = meshlet.center - axis * maxT;
+        meshlet.coneAxis = axis;
+        meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+    }
+}
+
+//--------------------------------------------------
+// MeshletBuilder
+//--------------------------------------------------
+namespace MeshletBuilder
+{
+    std::vector<Meshlet> Build(
+        const std::vector<GLuint>& indices,
+        const float* positions,
+        std::size_t positionStride,
+        unsigned int vertexCount)
+    {
+        std::vector<Meshlet> meshlets;
+        const std::size_t triangleCount = indices.size() / 3;
+        if(triangleCount == 0 || indices.size() % 3 != 0)
+            return meshlets;
+
+        // Meshlet that last used every vertex, plus one
+        std::vector<std::size_t> owner(vertexCount, 0);
+
+        std::size_t first = 0;
+        unsigned int uniqueVertices = 0;
+        for(std::size_t t = 0; t <= triangleCount; t++)
+        {
+            unsigned int newVertices = 0;
+            if(t < triangleCount)
+            {
+                for(std::size_t c = 0; c < 3; c++)
+                {
+                    if(owner[indices[t * 3 + c]] != meshlets.size() + 1)
+                        newVertices++;
+                }
+            }
+
+            // Close the current meshlet when the triangle doesn't fit or at the end
+            if(t == triangleCount
+            || uniqueVertices + newVertices > MaxVertices
+            || t - first + 1 > MaxTriangles)
+            {
+                Meshlet meshlet;
+                meshlet.firstIndex = (GLuint)(first * 3);
+                meshlet.indexCount = (GLsizei)((t - first) * 3);
+                ComputeBounds(indices, first, t, positions, positionStride, meshlet);
+                meshlets.push_back(meshlet);
+
+                if(t == triangleCount)
+                    break;
+
+                first = t;
+                uniqueVertices = 3;
+            }
+            else
+                uniqueVertices += newVertices;
+
+            // Mark the triangle's vertices as part of the current meshlet
+            for(std::size_t c = 0; c < 3; c++)
+                owner[indices[t * 3 + c]] = meshlets.size() + 1;
+        }
+
+        return meshlets;
+    }
+
+} //~ namespace MeshletBuilder
\ No newline at end of file
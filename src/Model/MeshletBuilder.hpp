@@ -0,0 +1,30 @@
+#ifndef ELESWORD_MESHLET_BUILDER_HPP
+#define ELESWORD_MESHLET_BUILDER_HPP
+
+#include <cstddef>
+#include <vector>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include "Mesh.hpp"
+
+/// Splits indexed triangle lists in meshlets, run once at import
+namespace MeshletBuilder
+{
+    const unsigned int MaxVertices  = 64;
+    const unsigned int MaxTriangles = 124;
+
+    /// Cuts the triangles in consecutive runs of at most MaxVertices unique vertices and
+    /// MaxTriangles triangles, keeping their order, and computes the bounds of every run.
+    /// Best used on indices already ordered for the vertex cache, whose runs are compact.
+    /// Positions are read as 3 floats every positionStride bytes
+    std::vector<Meshlet> Build(
+        const std::vector<GLuint>& indices,
+        const float* positions,
+        std::size_t positionStride,
+        unsigned int vertexCount);
+
+} //~ namespace MeshletBuilder
+
+#endif //~ ELESWORD_MESHLET_BUILDER_HPP
\ No newline at end of file
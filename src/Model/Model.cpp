@@ -1,15 +1,60 @@
 #include "Model.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+    /// Screen sizes (projected bounding sphere diameter over viewport height)
+    /// below which LOD 1, 2 and 3 are drawn
+    const float LodScreenSizes[ModelData::MaxLods - 1] = { 0.5f, 0.25f, 0.125f };
+
+    /// Fraction of a threshold the size has to move past it before the LOD changes back
+    const float LodHysteresis = 0.1f;
+
+    /// World space box around a model space box moved by given matrix (Arvo)
+    void TransformBounds(const glm::mat4& model, const glm::vec3& boundsMin, const glm::vec3& boundsMax, glm::vec3& worldMin, glm::vec3& worldMax)
+    {
+        const glm::vec3 center = glm::vec3(model * glm::vec4((boundsMin + boundsMax) * 0.5f, 1.0f));
+        const glm::vec3 extents = (boundsMax - boundsMin) * 0.5f;
+        glm::vec3 worldExtents;
+        for(int row = 0; row < 3; row++)
+        {
+            worldExtents[row] = std::fabs(model[0][row]) * extents.x
+                              + std::fabs(model[1][row]) * extents.y
+                              + std::fabs(model[2][row]) * extents.z;
+        }
+        worldMin = center - worldExtents;
+        worldMax = center + worldExtents;
+    }
+}
 
 //--------------------------------------------------
 // ModelData functions
 //--------------------------------------------------
+const unsigned int ModelData::MaxLods;
+
+ModelData::ModelData()
+    : format(VertexFormat::Float)
+    , lodCount(1)
+    , boundsCenter(0.0f)
+    , boundsRadius(0.0f)
+    , boundsMin(0.0f)
+    , boundsMax(0.0f)
+    , state(State::Loading)
+    , vao(0)
+    , vbo(0)
+    , ebo(0)
+{
+}
+
 ModelData::~ModelData()
 {
-    std::vector<GLuint> meshEBOs;
-    for(Mesh mesh : meshes)
-        meshEBOs.push_back(mesh.ebo);
+    // Imported without a GL context, nothing to release
+    if(vao == 0 && vbo == 0 && ebo == 0)
+        return;
 
-    glDeleteBuffers((GLsizei)meshEBOs.size(), meshEBOs.data());
+    glDeleteBuffers(1, &ebo);
     glDeleteBuffers(1, &vbo);
     glDeleteVertexArrays(1, &vao);
 }
@@ -19,37 +64,109 @@ ModelData::~ModelData()
 //--------------------------------------------------
 std::unique_ptr<Model> Model::CreateModel(
     const ModelData* const data,
-    RenderMeshCb renderMesh)
+    RenderMeshCb renderMesh,
+    const ModelData* const placeholder)
 {
-    return (data == nullptr) ? nullptr : std::unique_ptr<Model>(new Model(data, renderMesh));
+    return (data == nullptr) ? nullptr : std::unique_ptr<Model>(new Model(data, renderMesh, placeholder));
     //return std::make_unique<Model>(filepath, loader, painter); // Needs std::make_unique to be a friend
 }
 
 //--------------------------------------------------
 // Public functions
 //--------------------------------------------------
-void Model::Render(const Shader& shader) const
+Model::~Model()
+{
+    if(mIndex != nullptr)
+        mIndex->DestroyProxy(mProxy);
+}
+
+void Model::Attach(AabbTree& index)
+{
+    if(mIndex != nullptr)
+        mIndex->DestroyProxy(mProxy);
+
+    mIndex = &index;
+    mProxy = AabbTree::Null;
+    UpdateProxy();
+}
+
+void Model::UpdateIndex()
 {
-    shader.Use();
+    if(mIndex != nullptr && GetDrawnData() != mProxyData)
+        UpdateProxy();
+}
+
+bool Model::IntersectRay(const glm::vec3& origin, const glm::vec3& direction, float& distance) const
+{
+    const ModelData* data = GetDrawnData();
+    if(data == nullptr)
+        return false;
+
+    // The ray moved to model space keeps its parameter, distances stay in world units
+    const glm::mat4 inverse = glm::inverse(mModelMat);
+    const glm::vec3 modelOrigin = glm::vec3(inverse * glm::vec4(origin, 1.0f));
+    const glm::vec3 invDirection = 1.0f / glm::vec3(inverse * glm::vec4(direction, 0.0f));
 
-    glStencilFunc(GL_ALWAYS, 1, 0xFF);
-    glStencilMask(0xFF);
+    bool hit = false;
+    distance = std::numeric_limits<float>::max();
+    for(const Mesh& mesh : data->meshes)
+    {
+        // Slab test
+        const glm::vec3 t1 = (mesh.boundsMin - modelOrigin) * invDirection;
+        const glm::vec3 t2 = (mesh.boundsMax - modelOrigin) * invDirection;
+        const glm::vec3 closer = glm::min(t1, t2);
+        const glm::vec3 further = glm::max(t1, t2);
+        const float enter = std::max(std::max(closer.x, closer.y), std::max(closer.z, 0.0f));
+        const float exit = std::min(std::min(further.x, further.y), further.z);
+        if(enter <= exit && enter < distance)
+        {
+            distance = enter;
+            hit = true;
+        }
+    }
+    return hit;
+}
 
-    // Load model matrix to GPU
-    glUniformMatrix4fv(glGetUniformLocation(shader.GetProgID(), "model"), 1, GL_FALSE, glm::value_ptr(mModelMat));
+void Model::Submit(RenderQueue& queue, const Shader& shader, const RenderView& view) const
+{
+    SubmitMeshes(queue, [&shader](const Mesh&) -> const Shader& { return shader; }, view);
+}
 
-    // Draw meshes
-    for(const Mesh& mesh : mData->meshes)
-        mRenderMesh(shader, mData->vao, mesh);
+void Model::Submit(RenderQueue& queue, ShaderVariants& shaders, unsigned int pointLights, const RenderView& view) const
+{
+    SubmitMeshes(queue, [&shaders, pointLights](const Mesh& mesh) -> const Shader&
+    {
+        ShaderFeatures features;
+        features.pointLights = pointLights;
+        features.specularMap = mesh.HasTexture(TextureType::SPECULAR);
+        features.alphaTest   = mesh.alphaTested;
+        return shaders.Get(features);
+    }, view);
 }
 
-void Model::RenderOutline(const Shader& shader) const
+void Model::AddBounds(FrustumCuller& culler) const
 {
-    shader.Use();
+    mBoundsData = GetDrawnData();
+    if(mBoundsData == nullptr)
+        return;
+
+    // Boxes of a model are consecutive
+    mBoundsFrame = culler.GetFrame();
+    mFirstBounds = 0;
+    for(std::size_t i = 0; i < mBoundsData->meshes.size(); i++)
+    {
+        const Mesh& mesh = mBoundsData->meshes[i];
+        const std::uint32_t index = culler.Add(mesh.boundsMin, mesh.boundsMax, mModelMat);
+        if(i == 0)
+            mFirstBounds = index;
+    }
+}
 
-    glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
-    glStencilMask(0x00);
-    glDisable(GL_DEPTH_TEST);
+void Model::SubmitOutline(RenderQueue& queue, const Shader& shader) const
+{
+    const ModelData* data = GetDrawnData();
+    if(data == nullptr)
+        return;
 
     // Copy model's model matrix
     glm::mat4 outlineModelMat = mModelMat;
@@ -58,25 +175,25 @@ void Model::RenderOutline(const Shader& shader) const
     outlineModelMat = glm::translate(outlineModelMat, glm::vec3(0.0f, -0.2f, 0.0f));
     outlineModelMat = glm::scale(outlineModelMat, glm::vec3(1.03f, 1.03f, 1.03f));
 
-    // Load model matrix to GPU
-    glUniformMatrix4fv(glGetUniformLocation(shader.GetProgID(), "model"), 1, GL_FALSE, glm::value_ptr(outlineModelMat));
-
-    // Draw meshes
-    for(const Mesh& mesh : mData->meshes)
-        mRenderMesh(shader, mData->vao, mesh);
-
-    glStencilMask(0xFF);
-    glEnable(GL_DEPTH_TEST);
+    // Queue meshes
+    const std::uint32_t transform = queue.AddTransform(outlineModelMat);
+    for(const Mesh& mesh : data->meshes)
+    {
+        BuildDraw(mesh, nullptr, glm::vec3(0.0f));
+        queue.Submit(RenderQueue::Pass::Outline, shader, data->vao, mesh, mDraw, transform, 0.0f, mRenderMesh);
+    }
 }
 
 void Model::Reset()
 {
     mModelMat = glm::mat4();
+    UpdateProxy();
 }
 
 void Model::Translate(const glm::vec3& tvec)
 {
     mModelMat = glm::translate(mModelMat, tvec);
+    UpdateProxy();
 }
 
 void Model::Translate(glm::vec3&& tvec)
@@ -87,6 +204,7 @@ void Model::Translate(glm::vec3&& tvec)
 void Model::Scale(const glm::vec3& svec)
 {
     mModelMat = glm::scale(mModelMat, svec);
+    UpdateProxy();
 }
 
 void Model::Scale(glm::vec3&& svec)
@@ -99,11 +217,177 @@ const glm::mat4& Model::GetModelMat() const
     return mModelMat;
 }
 
+unsigned int Model::GetLod() const
+{
+    return mLod;
+}
+
 //--------------------------------------------------
 // Private functions
 //--------------------------------------------------
-Model::Model(const ModelData* const data, RenderMeshCb renderMesh)
+Model::Model(const ModelData* const data, RenderMeshCb renderMesh, const ModelData* const placeholder)
     : mData(data)
+    , mPlaceholder(placeholder)
     , mRenderMesh(renderMesh)
+    , mLod(0)
+    , mFirstBounds(0)
+    , mBoundsFrame(0)
+    , mBoundsData(nullptr)
+    , mIndex(nullptr)
+    , mProxy(AabbTree::Null)
+    , mProxyData(nullptr)
+{
+}
+
+const ModelData* Model::GetDrawnData() const
+{
+    if(mData->state == ModelData::State::Resident)
+        return mData;
+
+    if(mPlaceholder != nullptr && mPlaceholder->state == ModelData::State::Resident)
+        return mPlaceholder;
+
+    return nullptr;
+}
+
+void Model::GetWorldBounds(const ModelData& data, glm::vec3& center, float& radius) const
 {
+    center = glm::vec3(mModelMat * glm::vec4(data.boundsCenter, 1.0f));
+    radius = data.boundsRadius * GetScale();
+}
+
+float Model::GetScale() const
+{
+    return std::max(
+        glm::length(glm::vec3(mModelMat[0])),
+        std::max(glm::length(glm::vec3(mModelMat[1])), glm::length(glm::vec3(mModelMat[2]))));
+}
+
+void Model::UpdateProxy()
+{
+    if(mIndex == nullptr)
+        return;
+
+    // Nothing is drawn without data, a point at the origin will do until some is resident
+    mProxyData = GetDrawnData();
+    glm::vec3 worldMin, worldMax;
+    if(mProxyData != nullptr)
+        TransformBounds(mModelMat, mProxyData->boundsMin, mProxyData->boundsMax, worldMin, worldMax);
+    else
+        worldMin = worldMax = glm::vec3(mModelMat[3]);
+
+    if(mProxy == AabbTree::Null)
+        mProxy = mIndex->CreateProxy(worldMin, worldMax, this);
+    else
+        mIndex->MoveProxy(mProxy, worldMin, worldMax);
+}
+
+bool Model::IsMeshVisible(const RenderView& view, const ModelData& data, std::size_t mesh) const
+{
+    if(view.culler == nullptr)
+        return true;
+
+    // Left out of the culler, as models the scene index found out of view are
+    if(view.culler->GetFrame() != mBoundsFrame)
+        return false;
+
+    if(mBoundsData != &data)
+        return true;
+
+    return view.culler->IsVisible(mFirstBounds + (std::uint32_t)mesh);
+}
+
+float Model::GetScreenSize(const ModelData& data, const RenderView& view) const
+{
+    glm::vec3 center;
+    float radius;
+    GetWorldBounds(data, center, radius);
+
+    // Projected diameter as a fraction of the viewport height
+    float distance = glm::length(center - view.position);
+    if(distance <= radius)
+        return std::numeric_limits<float>::max();
+    return radius * view.proj[1][1] / distance;
+}
+
+unsigned int Model::SelectLod(const ModelData& data, float screenSize) const
+{
+    if(data.lodCount <= 1)
+        return 0;
+
+    const unsigned int maxLod = std::min(data.lodCount, ModelData::MaxLods) - 1;
+    unsigned int lod = 0;
+    while(lod < maxLod && screenSize < LodScreenSizes[lod])
+        lod++;
+
+    // Only switch once the size is clearly past the threshold between the two LODs
+    while(lod > mLod && screenSize >= LodScreenSizes[lod - 1] * (1.0f - LodHysteresis))
+        lod--;
+    while(lod < mLod && screenSize <= LodScreenSizes[lod] * (1.0f + LodHysteresis))
+        lod++;
+
+    return lod;
+}
+
+void Model::BuildDraw(const Mesh& mesh, const Frustum* frustum, const glm::vec3& cameraPosition) const
+{
+    mDraw.Clear();
+
+    if(mLod != 0 || mesh.meshlets.empty() || frustum == nullptr)
+    {
+        const MeshLod range = mesh.GetLod(mLod);
+        mDraw.Add(range.indexOffset, range.indexCount, mesh.indexType, (GLint)mesh.baseVertex);
+        return;
+    }
+
+    const GLuint indexSize = (GLuint)IndexTypeSize(mesh.indexType);
+    for(const Meshlet& meshlet : mesh.meshlets)
+    {
+        if(!frustum->IntersectsSphere(meshlet.center, meshlet.radius) || meshlet.IsBackfacing(cameraPosition))
+            continue;
+
+        mDraw.Add(
+            mesh.indexOffset + meshlet.firstIndex * indexSize,
+            meshlet.indexCount,
+            mesh.indexType,
+            (GLint)mesh.baseVertex);
+    }
+}
+
+void Model::SubmitMeshes(RenderQueue& queue, const ShaderSelector& shaderOf, const RenderView& view) const
+{
+    const ModelData* data = GetDrawnData();
+    if(data == nullptr)
+        return;
+
+    const float screenSize = GetScreenSize(*data, view);
+    mLod = SelectLod(*data, screenSize);
+
+    // Meshlets are culled in model space
+    const Frustum frustum = Frustum::FromMatrix(view.proj * view.view * mModelMat);
+    const glm::vec3 cameraPosition = glm::vec3(glm::inverse(mModelMat) * glm::vec4(view.position, 1.0f));
+
+    // Mesh spheres scale like the model's
+    const float scale = GetScale();
+
+    // Queue the meshes the culler kept
+    const std::uint32_t transform = queue.AddTransform(mModelMat);
+    for(std::size_t i = 0; i < data->meshes.size(); i++)
+    {
+        const Mesh& mesh = data->meshes[i];
+        if(!IsMeshVisible(view, *data, i))
+            continue;
+
+        BuildDraw(mesh, &frustum, cameraPosition);
+
+        // Sorted by the distance to the mesh's center
+        const glm::vec3 center = glm::vec3(mModelMat * glm::vec4(mesh.boundsCenter, 1.0f));
+        const float depth = glm::length(center - view.position);
+
+        // Textures stream for the mesh's own size on screen
+        const float radius = mesh.boundsRadius * scale;
+        const float meshSize = (depth <= radius) ? std::numeric_limits<float>::max() : radius * view.proj[1][1] / depth;
+        mDraw.screenPixels = meshSize * view.viewportHeight;
+        queue.Submit(RenderQueue::Pass::Opaque, shaderOf(mesh), data->vao, mesh, mDraw, transform, depth, mRenderMesh);
+    }
 }
\ No newline at end of file
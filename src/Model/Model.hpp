@@ -15,18 +15,47 @@ WARN_GUARD_ON
 WARN_GUARD_OFF
 
 #include "Mesh.hpp"
+#include "VertexFormat.hpp"
 #include "../Config.hpp"
 #include "../Movement.hpp"
+#include "../Render/AabbTree.hpp"
+#include "../Render/Frustum.hpp"
+#include "../Render/FrustumCuller.hpp"
+#include "../Render/RenderQueue.hpp"
+#include "../Render/RenderView.hpp"
 #include "../Render/Shader.hpp"
+#include "../Render/ShaderVariants.hpp"
 #include "../Texture/Texture.hpp"
 
 struct ModelData
 {
-    std::vector<GLfloat> data;    /// Vertices, Normals, TexCoords in one vector
-    std::vector<Mesh>    meshes;  /// Meshes for this model
+    static const unsigned int MaxLods = 4; /// LODs generated per mesh at most, LOD 0 included
+
+    VertexFormat         format;    /// Layout of the vertex stream
+    std::vector<GLubyte> data;      /// Vertices, Normals, TexCoords interleaved. Empty when loaded from a cooked file
+    std::vector<GLubyte> indexData; /// Indices of all meshes, packed. Empty when loaded from a cooked file
+    std::vector<Mesh>    meshes;    /// Meshes for this model
+    unsigned int         lodCount;  /// Number of LODs of the most detailed mesh, LOD 0 included
+
+    glm::vec3            boundsCenter; /// Bounding sphere of all meshes, in model space
+    float                boundsRadius;
+    glm::vec3            boundsMin;    /// Bounding box of all meshes, in model space
+    glm::vec3            boundsMax;
+
+    /// Where the data is on its way to the GPU. Only changes on the GL thread
+    enum class State
+    {
+        Loading = 0,
+        Resident,
+        Failed
+    } state;
+
+    GLuint vao,                   /// Ids for the VAO, VBO and EBO Load() used to upload data to GPU.
+           vbo,                   /// The EBO holds the indices of all meshes and is part of the VAO state
+           ebo;
 
-    GLuint vao,                   /// Ids for the VAO and VOB Load() used to upload data to GPU
-           vbo;
+    /// Constructor
+    ModelData();
 
     /// Destructor
     ~ModelData();
@@ -35,11 +64,12 @@ struct ModelData
 
 class Model
 {
+    /// Picks the LODs of its instances and culls them
+    friend class ModelInstanceSet;
+
 public:
-    using RenderMeshCb = std::function<void(
-        const Shader& shader,
-        GLuint vao,
-        const Mesh& mesh)>;
+    /// Draws index ranges of a single mesh, called by the RenderQueue
+    using RenderMeshCb = RenderQueue::DrawMeshCb;
 
     /* The section below is to declare std::make_unique as a friend function.
        Doesnt seem to work on MSVC :(
@@ -49,14 +79,49 @@ public:
         const std::shared_ptr<Painter>&);
     */
 
-    /// Named constructor
-    static std::unique_ptr<Model> CreateModel(const ModelData* const data, RenderMeshCb renderMesh);
+    /// Named constructor. Until data is resident the model draws placeholder
+    /// instead, or nothing if there's none
+    static std::unique_ptr<Model> CreateModel(
+        const ModelData* const data,
+        RenderMeshCb renderMesh,
+        const ModelData* const placeholder = nullptr);
+
+    /// Destructor. Leaves the scene index
+    ~Model();
+
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+
+    /// Adds the model to a scene index, which has to outlive it. The index holds the
+    /// world space box of the drawn data, refit whenever the model moves
+    void Attach(AabbTree& index);
+
+    /// Refits the box in the scene index if the drawn data changed, as when data
+    /// finished loading. Call it after the uploads of a frame
+    void UpdateIndex();
+
+    /// Finds where a world space ray first hits the boxes of the drawn meshes.
+    /// Returns false if it misses them all
+    bool IntersectRay(const glm::vec3& origin, const glm::vec3& direction, float& distance) const;
 
-    /// Use a Shader to draw meshes
-    void Render(const Shader& shader) const;
+    /// Adds the world space boxes of the meshes to a culler. Once it culled them,
+    /// Submit with a view that carries the culler skips the meshes it rejected,
+    /// or the whole model if it wasn't added since the culler was cleared
+    void AddBounds(FrustumCuller& culler) const;
 
-    /// Use a Shader to draw model's outline
-    void RenderOutline(const Shader& shader) const;
+    /// Queues the meshes to draw with a Shader in the opaque pass. Picks the LOD from the
+    /// model's size on screen, and at full detail skips the meshlets that are off screen
+    /// or facing away. The model has to stay alive until the queue is executed
+    void Submit(RenderQueue& queue, const Shader& shader, const RenderView& view) const;
+
+    /// Same as Submit, each mesh with the tightest variant for its textures and given light count
+    void Submit(RenderQueue& queue, ShaderVariants& shaders, unsigned int pointLights, const RenderView& view) const;
+
+    /// Queues the model's outline in the outline pass, with the LOD picked by the last Submit()
+    void SubmitOutline(RenderQueue& queue, const Shader& shader) const;
+
+    /// Retrieves the LOD picked by the last Submit()
+    unsigned int GetLod() const;
 
     /// Resets the Model's model matrix
     void Reset();
@@ -78,21 +143,70 @@ public:
 
 protected:
     /// Constructor
-    Model(const ModelData* const mData, RenderMeshCb renderMesh);
+    Model(const ModelData* const mData, RenderMeshCb renderMesh, const ModelData* const placeholder);
 
 private:
+    /// Picks the shader of a mesh
+    using ShaderSelector = std::function<const Shader&(const Mesh& mesh)>;
+
     const ModelData* mData;       /// Data for this model
 
+    const ModelData* mPlaceholder; /// Data drawn while mData is loading, can be null
+
     RenderMeshCb mRenderMesh;     /// Callback to a function to render a mesh
 
     glm::mat4 mModelMat;          /// Model 4x4 matrix for this model
 
+    mutable unsigned int mLod;    /// LOD drawn last, kept to apply hysteresis
+
+    mutable MeshDraw mDraw;       /// Ranges of the mesh being drawn, kept to reuse its storage
+
+    // Boxes of the meshes in the culler, valid for the culler's frame and the data they were added for
+    mutable std::uint32_t mFirstBounds;
+    mutable std::uint32_t mBoundsFrame;
+    mutable const ModelData* mBoundsData;
+
+    AabbTree* mIndex;             /// Scene index the model is in, can be null
+    std::int32_t mProxy;          /// Id of the model's box in mIndex
+    const ModelData* mProxyData;  /// Data the box was computed from
+
+    /// Retrieves the data to draw: mData once it's resident, mPlaceholder before
+    const ModelData* GetDrawnData() const;
+
+    /// Moves the box in the scene index to where the model is
+    void UpdateProxy();
+
+    /// Checks if the culler of given view kept a mesh of given data. True when the model
+    /// was added for other data, false when it wasn't added this frame
+    bool IsMeshVisible(const RenderView& view, const ModelData& data, std::size_t mesh) const;
+
+    /// Retrieves the bounding sphere of given data in world space. The radius follows the largest scale axis
+    void GetWorldBounds(const ModelData& data, glm::vec3& center, float& radius) const;
+
+    /// Retrieves the scale of the largest axis of the model matrix
+    float GetScale() const;
+
+    /// Retrieves the projected diameter of given data's bounds over the viewport height.
+    /// Huge when the camera is inside them
+    float GetScreenSize(const ModelData& data, const RenderView& view) const;
+
+    /// Picks the LOD of given data to draw at given screen size
+    unsigned int SelectLod(const ModelData& data, float screenSize) const;
+
+    /// Fills mDraw with the ranges of a mesh at the current LOD. Meshlets are culled
+    /// against frustum and cameraPosition, both in model space, unless frustum is null
+    void BuildDraw(const Mesh& mesh, const Frustum* frustum, const glm::vec3& cameraPosition) const;
+
+    /// Queues the meshes like Submit, each with the shader shaderOf picks
+    void SubmitMeshes(RenderQueue& queue, const ShaderSelector& shaderOf, const RenderView& view) const;
+
 }; //~ Model
 
 template <Movement::MoveDirection MD>
 void Model::Move(float distance)
 {
     Movement::Move<MD, glm::mat4>(mModelMat, distance);
+    UpdateProxy();
 }
 
 #endif //~ ELESWORD_MODEL_HPP
@@ -0,0 +1,420 @@
+#include "ModelCache.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "../Util/Hash.hpp"
+
+namespace
+{
+    //--------------------------------------------------
+    // File layout
+    //--------------------------------------------------
+    // Header | Mesh records | LOD records | Meshlet records | Texture records | Path strings | Vertex stream | Indices
+    // The vertex stream starts at a 16 byte boundary and the indices at a 4 byte one.
+    // Mesh and LOD index offsets are in bytes from the start of the indices.
+
+    const char Magic[4] = { 'E', 'M', 'D', 'L' };
+
+    struct Header
+    {
+        char          magic[4];
+        std::uint32_t version;
+        std::uint64_t sourceHash;
+        std::uint32_t importFlags;
+        std::uint32_t vertexFormat;
+        std::uint32_t meshCount;
+        std::uint32_t lodRecordCount;
+        std::uint32_t meshletCount;
+        std::uint32_t lodCount;
+        std::uint32_t textureCount;
+        std::uint32_t stringBytes;
+        std::uint64_t vertexBytes;
+        std::uint64_t indexBytes;
+        float         boundsCenter[3];
+        float         boundsRadius;
+        float         boundsMin[3];
+        float         boundsMax[3];
+    };
+
+    struct MeshRecord
+    {
+        std::uint32_t indexOffset;
+        std::uint32_t indexCount;
+        std::uint32_t indexType;
+        std::uint32_t baseVertex;
+        std::uint32_t vertexCount;
+        std::uint32_t firstLod;
+        std::uint32_t lodCount;
+        std::uint32_t firstMeshlet;
+        std::uint32_t meshletCount;
+        std::uint32_t firstTexture;
+        std::uint32_t textureCount;
+        std::uint32_t alphaTested;
+        float         positionScale[3];
+        float         positionOffset[3];
+        float         boundsMin[3];
+        float         boundsMax[3];
+        float         boundsCenter[3];
+        float         boundsRadius;
+    };
+
+    struct LodRecord
+    {
+        std::uint32_t indexOffset;
+        std::uint32_t indexCount;
+    };
+
+    struct MeshletRecord
+    {
+        std::uint32_t firstIndex;
+        std::uint32_t indexCount;
+        float         center[3];
+        float         radius;
+        float         coneApex[3];
+        float         coneAxis[3];
+        float         coneCutoff;
+    };
+
+    struct TextureRecord
+    {
+        std::uint32_t type;
+        std::uint32_t pathOffset;
+        std::uint32_t pathLength;
+        std::uint32_t padding;
+    };
+
+    std::uint64_t AlignUp(std::uint64_t value, std::uint64_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    void WritePadding(std::ofstream& out, std::uint64_t from, std::uint64_t to)
+    {
+        static const char zeros[16] = {};
+        out.write(zeros, (std::streamsize)(to - from));
+    }
+
+    /// Retrieves the file names of the mtllib statements of a mapped .obj
+    std::vector<std::string> MaterialLibraries(const MappedFile& source)
+    {
+        std::vector<std::string> libraries;
+        const char* cur = reinterpret_cast<const char*>(source.Data());
+        const char* end = cur + source.Size();
+        static const char Keyword[] = "mtllib";
+        const std::size_t keywordLength = sizeof(Keyword) - 1;
+
+        while(cur < end)
+        {
+            const char* lineEnd = std::find(cur, end, '\n');
+            while(cur < lineEnd && (*cur == ' ' || *cur == '\t'))
+                cur++;
+
+            if((std::size_t)(lineEnd - cur) > keywordLength
+                && std::memcmp(cur, Keyword, keywordLength) == 0
+                && (cur[keywordLength] == ' ' || cur[keywordLength] == '\t'))
+            {
+                // One statement can name several libraries
+                cur += keywordLength;
+                while(cur < lineEnd)
+                {
+                    while(cur < lineEnd && std::isspace((unsigned char)*cur))
+                        cur++;
+                    const char* nameEnd = cur;
+                    while(nameEnd < lineEnd && !std::isspace((unsigned char)*nameEnd))
+                        nameEnd++;
+                    if(nameEnd != cur)
+                        libraries.emplace_back(cur, nameEnd);
+                    cur = nameEnd;
+                }
+            }
+            cur = (lineEnd == end) ? end : lineEnd + 1;
+        }
+        return libraries;
+    }
+}
+
+//--------------------------------------------------
+// ModelCache
+//--------------------------------------------------
+namespace ModelCache
+{
+    std::string CookedPath(const std::string& sourcePath)
+    {
+        return sourcePath + ".emdl";
+    }
+
+    std::uint64_t HashSource(const std::string& sourcePath)
+    {
+        MappedFile source;
+        if(!source.Open(sourcePath))
+            return 0;
+
+        std::uint64_t hash = Hash::Fnv1a(source.Data(), source.Size());
+
+        // Materials and texture paths of an .obj live in the .mtl files it references
+        const std::string assetRootDir = sourcePath.substr(0, sourcePath.find_last_of('/') + 1);
+        for(const std::string& library : MaterialLibraries(source))
+        {
+            hash = Hash::Fnv1a(library, hash);
+
+            // A missing library still counts by name, the cooked file goes stale once it shows up
+            MappedFile material;
+            if(material.Open(assetRootDir + library))
+                hash = Hash::Fnv1a(material.Data(), material.Size(), hash);
+        }
+        return hash;
+    }
+
+    bool Save(
+        const std::string& cookedPath,
+        std::uint64_t sourceHash,
+        std::uint32_t importFlags,
+        const ModelData& data)
+    {
+        // Gather mesh and texture tables
+        std::vector<MeshRecord> meshRecords;
+        std::vector<LodRecord> lodRecords;
+        std::vector<MeshletRecord> meshletRecords;
+        std::vector<TextureRecord> textureRecords;
+        std::string strings;
+
+        for(const Mesh& mesh : data.meshes)
+        {
+            MeshRecord record = {};
+            record.indexOffset  = mesh.indexOffset;
+            record.indexCount   = (std::uint32_t)mesh.indexCount;
+            record.indexType    = mesh.indexType;
+            record.baseVertex   = mesh.baseVertex;
+            record.vertexCount  = mesh.vertexCount;
+            record.firstLod     = (std::uint32_t)lodRecords.size();
+            record.lodCount     = (std::uint32_t)mesh.lods.size();
+            record.firstMeshlet = (std::uint32_t)meshletRecords.size();
+            record.meshletCount = (std::uint32_t)mesh.meshlets.size();
+            record.firstTexture = (std::uint32_t)textureRecords.size();
+            record.textureCount = (std::uint32_t)mesh.textures.size();
+            record.alphaTested  = mesh.alphaTested ? 1 : 0;
+            record.boundsRadius = mesh.boundsRadius;
+            for(int i = 0; i < 3; i++)
+            {
+                record.positionScale[i]  = mesh.positionScale[i];
+                record.positionOffset[i] = mesh.positionOffset[i];
+                record.boundsMin[i]      = mesh.boundsMin[i];
+                record.boundsMax[i]      = mesh.boundsMax[i];
+                record.boundsCenter[i]   = mesh.boundsCenter[i];
+            }
+            meshRecords.push_back(record);
+
+            for(const MeshLod& lod : mesh.lods)
+                lodRecords.push_back({ lod.indexOffset, (std::uint32_t)lod.indexCount });
+
+            for(const Meshlet& meshlet : mesh.meshlets)
+            {
+                MeshletRecord meshletRecord = {};
+                meshletRecord.firstIndex = meshlet.firstIndex;
+                meshletRecord.indexCount = (std::uint32_t)meshlet.indexCount;
+                meshletRecord.radius     = meshlet.radius;
+                meshletRecord.coneCutoff = meshlet.coneCutoff;
+                for(int i = 0; i < 3; i++)
+                {
+                    meshletRecord.center[i]   = meshlet.center[i];
+                    meshletRecord.coneApex[i] = meshlet.coneApex[i];
+                    meshletRecord.coneAxis[i] = meshlet.coneAxis[i];
+                }
+                meshletRecords.push_back(meshletRecord);
+            }
+
+            for(const Texture& texture : mesh.textures)
+            {
+                TextureRecord texRecord = {};
+                texRecord.type       = (std::uint32_t)texture.type;
+                texRecord.pathOffset = (std::uint32_t)strings.size();
+                texRecord.pathLength = (std::uint32_t)texture.path.size();
+                textureRecords.push_back(texRecord);
+
+                strings += texture.path;
+            }
+        }
+
+        Header header = {};
+        std::memcpy(header.magic, Magic, sizeof(Magic));
+        header.version        = Version;
+        header.sourceHash     = sourceHash;
+        header.importFlags    = importFlags;
+        header.vertexFormat   = (std::uint32_t)data.format;
+        header.meshCount      = (std::uint32_t)meshRecords.size();
+        header.lodRecordCount = (std::uint32_t)lodRecords.size();
+        header.meshletCount   = (std::uint32_t)meshletRecords.size();
+        header.lodCount       = data.lodCount;
+        header.textureCount   = (std::uint32_t)textureRecords.size();
+        header.stringBytes    = (std::uint32_t)strings.size();
+        header.vertexBytes    = data.data.size();
+        header.indexBytes     = data.indexData.size();
+        for(int i = 0; i < 3; i++)
+        {
+            header.boundsCenter[i] = data.boundsCenter[i];
+            header.boundsMin[i]    = data.boundsMin[i];
+            header.boundsMax[i]    = data.boundsMax[i];
+        }
+        header.boundsRadius = data.boundsRadius;
+
+        std::ofstream out(cookedPath, std::ios::binary | std::ios::trunc);
+        if(!out)
+            return false;
+
+        out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        out.write(reinterpret_cast<const char*>(meshRecords.data()), meshRecords.size() * sizeof(MeshRecord));
+        out.write(reinterpret_cast<const char*>(lodRecords.data()), lodRecords.size() * sizeof(LodRecord));
+        out.write(reinterpret_cast<const char*>(meshletRecords.data()), meshletRecords.size() * sizeof(MeshletRecord));
+        out.write(reinterpret_cast<const char*>(textureRecords.data()), textureRecords.size() * sizeof(TextureRecord));
+        out.write(strings.data(), strings.size());
+
+        std::uint64_t pos = sizeof(Header)
+                          + meshRecords.size() * sizeof(MeshRecord)
+                          + lodRecords.size() * sizeof(LodRecord)
+                          + meshletRecords.size() * sizeof(MeshletRecord)
+                          + textureRecords.size() * sizeof(TextureRecord)
+                          + strings.size();
+
+        // Vertex stream
+        std::uint64_t vertexStart = AlignUp(pos, 16);
+        WritePadding(out, pos, vertexStart);
+        out.write(reinterpret_cast<const char*>(data.data.data()), (std::streamsize)header.vertexBytes);
+        pos = vertexStart + header.vertexBytes;
+
+        // Indices
+        std::uint64_t indexStart = AlignUp(pos, 4);
+        WritePadding(out, pos, indexStart);
+        out.write(reinterpret_cast<const char*>(data.indexData.data()), (std::streamsize)header.indexBytes);
+
+        return (bool)out;
+    }
+
+    bool Load(
+        const std::string& cookedPath,
+        std::uint64_t sourceHash,
+        std::uint32_t importFlags,
+        VertexFormat format,
+        CookedModel& cooked)
+    {
+        MappedFile file;
+        if(!file.Open(cookedPath) || file.Size() < sizeof(Header))
+            return false;
+
+        const unsigned char* base = file.Data();
+        Header header;
+        std::memcpy(&header, base, sizeof(Header));
+
+        // Validate
+        if(std::memcmp(header.magic, Magic, sizeof(Magic)) != 0
+        || header.version      != Version
+        || header.sourceHash   != sourceHash
+        || header.importFlags  != importFlags
+        || header.vertexFormat != (std::uint32_t)format)
+            return false;
+
+        const std::uint64_t meshStart    = sizeof(Header);
+        const std::uint64_t lodStart     = meshStart + (std::uint64_t)header.meshCount * sizeof(MeshRecord);
+        const std::uint64_t meshletStart = lodStart + (std::uint64_t)header.lodRecordCount * sizeof(LodRecord);
+        const std::uint64_t textureStart = meshletStart + (std::uint64_t)header.meshletCount * sizeof(MeshletRecord);
+        const std::uint64_t stringStart  = textureStart + (std::uint64_t)header.textureCount * sizeof(TextureRecord);
+        const std::uint64_t vertexStart  = AlignUp(stringStart + header.stringBytes, 16);
+        const std::uint64_t indexStart   = AlignUp(vertexStart + header.vertexBytes, 4);
+        const std::uint64_t end          = indexStart + header.indexBytes;
+
+        if(end != file.Size())
+        {
+            std::cout << "WARNING::MODEL_CACHE:: Truncated cooked file " << cookedPath << std::endl;
+            return false;
+        }
+
+        const MeshRecord* meshRecords = reinterpret_cast<const MeshRecord*>(base + meshStart);
+        const LodRecord* lodRecords = reinterpret_cast<const LodRecord*>(base + lodStart);
+        const MeshletRecord* meshletRecords = reinterpret_cast<const MeshletRecord*>(base + meshletStart);
+        const TextureRecord* textureRecords = reinterpret_cast<const TextureRecord*>(base + textureStart);
+        const char* strings = reinterpret_cast<const char*>(base + stringStart);
+
+        cooked.meshes.clear();
+        cooked.meshes.reserve(header.meshCount);
+        for(std::uint32_t i = 0; i < header.meshCount; i++)
+        {
+            const MeshRecord& record = meshRecords[i];
+            const std::uint64_t indexSize = IndexTypeSize(record.indexType);
+            if(record.indexOffset + record.indexCount * indexSize > header.indexBytes
+            || (std::uint64_t)record.firstLod + record.lodCount > header.lodRecordCount
+            || (std::uint64_t)record.firstMeshlet + record.meshletCount > header.meshletCount
+            || (std::uint64_t)record.firstTexture + record.textureCount > header.textureCount)
+                return false;
+
+            CookedMesh mesh;
+            mesh.indexOffset    = record.indexOffset;
+            mesh.indexCount     = (GLsizei)record.indexCount;
+            mesh.indexType      = record.indexType;
+            mesh.baseVertex     = record.baseVertex;
+            mesh.vertexCount    = record.vertexCount;
+            mesh.positionScale  = glm::vec3(record.positionScale[0], record.positionScale[1], record.positionScale[2]);
+            mesh.positionOffset = glm::vec3(record.positionOffset[0], record.positionOffset[1], record.positionOffset[2]);
+            mesh.alphaTested    = record.alphaTested != 0;
+            mesh.boundsMin      = glm::vec3(record.boundsMin[0], record.boundsMin[1], record.boundsMin[2]);
+            mesh.boundsMax      = glm::vec3(record.boundsMax[0], record.boundsMax[1], record.boundsMax[2]);
+            mesh.boundsCenter   = glm::vec3(record.boundsCenter[0], record.boundsCenter[1], record.boundsCenter[2]);
+            mesh.boundsRadius   = record.boundsRadius;
+
+            for(std::uint32_t j = 0; j < record.lodCount; j++)
+            {
+                const LodRecord& lodRecord = lodRecords[record.firstLod + j];
+                if(lodRecord.indexOffset + lodRecord.indexCount * indexSize > header.indexBytes)
+                    return false;
+
+                mesh.lods.push_back({ lodRecord.indexOffset, (GLsizei)lodRecord.indexCount });
+            }
+
+            for(std::uint32_t j = 0; j < record.meshletCount; j++)
+            {
+                const MeshletRecord& meshletRecord = meshletRecords[record.firstMeshlet + j];
+                if((std::uint64_t)meshletRecord.firstIndex + meshletRecord.indexCount > record.indexCount)
+                    return false;
+
+                Meshlet meshlet;
+                meshlet.firstIndex = meshletRecord.firstIndex;
+                meshlet.indexCount = (GLsizei)meshletRecord.indexCount;
+                meshlet.center     = glm::vec3(meshletRecord.center[0], meshletRecord.center[1], meshletRecord.center[2]);
+                meshlet.radius     = meshletRecord.radius;
+                meshlet.coneApex   = glm::vec3(meshletRecord.coneApex[0], meshletRecord.coneApex[1], meshletRecord.coneApex[2]);
+                meshlet.coneAxis   = glm::vec3(meshletRecord.coneAxis[0], meshletRecord.coneAxis[1], meshletRecord.coneAxis[2]);
+                meshlet.coneCutoff = meshletRecord.coneCutoff;
+                mesh.meshlets.push_back(meshlet);
+            }
+
+            for(std::uint32_t j = 0; j < record.textureCount; j++)
+            {
+                const TextureRecord& texRecord = textureRecords[record.firstTexture + j];
+                if((std::uint64_t)texRecord.pathOffset + texRecord.pathLength > header.stringBytes)
+                    return false;
+
+                mesh.textures.emplace_back(
+                    (TextureType)texRecord.type,
+                    std::string(strings + texRecord.pathOffset, texRecord.pathLength));
+            }
+
+            cooked.meshes.push_back(std::move(mesh));
+        }
+
+        cooked.format       = format;
+        cooked.lodCount     = header.lodCount;
+        cooked.boundsCenter = glm::vec3(header.boundsCenter[0], header.boundsCenter[1], header.boundsCenter[2]);
+        cooked.boundsRadius = header.boundsRadius;
+        cooked.boundsMin    = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+        cooked.boundsMax    = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+        cooked.vertices     = base + vertexStart;
+        cooked.vertexBytes  = (GLsizeiptr)header.vertexBytes;
+        cooked.indexData    = base + indexStart;
+        cooked.indexBytes   = (GLsizeiptr)header.indexBytes;
+        cooked.file         = std::move(file);
+
+        return true;
+    }
+
+} //~ namespace ModelCache
\ No newline at end of file
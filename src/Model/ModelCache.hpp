@@ -0,0 +1,89 @@
+#ifndef ELESWORD_MODEL_CACHE_HPP
+#define ELESWORD_MODEL_CACHE_HPP
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include "Model.hpp"
+#include "VertexFormat.hpp"
+#include "../Texture/Texture.hpp"
+#include "../Util/MappedFile.hpp"
+
+/// Mesh as stored in a cooked model file
+struct CookedMesh
+{
+    GLuint       indexOffset;   /// Byte offset of this mesh's indices in CookedModel::indexData
+    GLsizei      indexCount;    /// Number of indices of this mesh
+    GLenum       indexType;     /// GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    unsigned int baseVertex;    /// Starting vertex in the vertex stream
+    unsigned int vertexCount;   /// Number of vertices of this mesh
+    glm::vec3    positionScale; /// Dequantization of compact positions
+    glm::vec3    positionOffset;
+    bool         alphaTested;   /// See Mesh::alphaTested
+    glm::vec3    boundsMin;     /// Bounding box, in model space
+    glm::vec3    boundsMax;
+    glm::vec3    boundsCenter;  /// Bounding sphere, in model space
+    float        boundsRadius;
+    std::vector<MeshLod> lods;  /// Index ranges of the simplified versions
+    std::vector<Meshlet> meshlets; /// Clusters of the full detail indices
+    std::vector<std::pair<TextureType, std::string>> textures; /// Texture types and paths
+
+}; //~ CookedMesh
+
+/// A cooked model file mapped in memory. Pointers point straight in the mapping
+struct CookedModel
+{
+    MappedFile              file;          /// The mapping that backs the pointers below
+    VertexFormat            format;        /// Layout of the vertex stream
+    unsigned int            lodCount;      /// LOD count of the most detailed mesh
+    glm::vec3               boundsCenter;  /// Bounding sphere of all meshes
+    float                   boundsRadius;
+    glm::vec3               boundsMin;     /// Bounding box of all meshes
+    glm::vec3               boundsMax;
+    const GLvoid*           vertices;      /// Interleaved vertex stream, same layout as ModelData::data
+    GLsizeiptr              vertexBytes;   /// Size of the vertex stream in bytes
+    const GLvoid*           indexData;     /// Packed indices of all meshes, same layout as ModelData::indexData
+    GLsizeiptr              indexBytes;    /// Size of the packed indices in bytes
+    std::vector<CookedMesh> meshes;        /// Mesh table
+
+}; //~ CookedModel
+
+/// Versioned binary cache of imported models.
+/// A cooked file sits next to its source and holds the final vertex stream, the
+/// per mesh index ranges and the texture references. It is rejected when the
+/// source contents, the import flags, the vertex format or the file version change.
+namespace ModelCache
+{
+    /// Bump whenever the cooked layout or the vertex stream layout changes
+    const std::uint32_t Version = 7;
+
+    /// Retrieves the path of the cooked file for given source model
+    std::string CookedPath(const std::string& sourcePath);
+
+    /// Hashes the contents of given source model and of the .mtl files it references.
+    /// Returns 0 if the model can't be read
+    std::uint64_t HashSource(const std::string& sourcePath);
+
+    /// Writes a cooked file for given model data. Returns false on failure
+    bool Save(
+        const std::string& cookedPath,
+        std::uint64_t sourceHash,
+        std::uint32_t importFlags,
+        const ModelData& data);
+
+    /// Maps a cooked file. Returns false if it is missing, corrupt or stale
+    bool Load(
+        const std::string& cookedPath,
+        std::uint64_t sourceHash,
+        std::uint32_t importFlags,
+        VertexFormat format,
+        CookedModel& cooked);
+
+} //~ namespace ModelCache
+
+#endif //~ ELESWORD_MODEL_CACHE_HPP
\ No newline at end of file
@@ -0,0 +1,449 @@
+#include "ModelInstanceSet.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+
+#include "../Render/Frustum.hpp"
+
+//--------------------------------------------------
+// Public functions
+//--------------------------------------------------
+ModelInstanceSet::ModelInstanceSet(
+    const ModelData* const data,
+    Model::RenderMeshCb renderMesh,
+    const ModelData* const placeholder)
+    : mData(data)
+    , mPlaceholder(placeholder)
+    , mRenderMesh(renderMesh)
+    , mVaoData(nullptr)
+    , mInstanceBuffer(0)
+    , mVisibleCount(0)
+    , mGpuCulling(nullptr)
+    , mOccludedCount(0)
+{
+    std::fill(std::begin(mVaos), std::end(mVaos), 0);
+}
+
+ModelInstanceSet::~ModelInstanceSet()
+{
+    glDeleteBuffers(1, &mInstanceBuffer);
+    glDeleteVertexArrays(ModelData::MaxLods, mVaos);
+
+    const GLuint buffers[] = { mGpu.models, mGpu.states, mGpu.attributes, mGpu.counters, mGpu.commands, mGpu.readback };
+    glDeleteBuffers(6, buffers);
+    glDeleteVertexArrays(1, &mGpu.vao);
+    if(mGpu.fence != nullptr)
+        glDeleteSync(mGpu.fence);
+}
+
+Model* ModelInstanceSet::AddInstance()
+{
+    mInstances.push_back(Model::CreateModel(mData, mRenderMesh, mPlaceholder));
+    return mInstances.back().get();
+}
+
+std::size_t ModelInstanceSet::GetInstanceCount() const
+{
+    return mInstances.size();
+}
+
+void ModelInstanceSet::EnableGpuCulling(const GpuCulling& culling)
+{
+    mGpuCulling = &culling;
+}
+
+void ModelInstanceSet::Attach(AabbTree& index)
+{
+    for(const std::unique_ptr<Model>& instance : mInstances)
+        instance->Attach(index);
+}
+
+void ModelInstanceSet::UpdateIndex()
+{
+    for(const std::unique_ptr<Model>& instance : mInstances)
+        instance->UpdateIndex();
+}
+
+void ModelInstanceSet::AddBounds(FrustumCuller& culler) const
+{
+    for(const std::unique_ptr<Model>& instance : mInstances)
+        instance->AddBounds(culler);
+}
+
+void ModelInstanceSet::Submit(RenderQueue& queue, const Shader& shader, const RenderView& view)
+{
+    SubmitMeshes(queue, [&shader](const Mesh&) -> const Shader& { return shader; }, view);
+}
+
+void ModelInstanceSet::Submit(RenderQueue& queue, ShaderVariants& shaders, unsigned int pointLights, const RenderView& view)
+{
+    SubmitMeshes(queue, InstancedVariants(shaders, pointLights), view);
+}
+
+void ModelInstanceSet::SubmitLate(RenderQueue& queue, const Shader& shader, const RenderView& view)
+{
+    if(mGpuCulling != nullptr && view.hiZ != nullptr)
+        SubmitIndirect(queue, [&shader](const Mesh&) -> const Shader& { return shader; }, view, GpuCulling::Pass::Late);
+}
+
+void ModelInstanceSet::SubmitLate(RenderQueue& queue, ShaderVariants& shaders, unsigned int pointLights, const RenderView& view)
+{
+    if(mGpuCulling != nullptr && view.hiZ != nullptr)
+        SubmitIndirect(queue, InstancedVariants(shaders, pointLights), view, GpuCulling::Pass::Late);
+}
+
+std::size_t ModelInstanceSet::GetVisibleCount() const
+{
+    return mVisibleCount;
+}
+
+std::size_t ModelInstanceSet::GetOccludedCount() const
+{
+    return mOccludedCount;
+}
+
+//--------------------------------------------------
+// Private functions
+//--------------------------------------------------
+ModelInstanceSet::ShaderSelector ModelInstanceSet::InstancedVariants(ShaderVariants& shaders, unsigned int pointLights)
+{
+    return [&shaders, pointLights](const Mesh& mesh) -> const Shader&
+    {
+        ShaderFeatures features;
+        features.pointLights = pointLights;
+        features.specularMap = mesh.HasTexture(TextureType::SPECULAR);
+        features.alphaTest   = mesh.alphaTested;
+        features.instanced   = true;
+        return shaders.Get(features);
+    };
+}
+
+void ModelInstanceSet::BuildVaos(const ModelData& data)
+{
+    if(mInstanceBuffer == 0)
+    {
+        glGenVertexArrays(ModelData::MaxLods, mVaos);
+        glGenBuffers(1, &mInstanceBuffer);
+    }
+
+    for(GLuint vao : mVaos)
+    {
+        glBindVertexArray(vao);
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, data.vbo);
+            SetupVertexAttributes(data.format);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+            // The EBO binding is recorded in the VAO
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, data.ebo);
+        }
+        glBindVertexArray(0);
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    mVaoData = &data;
+}
+
+void ModelInstanceSet::SubmitMeshes(RenderQueue& queue, const ShaderSelector& shaderOf, const RenderView& view)
+{
+    if(mGpuCulling != nullptr)
+    {
+        SubmitIndirect(queue, shaderOf, view, view.hiZ != nullptr ? GpuCulling::Pass::Early : GpuCulling::Pass::All);
+        return;
+    }
+
+    mVisibleCount = 0;
+
+    const ModelData* data = mInstances.empty() ? nullptr : mInstances.front()->GetDrawnData();
+    if(data == nullptr)
+        return;
+
+    if(data != mVaoData)
+        BuildVaos(*data);
+
+    // Without a culler whole instances are tested against the frustum here
+    const std::size_t meshCount = data->meshes.size();
+    const FrustumCuller* culler = view.culler;
+    const Frustum frustum = Frustum::FromMatrix(view.proj * view.view);
+
+    // Drop the instances out of view and group the rest by LOD
+    for(LodGroup& group : mGroups)
+    {
+        group.instances.clear();
+        group.meshes.assign(meshCount, culler == nullptr ? 1 : 0);
+        group.depth = std::numeric_limits<float>::max();
+        group.screenSize = 0.0f;
+    }
+
+    for(std::uint32_t i = 0; i < (std::uint32_t)mInstances.size(); i++)
+    {
+        const Model& instance = *mInstances[i];
+
+        glm::vec3 center;
+        float radius;
+        instance.GetWorldBounds(*data, center, radius);
+
+        bool visible = false;
+        if(culler == nullptr)
+            visible = frustum.IntersectsSphere(center, radius);
+        else
+        {
+            for(std::size_t m = 0; m < meshCount && !visible; m++)
+                visible = instance.IsMeshVisible(view, *data, m);
+        }
+        if(!visible)
+            continue;
+
+        const float screenSize = instance.GetScreenSize(*data, view);
+        instance.mLod = instance.SelectLod(*data, screenSize);
+
+        LodGroup& group = mGroups[instance.mLod];
+        group.instances.push_back(i);
+        if(culler != nullptr)
+        {
+            for(std::size_t m = 0; m < meshCount; m++)
+                group.meshes[m] |= instance.IsMeshVisible(view, *data, m) ? 1 : 0;
+        }
+        group.depth = std::min(group.depth, glm::length(center - view.position));
+        group.screenSize = std::max(group.screenSize, screenSize);
+        mVisibleCount++;
+    }
+
+    if(mVisibleCount == 0)
+        return;
+
+    // Attributes of every visible instance, group after group
+    mAttributes.clear();
+    for(const LodGroup& group : mGroups)
+    {
+        for(std::uint32_t i : group.instances)
+        {
+            InstanceAttributes attributes;
+            attributes.model = mInstances[i]->GetModelMat();
+            attributes.normal = glm::transpose(glm::inverse(glm::mat3(attributes.model)));
+            mAttributes.push_back(attributes);
+        }
+    }
+
+    // Whole buffer each frame, so the driver can hand out fresh storage instead of waiting on the last frame
+    glBindBuffer(GL_ARRAY_BUFFER, mInstanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, mAttributes.size() * sizeof(InstanceAttributes), mAttributes.data(), GL_STREAM_DRAW);
+
+    // Point each group's VAO at its part of the buffer and queue its meshes
+    GLintptr offset = 0;
+    for(unsigned int lod = 0; lod < ModelData::MaxLods; lod++)
+    {
+        const LodGroup& group = mGroups[lod];
+        if(group.instances.empty())
+            continue;
+
+        glBindVertexArray(mVaos[lod]);
+        SetupInstanceAttributes(offset);
+        glBindVertexArray(0);
+        offset += (GLintptr)(group.instances.size() * sizeof(InstanceAttributes));
+
+        for(std::size_t m = 0; m < meshCount; m++)
+        {
+            // Culled for every instance of the group
+            if(!group.meshes[m])
+                continue;
+
+            const Mesh& mesh = data->meshes[m];
+            const MeshLod range = mesh.GetLod(lod);
+            mDraw.Clear();
+            mDraw.Add(range.indexOffset, range.indexCount, mesh.indexType, (GLint)mesh.baseVertex);
+            mDraw.instanceCount = (GLsizei)group.instances.size();
+
+            // Meshes are taken as large as the largest instance for texture streaming
+            mDraw.screenPixels = group.screenSize * view.viewportHeight;
+            queue.Submit(
+                RenderQueue::Pass::Opaque,
+                shaderOf(mesh),
+                mVaos[lod],
+                mesh,
+                mDraw,
+                RenderQueue::NoTransform,
+                group.depth,
+                mRenderMesh);
+        }
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void ModelInstanceSet::BuildGpuBuffers(const ModelData& data)
+{
+    if(mGpu.vao == 0)
+    {
+        glGenVertexArrays(1, &mGpu.vao);
+        glGenBuffers(1, &mGpu.models);
+        glGenBuffers(1, &mGpu.states);
+        glGenBuffers(1, &mGpu.attributes);
+        glGenBuffers(1, &mGpu.counters);
+        glGenBuffers(1, &mGpu.commands);
+        glGenBuffers(1, &mGpu.readback);
+
+        glBindBuffer(GL_COPY_WRITE_BUFFER, mGpu.readback);
+        glBufferData(GL_COPY_WRITE_BUFFER, sizeof(GLuint), nullptr, GL_STREAM_READ);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    // Every LOD gets room for all instances. None was drawn last frame, the first late pass draws them
+    const std::size_t instanceCount = mInstances.size();
+    const std::vector<GLuint> states(instanceCount, 0);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mGpu.models);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, instanceCount * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mGpu.states);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, instanceCount * sizeof(GLuint), states.data(), GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mGpu.attributes);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, ModelData::MaxLods * instanceCount * sizeof(InstanceAttributes), nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mGpu.counters);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GpuCulling::Counters), nullptr, GL_DYNAMIC_COPY);
+
+    // A command per mesh and LOD for each pass. Only the instance counts change, and
+    // where the late pass's instances start, the GPU writes them
+    std::vector<GpuCulling::DrawCommand> commands;
+    for(int pass = 0; pass < 2; pass++)
+    {
+        for(const Mesh& mesh : data.meshes)
+        {
+            for(unsigned int lod = 0; lod < ModelData::MaxLods; lod++)
+            {
+                const MeshLod range = mesh.GetLod(lod);
+                GpuCulling::DrawCommand command;
+                command.count         = (GLuint)range.indexCount;
+                command.instanceCount = 0;
+                command.firstIndex    = range.indexOffset / (GLuint)IndexTypeSize(mesh.indexType);
+                command.baseVertex    = (GLint)mesh.baseVertex;
+                command.baseInstance  = (GLuint)(lod * instanceCount);
+                commands.push_back(command);
+            }
+        }
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mGpu.commands);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, commands.size() * sizeof(GpuCulling::DrawCommand), commands.data(), GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glBindVertexArray(mGpu.vao);
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, data.vbo);
+        SetupVertexAttributes(data.format);
+        glBindBuffer(GL_ARRAY_BUFFER, mGpu.attributes);
+        SetupInstanceAttributes(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, data.ebo);
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    mGpu.instanceCount = instanceCount;
+    mGpu.data = &data;
+}
+
+void ModelInstanceSet::SubmitIndirect(
+    RenderQueue& queue,
+    const ShaderSelector& shaderOf,
+    const RenderView& view,
+    GpuCulling::Pass pass)
+{
+    const ModelData* data = mInstances.empty() ? nullptr : mInstances.front()->GetDrawnData();
+    const std::size_t instanceCount = mInstances.size();
+    if(pass == GpuCulling::Pass::Late)
+    {
+        // Goes on from the early pass of the frame, which sized the buffers and uploaded the matrices
+        if(data == nullptr || data != mGpu.data || instanceCount != mGpu.instanceCount)
+            return;
+    }
+    else
+    {
+        mVisibleCount = 0;
+        if(data == nullptr)
+            return;
+
+        if(data != mGpu.data || instanceCount != mGpu.instanceCount)
+            BuildGpuBuffers(*data);
+
+        // Matrices of every instance. Besides, only the closest distance and the largest
+        // radius are tracked, so textures stream for the largest size any instance can have
+        mModels.clear();
+        float closest = std::numeric_limits<float>::max();
+        float largest = 0.0f;
+        for(const std::unique_ptr<Model>& instance : mInstances)
+        {
+            mModels.push_back(instance->GetModelMat());
+
+            glm::vec3 center;
+            float radius;
+            instance->GetWorldBounds(*data, center, radius);
+            closest = std::min(closest, glm::length(center - view.position));
+            largest = std::max(largest, radius);
+        }
+        mGpu.screenSize = (closest <= largest) ? std::numeric_limits<float>::max() : largest * view.proj[1][1] / closest;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, mGpu.models);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, mModels.size() * sizeof(glm::mat4), mModels.data(), GL_STREAM_DRAW);
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, mGpu.counters);
+        glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        mVisibleCount = instanceCount;
+    }
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GpuCulling::InstanceBinding, mGpu.models);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GpuCulling::StateBinding, mGpu.states);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GpuCulling::AttributeBinding, mGpu.attributes);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GpuCulling::CounterBinding, mGpu.counters);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GpuCulling::CommandBinding, mGpu.commands);
+
+    const std::size_t meshCount = data->meshes.size();
+    const std::size_t commandCount = meshCount * ModelData::MaxLods;
+    mGpuCulling->Dispatch(*data, (GLuint)instanceCount, (GLuint)commandCount, pass, view.hiZ);
+    if(pass == GpuCulling::Pass::Late)
+        ReadOccludedCount();
+
+    // One draw per mesh, all its LODs at once. The late pass's commands follow the early pass's
+    const std::size_t firstCommand = (pass == GpuCulling::Pass::Late) ? commandCount : 0;
+    for(std::size_t m = 0; m < meshCount; m++)
+    {
+        const Mesh& mesh = data->meshes[m];
+        mDraw.Clear();
+        mDraw.indirectBuffer = mGpu.commands;
+        mDraw.indirectOffset = (GLintptr)((firstCommand + m * ModelData::MaxLods) * sizeof(GpuCulling::DrawCommand));
+        mDraw.indirectCount = (GLsizei)ModelData::MaxLods;
+        mDraw.screenPixels = mGpu.screenSize * view.viewportHeight;
+        queue.Submit(
+            RenderQueue::Pass::Opaque,
+            shaderOf(mesh),
+            mGpu.vao,
+            mesh,
+            mDraw,
+            RenderQueue::NoTransform,
+            0.0f,
+            mRenderMesh);
+    }
+}
+
+void ModelInstanceSet::ReadOccludedCount()
+{
+    // Only once the copy of an earlier frame landed, waiting on it would stall the frame
+    if(mGpu.fence != nullptr)
+    {
+        if(glClientWaitSync(mGpu.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+            return;
+        glDeleteSync(mGpu.fence);
+        mGpu.fence = nullptr;
+
+        GLuint occluded = 0;
+        glBindBuffer(GL_COPY_READ_BUFFER, mGpu.readback);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(GLuint), &occluded);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        mOccludedCount = occluded;
+    }
+
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_COPY_READ_BUFFER, mGpu.counters);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, mGpu.readback);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offsetof(GpuCulling::Counters, occluded), 0, sizeof(GLuint));
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    mGpu.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
\ No newline at end of file
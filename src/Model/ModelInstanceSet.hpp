@@ -0,0 +1,169 @@
+#ifndef ELESWORD_MODEL_INSTANCE_SET_HPP
+#define ELESWORD_MODEL_INSTANCE_SET_HPP
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include "Mesh.hpp"
+#include "Model.hpp"
+#include "VertexFormat.hpp"
+#include "../Render/AabbTree.hpp"
+#include "../Render/FrustumCuller.hpp"
+#include "../Render/GpuCulling.hpp"
+#include "../Render/RenderQueue.hpp"
+#include "../Render/RenderView.hpp"
+#include "../Render/Shader.hpp"
+#include "../Render/ShaderVariants.hpp"
+
+/// Models sharing one ModelData, drawn together with instanced draws. Visible
+/// instances are grouped by LOD and their matrices go to a per instance
+/// attribute buffer, so a group costs one draw per mesh however many instances
+/// it has. Shaders have to read the model matrix from the instance attributes
+/// (the INSTANCED define). With GPU culling the instances are culled and grouped
+/// by a compute pass instead, and every mesh is a single indirect draw covering
+/// all LODs. The GPU can also cull the instances hidden behind what is drawn (see
+/// SubmitLate). Must be used from the GL thread
+class ModelInstanceSet
+{
+public:
+    /// Constructor. Instances draw given data, or placeholder until data is resident
+    ModelInstanceSet(
+        const ModelData* const data,
+        Model::RenderMeshCb renderMesh,
+        const ModelData* const placeholder = nullptr);
+
+    /// Destructor
+    ~ModelInstanceSet();
+
+    ModelInstanceSet(const ModelInstanceSet&) = delete;
+    ModelInstanceSet& operator=(const ModelInstanceSet&) = delete;
+
+    /// Creates an instance, owned by the set. Move it like any other Model,
+    /// but draw it through the set
+    Model* AddInstance();
+
+    /// Retrieves the number of instances
+    std::size_t GetInstanceCount() const;
+
+    /// Culls and groups the instances on the GPU from now on, the CPU doesn't look at them
+    /// anymore, except for a conservative size on screen to stream the textures with.
+    /// Culling has to be ready and outlive the set
+    void EnableGpuCulling(const GpuCulling& culling);
+
+    /// Adds every instance to a scene index, see Model::Attach
+    void Attach(AabbTree& index);
+
+    /// Refits the instances whose drawn data changed in their scene index
+    void UpdateIndex();
+
+    /// Adds the world space boxes of every mesh of every instance to a culler, see
+    /// Model::AddBounds. Instances can be added one by one too. Once it culled them,
+    /// Submit with a view that carries the culler skips the instances it rejected or
+    /// that weren't added, and the meshes it rejected for every instance of a LOD
+    void AddBounds(FrustumCuller& culler) const;
+
+    /// Queues the instances in view in the opaque pass, one instanced draw per mesh and LOD.
+    /// Every instance picks its LOD like Model::Submit does, meshlets aren't culled.
+    /// With GPU culling and a view that carries a depth pyramid, only the instances
+    /// drawn last frame are. The set has to stay alive and unchanged until the queue is executed
+    void Submit(RenderQueue& queue, const Shader& shader, const RenderView& view);
+
+    /// Same as Submit, each mesh with the tightest instanced variant for its textures and given light count
+    void Submit(RenderQueue& queue, ShaderVariants& shaders, unsigned int pointLights, const RenderView& view);
+
+    /// Queues the instances Submit left out that the view's depth pyramid doesn't hide.
+    /// Call it once the queue Submit filled is executed and the pyramid built from its
+    /// depth, with the same view and shaders. Does nothing without GPU culling or pyramid
+    void SubmitLate(RenderQueue& queue, const Shader& shader, const RenderView& view);
+
+    /// Same as SubmitLate, with the shaders Submit takes
+    void SubmitLate(RenderQueue& queue, ShaderVariants& shaders, unsigned int pointLights, const RenderView& view);
+
+    /// Retrieves the number of instances the last Submit queued. With GPU culling
+    /// every instance is, the GPU drops the ones out of view
+    std::size_t GetVisibleCount() const;
+
+    /// Retrieves the number of instances in view SubmitLate found hidden and didn't draw.
+    /// Read back without waiting on the GPU, so it's a frame or two old
+    std::size_t GetOccludedCount() const;
+
+private:
+    /// Instances of one LOD. They sit next to each other in the instance buffer
+    struct LodGroup
+    {
+        std::vector<std::uint32_t> instances; /// Indices in mInstances
+        std::vector<std::uint8_t> meshes;     /// 1 for the meshes some instance shows
+        float depth;                          /// Distance of the closest instance
+        float screenSize;                     /// Of the largest instance on screen
+    };
+
+    /// Buffers of the GPU culling path, see GpuCulling for their contents
+    struct GpuBuffers
+    {
+        GLuint vao = 0;             /// Model's buffers and the attribute buffer from its start, commands pick their LOD with baseInstance
+        GLuint models = 0;
+        GLuint states = 0;
+        GLuint attributes = 0;
+        GLuint counters = 0;
+        GLuint commands = 0;
+        GLuint readback = 0;        /// Copy of the occluded count, read once fence is signaled
+        GLsync fence = nullptr;
+        std::size_t instanceCount = 0;   /// Instances the buffers are sized for
+        float screenSize = 0.0f;         /// Largest radius seen from the closest instance, set by the early pass
+        const ModelData* data = nullptr; /// Data the VAO and commands were built for
+    };
+
+    /// Picks the shader of a mesh
+    using ShaderSelector = std::function<const Shader&(const Mesh& mesh)>;
+
+    const ModelData* mData;
+    const ModelData* mPlaceholder;
+    Model::RenderMeshCb mRenderMesh;
+
+    std::vector<std::unique_ptr<Model>> mInstances;
+
+    /// A VAO per LOD over the model's buffers, each reading its group's part of the instance buffer
+    GLuint mVaos[ModelData::MaxLods];
+    const ModelData* mVaoData;    /// Data the VAOs read, they are rebuilt when the drawn data changes
+    GLuint mInstanceBuffer;
+
+    LodGroup mGroups[ModelData::MaxLods];
+    std::vector<InstanceAttributes> mAttributes; /// Contents of the instance buffer, kept to reuse its storage
+    std::size_t mVisibleCount;
+
+    const GpuCulling* mGpuCulling; /// Null when culling on the CPU
+    GpuBuffers mGpu;
+    std::size_t mOccludedCount;
+    std::vector<glm::mat4> mModels; /// Contents of the model buffer, kept to reuse its storage
+
+    MeshDraw mDraw;               /// Ranges of the mesh being queued, kept to reuse its storage
+
+    /// Picks the instanced variant of every mesh for given light count
+    static ShaderSelector InstancedVariants(ShaderVariants& shaders, unsigned int pointLights);
+
+    /// Points the VAOs at the buffers of given data
+    void BuildVaos(const ModelData& data);
+
+    /// Culls and groups the instances, uploads their attributes and queues the meshes,
+    /// each with the shader shaderOf picks
+    void SubmitMeshes(RenderQueue& queue, const ShaderSelector& shaderOf, const RenderView& view);
+
+    /// Sizes the GPU culling buffers for the instances and writes the draw commands of given data
+    void BuildGpuBuffers(const ModelData& data);
+
+    /// Culls the instances on the GPU for given pass and queues an indirect draw per mesh.
+    /// Passes other than the late one upload the model matrices first
+    void SubmitIndirect(RenderQueue& queue, const ShaderSelector& shaderOf, const RenderView& view, GpuCulling::Pass pass);
+
+    /// Reads the occluded count of an earlier late pass if the GPU is done with it,
+    /// and copies the count of the late pass just dispatched
+    void ReadOccludedCount();
+
+}; //~ ModelInstanceSet
+
+#endif //~ ELESWORD_MODEL_INSTANCE_SET_HPP
\ No newline at end of file
@@ -0,0 +1,164 @@
+#include "VertexFormat.hpp"
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+WARN_GUARD_ON
+#include <glm/gtc/packing.hpp>
+WARN_GUARD_OFF
+
+namespace
+{
+    /// Maps a unit vector to the [-1, 1] square of its octahedral projection
+    glm::vec2 OctahedralEncode(const glm::vec3& n)
+    {
+        float sum = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+        if(sum == 0.0f)
+            return glm::vec2(0.0f, 0.0f);
+
+        glm::vec2 p(n.x / sum, n.y / sum);
+
+        // Fold the lower hemisphere over the diagonals
+        if(n.z < 0.0f)
+        {
+            glm::vec2 folded(
+                (1.0f - std::fabs(p.y)) * (p.x >= 0.0f ? 1.0f : -1.0f),
+                (1.0f - std::fabs(p.x)) * (p.y >= 0.0f ? 1.0f : -1.0f));
+            p = folded;
+        }
+        return p;
+    }
+
+    void WriteFloats(GLubyte*& out, const float* values, std::size_t count)
+    {
+        std::memcpy(out, values, count * sizeof(float));
+        out += count * sizeof(float);
+    }
+
+    void WriteShort(GLubyte*& out, std::uint16_t value)
+    {
+        std::memcpy(out, &value, sizeof(value));
+        out += sizeof(value);
+    }
+}
+
+GLsizei VertexStride(VertexFormat format)
+{
+    switch(format)
+    {
+        case VertexFormat::Compact:
+            return 16;
+
+        case VertexFormat::Float:
+        default:
+            return 8 * sizeof(GLfloat);
+    }
+}
+
+GLsizei IndexTypeSize(GLenum indexType)
+{
+    return (indexType == GL_UNSIGNED_SHORT) ? sizeof(GLushort) : sizeof(GLuint);
+}
+
+void PackVertex(
+    VertexFormat format,
+    const glm::vec3& position,
+    const glm::vec3& normal,
+    const glm::vec2& texCoords,
+    const glm::vec3& positionScale,
+    const glm::vec3& positionOffset,
+    GLubyte* out)
+{
+    switch(format)
+    {
+        case VertexFormat::Compact:
+        {
+            glm::vec3 local = (position - positionOffset) / positionScale;
+            WriteShort(out, glm::packSnorm1x16(local.x));
+            WriteShort(out, glm::packSnorm1x16(local.y));
+            WriteShort(out, glm::packSnorm1x16(local.z));
+            WriteShort(out, 0);
+
+            glm::vec2 oct = OctahedralEncode(normal);
+            WriteShort(out, glm::packSnorm1x16(oct.x));
+            WriteShort(out, glm::packSnorm1x16(oct.y));
+
+            WriteShort(out, glm::packHalf1x16(texCoords.x));
+            WriteShort(out, glm::packHalf1x16(texCoords.y));
+            break;
+        }
+
+        case VertexFormat::Float:
+        default:
+        {
+            const float values[8] = {
+                position.x,  position.y, position.z,
+                normal.x,    normal.y,   normal.z,
+                texCoords.x, texCoords.y };
+            WriteFloats(out, values, 8);
+            break;
+        }
+    }
+}
+
+void SetupVertexAttributes(VertexFormat format)
+{
+    const GLsizei stride = VertexStride(format);
+
+    switch(format)
+    {
+        case VertexFormat::Compact:
+            // Vertices
+            glVertexAttribPointer(0, 3, GL_SHORT, GL_TRUE, stride, (GLvoid*)0);
+            // Normals
+            glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, stride, (GLvoid*)8);
+            // TexCoords
+            glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (GLvoid*)12);
+            break;
+
+        case VertexFormat::Float:
+        default:
+            // Vertices
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)0);
+            // Normals
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(3 * sizeof(GLfloat)));
+            // TexCoords
+            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(6 * sizeof(GLfloat)));
+            break;
+    }
+
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+}
+
+void SetupInstanceAttributes(GLintptr offset)
+{
+    const GLsizei stride = sizeof(InstanceAttributes);
+
+    // Matrices take an attribute per column
+    for(GLuint column = 0; column < 4; column++)
+    {
+        const GLintptr columnOffset = offset + offsetof(InstanceAttributes, model) + column * sizeof(glm::vec4);
+        glVertexAttribPointer(3 + column, 4, GL_FLOAT, GL_FALSE, stride, (GLvoid*)columnOffset);
+        glVertexAttribDivisor(3 + column, 1);
+        glEnableVertexAttribArray(3 + column);
+    }
+
+    for(GLuint column = 0; column < 3; column++)
+    {
+        const GLintptr columnOffset = offset + offsetof(InstanceAttributes, normal) + column * sizeof(glm::vec3);
+        glVertexAttribPointer(7 + column, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)columnOffset);
+        glVertexAttribDivisor(7 + column, 1);
+        glEnableVertexAttribArray(7 + column);
+    }
+}
+
+std::vector<std::string> VertexFormatDefines(VertexFormat format)
+{
+    std::vector<std::string> defines;
+    if(format == VertexFormat::Compact)
+        defines.push_back("COMPACT_VERTICES");
+    return defines;
+}
\ No newline at end of file
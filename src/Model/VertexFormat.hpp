@@ -0,0 +1,65 @@
+#ifndef ELESWORD_VERTEX_FORMAT_HPP
+#define ELESWORD_VERTEX_FORMAT_HPP
+
+#include "../Util/WarnGuard.hpp"
+
+#include <string>
+#include <vector>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+WARN_GUARD_ON
+#include <glm/glm.hpp>
+WARN_GUARD_OFF
+
+/// Layouts of the interleaved vertex stream of ModelData
+///
+/// Float   (32 bytes): position 3xfloat | normal 3xfloat | texcoords 2xfloat
+/// Compact (16 bytes): position 4xsnorm16 (w unused) | normal 2xsnorm16 (octahedral) | texcoords 2xhalf
+///
+/// Compact positions are stored relative to their mesh's bounds and need the
+/// mesh's positionScale/positionOffset to be dequantized in the vertex shader
+enum class VertexFormat
+{
+    Float = 0,
+    Compact
+}; //~ VertexFormat
+
+/// Per instance attributes of instanced model draws (see ModelInstanceSet)
+struct InstanceAttributes
+{
+    glm::mat4 model;  /// Model matrix, attributes 3 to 6
+    glm::mat3 normal; /// Transposed inverse of the model matrix, attributes 7 to 9
+
+}; //~ InstanceAttributes
+
+/// Retrieves the size in bytes of a vertex of given format
+GLsizei VertexStride(VertexFormat format);
+
+/// Retrieves the size in bytes of an index of given type (GL_UNSIGNED_SHORT or GL_UNSIGNED_INT)
+GLsizei IndexTypeSize(GLenum indexType);
+
+/// Writes a single vertex of given format to out. Positions are mapped
+/// from [offset - scale, offset + scale] to [-1, 1] for the compact format
+void PackVertex(
+    VertexFormat format,
+    const glm::vec3& position,
+    const glm::vec3& normal,
+    const glm::vec2& texCoords,
+    const glm::vec3& positionScale,
+    const glm::vec3& positionOffset,
+    GLubyte* out);
+
+/// Sets up the vertex attributes 0 (position), 1 (normal) and 2 (texcoords)
+/// of the bound VAO for the bound array buffer
+void SetupVertexAttributes(VertexFormat format);
+
+/// Sets up the attributes 3 to 9 of the bound VAO to step once per instance through
+/// the InstanceAttributes of the bound array buffer, starting at given byte offset
+void SetupInstanceAttributes(GLintptr offset);
+
+/// Retrieves the shader defines that make the model shaders read given format
+std::vector<std::string> VertexFormatDefines(VertexFormat format);
+
+#endif //~ ELESWORD_VERTEX_FORMAT_HPP
\ No newline at end of file
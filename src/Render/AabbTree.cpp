@@ -0,0 +1,521 @@
+#include "AabbTree.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+    /// Half the surface area of a box, the cost of visiting it
+    float Area(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+    {
+        const glm::vec3 d = boundsMax - boundsMin;
+        return d.x * d.y + d.y * d.z + d.z * d.x;
+    }
+
+    /// Checks if the first box holds the second one
+    bool Contains(const glm::vec3& outerMin, const glm::vec3& outerMax, const glm::vec3& innerMin, const glm::vec3& innerMax)
+    {
+        return outerMin.x <= innerMin.x && outerMin.y <= innerMin.y && outerMin.z <= innerMin.z
+            && innerMax.x <= outerMax.x && innerMax.y <= outerMax.y && innerMax.z <= outerMax.z;
+    }
+
+    /// Where a ray enters a box, negative if it misses it before maxDistance
+    float RayEnter(const glm::vec3& origin, const glm::vec3& invDirection, float maxDistance, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+    {
+        const glm::vec3 t1 = (boundsMin - origin) * invDirection;
+        const glm::vec3 t2 = (boundsMax - origin) * invDirection;
+        const glm::vec3 closer = glm::min(t1, t2);
+        const glm::vec3 further = glm::max(t1, t2);
+        const float enter = std::max(std::max(closer.x, closer.y), std::max(closer.z, 0.0f));
+        const float exit = std::min(std::min(further.x, further.y), std::min(further.z, maxDistance));
+        return enter <= exit ? enter : -1.0f;
+    }
+}
+
+//--------------------------------------------------
+// Public functions
+//--------------------------------------------------
+const std::int32_t AabbTree::Null;
+const float AabbTree::Margin = 0.1f;
+
+AabbTree::AabbTree()
+    : mRoot(Null)
+    , mFreeList(Null)
+    , mProxyCount(0)
+{
+}
+
+std::int32_t AabbTree::CreateProxy(const glm::vec3& boundsMin, const glm::vec3& boundsMax, void* userData)
+{
+    const std::int32_t proxy = AllocateNode();
+    Node& node = mNodes[proxy];
+    node.boundsMin = boundsMin - glm::vec3(Margin);
+    node.boundsMax = boundsMax + glm::vec3(Margin);
+    node.userData = userData;
+    node.height = 0;
+
+    InsertLeaf(proxy);
+    mProxyCount++;
+    return proxy;
+}
+
+void AabbTree::DestroyProxy(std::int32_t proxy)
+{
+    RemoveLeaf(proxy);
+    FreeNode(proxy);
+    mProxyCount--;
+}
+
+bool AabbTree::MoveProxy(std::int32_t proxy, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+    // Small moves stay inside the fat box. Boxes that shrank a lot get a tight one again
+    Node& node = mNodes[proxy];
+    const glm::vec3 slack(4.0f * Margin);
+    if(Contains(node.boundsMin, node.boundsMax, boundsMin, boundsMax)
+    && Contains(boundsMin - slack, boundsMax + slack, node.boundsMin, node.boundsMax))
+        return false;
+
+    RemoveLeaf(proxy);
+    mNodes[proxy].boundsMin = boundsMin - glm::vec3(Margin);
+    mNodes[proxy].boundsMax = boundsMax + glm::vec3(Margin);
+    InsertLeaf(proxy);
+    return true;
+}
+
+void* AabbTree::GetUserData(std::int32_t proxy) const
+{
+    return mNodes[proxy].userData;
+}
+
+void AabbTree::GetFatBounds(std::int32_t proxy, glm::vec3& boundsMin, glm::vec3& boundsMax) const
+{
+    boundsMin = mNodes[proxy].boundsMin;
+    boundsMax = mNodes[proxy].boundsMax;
+}
+
+void AabbTree::QueryFrustum(const Frustum& frustum, const QueryCb& callback) const
+{
+    if(mRoot == Null)
+        return;
+
+    mStack.clear();
+    mStack.push_back(mRoot);
+    while(!mStack.empty())
+    {
+        const std::int32_t index = mStack.back();
+        mStack.pop_back();
+        const Node& node = mNodes[index];
+
+        // Outside once the box is entirely behind a plane, inside once it's in front of all of them
+        const glm::vec3 center = (node.boundsMin + node.boundsMax) * 0.5f;
+        const glm::vec3 extents = (node.boundsMax - node.boundsMin) * 0.5f;
+        bool outside = false;
+        bool inside = true;
+        for(const glm::vec4& plane : frustum.planes)
+        {
+            const float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+            const float reach = glm::dot(glm::abs(glm::vec3(plane)), extents);
+            if(distance + reach < 0.0f)
+            {
+                outside = true;
+                break;
+            }
+            inside = inside && distance - reach >= 0.0f;
+        }
+        if(outside)
+            continue;
+
+        if(node.IsLeaf())
+        {
+            if(!callback(index))
+                return;
+            continue;
+        }
+
+        // Everything under a node inside the frustum is in, no need to test it
+        if(inside)
+        {
+            const std::size_t base = mStack.size();
+            mStack.push_back(index);
+            while(mStack.size() > base)
+            {
+                const std::int32_t innerIndex = mStack.back();
+                const Node& inner = mNodes[innerIndex];
+                mStack.pop_back();
+                if(inner.IsLeaf())
+                {
+                    if(!callback(innerIndex))
+                        return;
+                }
+                else
+                {
+                    mStack.push_back(inner.child1);
+                    mStack.push_back(inner.child2);
+                }
+            }
+            continue;
+        }
+
+        mStack.push_back(node.child1);
+        mStack.push_back(node.child2);
+    }
+}
+
+void AabbTree::QuerySphere(const glm::vec3& center, float radius, const QueryCb& callback) const
+{
+    if(mRoot == Null)
+        return;
+
+    mStack.clear();
+    mStack.push_back(mRoot);
+    while(!mStack.empty())
+    {
+        const std::int32_t index = mStack.back();
+        mStack.pop_back();
+        const Node& node = mNodes[index];
+
+        // Distance from the center to the closest point of the box
+        const glm::vec3 closest = glm::clamp(center, node.boundsMin, node.boundsMax);
+        const glm::vec3 d = closest - center;
+        if(glm::dot(d, d) > radius * radius)
+            continue;
+
+        if(node.IsLeaf())
+        {
+            if(!callback(index))
+                return;
+            continue;
+        }
+
+        mStack.push_back(node.child1);
+        mStack.push_back(node.child2);
+    }
+}
+
+std::int32_t AabbTree::RayCast(
+    const glm::vec3& origin,
+    const glm::vec3& direction,
+    float maxDistance,
+    const RayCb& callback,
+    float& distance) const
+{
+    std::int32_t result = Null;
+    distance = maxDistance;
+    if(mRoot == Null)
+        return result;
+
+    // Axes the ray is parallel to give infinities, which the slab test handles
+    const glm::vec3 invDirection = 1.0f / direction;
+
+    mStack.clear();
+    mStack.push_back(mRoot);
+    while(!mStack.empty())
+    {
+        const std::int32_t index = mStack.back();
+        mStack.pop_back();
+        const Node& node = mNodes[index];
+
+        // The ray is clipped at the closest hit so far
+        const float enter = RayEnter(origin, invDirection, distance, node.boundsMin, node.boundsMax);
+        if(enter < 0.0f)
+            continue;
+
+        if(node.IsLeaf())
+        {
+            const float hit = callback(index, enter);
+            if(hit >= 0.0f && hit < distance)
+            {
+                distance = hit;
+                result = index;
+            }
+            continue;
+        }
+
+        // Closer child last, so it's visited first
+        const Node& child1 = mNodes[node.child1];
+        const Node& child2 = mNodes[node.child2];
+        const float enter1 = RayEnter(origin, invDirection, distance, child1.boundsMin, child1.boundsMax);
+        const float enter2 = RayEnter(origin, invDirection, distance, child2.boundsMin, child2.boundsMax);
+        if(enter1 >= 0.0f && enter2 >= 0.0f)
+        {
+            mStack.push_back(enter1 < enter2 ? node.child2 : node.child1);
+            mStack.push_back(enter1 < enter2 ? node.child1 : node.child2);
+        }
+        else if(enter1 >= 0.0f)
+            mStack.push_back(node.child1);
+        else if(enter2 >= 0.0f)
+            mStack.push_back(node.child2);
+    }
+
+    return result;
+}
+
+std::size_t AabbTree::GetProxyCount() const
+{
+    return mProxyCount;
+}
+
+int AabbTree::GetHeight() const
+{
+    return mRoot == Null ? 0 : mNodes[mRoot].height;
+}
+
+//--------------------------------------------------
+// Private functions
+//--------------------------------------------------
+std::int32_t AabbTree::AllocateNode()
+{
+    // Grow the pool and chain the new nodes in the free list
+    if(mFreeList == Null)
+    {
+        const std::int32_t first = (std::int32_t)mNodes.size();
+        const std::int32_t count = std::max<std::int32_t>(16, first);
+        mNodes.resize(mNodes.size() + count);
+        for(std::int32_t i = first; i < first + count; i++)
+        {
+            mNodes[i].parent = (i + 1 < first + count) ? i + 1 : Null;
+            mNodes[i].height = -1;
+        }
+        mFreeList = first;
+    }
+
+    const std::int32_t index = mFreeList;
+    Node& node = mNodes[index];
+    mFreeList = node.parent;
+    node.parent = Null;
+    node.child1 = Null;
+    node.child2 = Null;
+    node.userData = nullptr;
+    node.height = 0;
+    return index;
+}
+
+void AabbTree::FreeNode(std::int32_t node)
+{
+    mNodes[node].parent = mFreeList;
+    mNodes[node].height = -1;
+    mFreeList = node;
+}
+
+void AabbTree::InsertLeaf(std::int32_t leaf)
+{
+    if(mRoot == Null)
+    {
+        mRoot = leaf;
+        mNodes[leaf].parent = Null;
+        return;
+    }
+
+    // Walk down to the sibling that adds the least area to the tree
+    const glm::vec3 leafMin = mNodes[leaf].boundsMin;
+    const glm::vec3 leafMax = mNodes[leaf].boundsMax;
+    std::int32_t index = mRoot;
+    while(!mNodes[index].IsLeaf())
+    {
+        const Node& node = mNodes[index];
+        const float area = Area(node.boundsMin, node.boundsMax);
+        const float combinedArea = Area(glm::min(node.boundsMin, leafMin), glm::max(node.boundsMax, leafMax));
+
+        // Cost of making the leaf a sibling of this node, and the area every level below pays for it
+        const float cost = 2.0f * combinedArea;
+        const float inheritanceCost = 2.0f * (combinedArea - area);
+
+        float childCosts[2];
+        const std::int32_t children[2] = { node.child1, node.child2 };
+        for(int i = 0; i < 2; i++)
+        {
+            const Node& child = mNodes[children[i]];
+            const float grownArea = Area(glm::min(child.boundsMin, leafMin), glm::max(child.boundsMax, leafMax));
+            childCosts[i] = (child.IsLeaf() ? grownArea : grownArea - Area(child.boundsMin, child.boundsMax)) + inheritanceCost;
+        }
+
+        if(cost < childCosts[0] && cost < childCosts[1])
+            break;
+
+        index = childCosts[0] < childCosts[1] ? children[0] : children[1];
+    }
+    const std::int32_t sibling = index;
+
+    // A new parent takes the sibling's place
+    const std::int32_t oldParent = mNodes[sibling].parent;
+    const std::int32_t newParent = AllocateNode();
+    mNodes[newParent].parent = oldParent;
+    mNodes[newParent].boundsMin = glm::min(mNodes[sibling].boundsMin, leafMin);
+    mNodes[newParent].boundsMax = glm::max(mNodes[sibling].boundsMax, leafMax);
+    mNodes[newParent].height = mNodes[sibling].height + 1;
+    mNodes[newParent].child1 = sibling;
+    mNodes[newParent].child2 = leaf;
+    mNodes[sibling].parent = newParent;
+    mNodes[leaf].parent = newParent;
+
+    if(oldParent == Null)
+        mRoot = newParent;
+    else if(mNodes[oldParent].child1 == sibling)
+        mNodes[oldParent].child1 = newParent;
+    else
+        mNodes[oldParent].child2 = newParent;
+
+    RefitFrom(mNodes[leaf].parent);
+}
+
+void AabbTree::RemoveLeaf(std::int32_t leaf)
+{
+    if(leaf == mRoot)
+    {
+        mRoot = Null;
+        return;
+    }
+
+    // The sibling takes the parent's place
+    const std::int32_t parent = mNodes[leaf].parent;
+    const std::int32_t grandParent = mNodes[parent].parent;
+    const std::int32_t sibling = mNodes[parent].child1 == leaf ? mNodes[parent].child2 : mNodes[parent].child1;
+
+    if(grandParent == Null)
+    {
+        mRoot = sibling;
+        mNodes[sibling].parent = Null;
+        FreeNode(parent);
+        return;
+    }
+
+    if(mNodes[grandParent].child1 == parent)
+        mNodes[grandParent].child1 = sibling;
+    else
+        mNodes[grandParent].child2 = sibling;
+    mNodes[sibling].parent = grandParent;
+    FreeNode(parent);
+
+    RefitFrom(grandParent);
+}
+
+void AabbTree::RefitFrom(std::int32_t index)
+{
+    while(index != Null)
+    {
+        index = Balance(index);
+
+        Node& node = mNodes[index];
+        const Node& child1 = mNodes[node.child1];
+        const Node& child2 = mNodes[node.child2];
+        node.height = 1 + std::max(child1.height, child2.height);
+        node.boundsMin = glm::min(child1.boundsMin, child2.boundsMin);
+        node.boundsMax = glm::max(child1.boundsMax, child2.boundsMax);
+
+        index = node.parent;
+    }
+}
+
+std::int32_t AabbTree::Balance(std::int32_t iA)
+{
+    Node& A = mNodes[iA];
+    if(A.IsLeaf() || A.height < 2)
+        return iA;
+
+    const std::int32_t iB = A.child1;
+    const std::int32_t iC = A.child2;
+    Node& B = mNodes[iB];
+    Node& C = mNodes[iC];
+
+    const int balance = C.height - B.height;
+
+    // Rotate C up
+    if(balance > 1)
+    {
+        const std::int32_t iF = C.child1;
+        const std::int32_t iG = C.child2;
+        Node& F = mNodes[iF];
+        Node& G = mNodes[iG];
+
+        // Swap A and C
+        C.child1 = iA;
+        C.parent = A.parent;
+        A.parent = iC;
+
+        if(C.parent == Null)
+            mRoot = iC;
+        else if(mNodes[C.parent].child1 == iA)
+            mNodes[C.parent].child1 = iC;
+        else
+            mNodes[C.parent].child2 = iC;
+
+        // The taller of F and G stays under C
+        if(F.height > G.height)
+        {
+            C.child2 = iF;
+            A.child2 = iG;
+            G.parent = iA;
+            A.boundsMin = glm::min(B.boundsMin, G.boundsMin);
+            A.boundsMax = glm::max(B.boundsMax, G.boundsMax);
+            C.boundsMin = glm::min(A.boundsMin, F.boundsMin);
+            C.boundsMax = glm::max(A.boundsMax, F.boundsMax);
+            A.height = 1 + std::max(B.height, G.height);
+            C.height = 1 + std::max(A.height, F.height);
+        }
+        else
+        {
+            C.child2 = iG;
+            A.child2 = iF;
+            F.parent = iA;
+            A.boundsMin = glm::min(B.boundsMin, F.boundsMin);
+            A.boundsMax = glm::max(B.boundsMax, F.boundsMax);
+            C.boundsMin = glm::min(A.boundsMin, G.boundsMin);
+            C.boundsMax = glm::max(A.boundsMax, G.boundsMax);
+            A.height = 1 + std::max(B.height, F.height);
+            C.height = 1 + std::max(A.height, G.height);
+        }
+
+        return iC;
+    }
+
+    // Rotate B up
+    if(balance < -1)
+    {
+        const std::int32_t iD = B.child1;
+        const std::int32_t iE = B.child2;
+        Node& D = mNodes[iD];
+        Node& E = mNodes[iE];
+
+        // Swap A and B
+        B.child1 = iA;
+        B.parent = A.parent;
+        A.parent = iB;
+
+        if(B.parent == Null)
+            mRoot = iB;
+        else if(mNodes[B.parent].child1 == iA)
+            mNodes[B.parent].child1 = iB;
+        else
+            mNodes[B.parent].child2 = iB;
+
+        // The taller of D and E stays under B
+        if(D.height > E.height)
+        {
+            B.child2 = iD;
+            A.child1 = iE;
+            E.parent = iA;
+            A.boundsMin = glm::min(C.boundsMin, E.boundsMin);
+            A.boundsMax = glm::max(C.boundsMax, E.boundsMax);
+            B.boundsMin = glm::min(A.boundsMin, D.boundsMin);
+            B.boundsMax = glm::max(A.boundsMax, D.boundsMax);
+            A.height = 1 + std::max(C.height, E.height);
+            B.height = 1 + std::max(A.height, D.height);
+        }
+        else
+        {
+            B.child2 = iE;
+            A.child1 = iD;
+            D.parent = iA;
+            A.boundsMin = glm::min(C.boundsMin, D.boundsMin);
+            A.boundsMax = glm::max(C.boundsMax, D.boundsMax);
+            B.boundsMin = glm::min(A.boundsMin, E.boundsMin);
+            B.boundsMax = glm::max(A.boundsMax, E.boundsMax);
+            A.height = 1 + std::max(C.height, D.height);
+            B.height = 1 + std::max(A.height, E.height);
+        }
+
+        return iB;
+    }
+
+    return iA;
+}
\ No newline at end of file
@@ -0,0 +1,113 @@
+#ifndef ELESWORD_AABB_TREE_HPP
+#define ELESWORD_AABB_TREE_HPP
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "../Util/WarnGuard.hpp"
+WARN_GUARD_ON
+#include <glm/glm.hpp>
+WARN_GUARD_OFF
+
+#include "Frustum.hpp"
+
+/// Dynamic bounding volume hierarchy of world space boxes (proxies), each
+/// carrying a user pointer. Leaves store their box grown by a margin, so objects
+/// moving a little don't touch the tree. When a box leaves its fat box the leaf
+/// is reinserted where it adds the least surface area, and the path to the root
+/// is refit and rebalanced with tree rotations. Queries and updates cost O(log n).
+/// Not thread safe, queries share a traversal stack
+class AabbTree
+{
+public:
+    /// Id of no proxy
+    static const std::int32_t Null = -1;
+
+    /// Distance leaf boxes are grown by on every side
+    static const float Margin;
+
+    /// Called for every proxy a query finds. Return false to stop the query
+    using QueryCb = std::function<bool(std::int32_t proxy)>;
+
+    /// Called for every proxy whose box a ray hits, with the distance along the ray where
+    /// it enters the box. Returns the distance of the actual hit, or a negative value to
+    /// ignore the proxy. Hits further than the closest one so far aren't reported
+    using RayCb = std::function<float(std::int32_t proxy, float boxDistance)>;
+
+    /// Constructor
+    AabbTree();
+
+    /// Adds a box. Returns its proxy id
+    std::int32_t CreateProxy(const glm::vec3& boundsMin, const glm::vec3& boundsMax, void* userData);
+
+    /// Removes a proxy
+    void DestroyProxy(std::int32_t proxy);
+
+    /// Moves a proxy to a new box. Returns true if the leaf had to be reinserted,
+    /// false if the box is still inside its fat box
+    bool MoveProxy(std::int32_t proxy, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+    /// Retrieves the user pointer of a proxy
+    void* GetUserData(std::int32_t proxy) const;
+
+    /// Retrieves the fat box of a proxy
+    void GetFatBounds(std::int32_t proxy, glm::vec3& boundsMin, glm::vec3& boundsMax) const;
+
+    /// Finds the proxies whose fat box is at least partially inside a frustum
+    void QueryFrustum(const Frustum& frustum, const QueryCb& callback) const;
+
+    /// Finds the proxies whose fat box touches a sphere
+    void QuerySphere(const glm::vec3& center, float radius, const QueryCb& callback) const;
+
+    /// Casts a ray, direction normalized, up to given distance. Returns the proxy of the
+    /// closest hit the callback reported, Null if none, and its distance in distance
+    std::int32_t RayCast(
+        const glm::vec3& origin,
+        const glm::vec3& direction,
+        float maxDistance,
+        const RayCb& callback,
+        float& distance) const;
+
+    /// Retrieves the number of proxies
+    std::size_t GetProxyCount() const;
+
+    /// Retrieves the height of the tree, 0 for a single leaf
+    int GetHeight() const;
+
+private:
+    struct Node
+    {
+        glm::vec3 boundsMin;    /// Fat box for leaves, union of the children for the others
+        glm::vec3 boundsMax;
+        void* userData;
+        std::int32_t parent;    /// Next free node while the node is free
+        std::int32_t child1;    /// Null for leaves
+        std::int32_t child2;
+        int height;             /// 0 for leaves, -1 while the node is free
+
+        bool IsLeaf() const { return child1 == Null; }
+    };
+
+    std::vector<Node> mNodes;
+    std::int32_t mRoot;
+    std::int32_t mFreeList;
+    std::size_t mProxyCount;
+
+    mutable std::vector<std::int32_t> mStack; /// Traversal stack of the queries
+
+    std::int32_t AllocateNode();
+    void FreeNode(std::int32_t node);
+
+    void InsertLeaf(std::int32_t leaf);
+    void RemoveLeaf(std::int32_t leaf);
+
+    /// Refits and rebalances the nodes from given one up to the root
+    void RefitFrom(std::int32_t node);
+
+    /// Rotates given node's subtree if it's imbalanced. Returns the subtree's new root
+    std::int32_t Balance(std::int32_t node);
+
+}; //~ AabbTree
+
+#endif //~ ELESWORD_AABB_TREE_HPP
\ No newline at end of file
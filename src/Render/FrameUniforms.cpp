@@ -0,0 +1,52 @@
+#include "FrameUniforms.hpp"
+
+const char* const FrameUniforms::BlockName = "Frame";
+
+FrameUniforms::FrameUniforms()
+{
+    static_assert(sizeof(PointLightBlock) == 64, "PointLightBlock must match the std140 layout");
+    static_assert(sizeof(Block) == 144 + 64 * MaxPointLights, "Block must match the std140 layout");
+
+    glGenBuffers(1, &mUBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, mUBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    // The binding point keeps the buffer, whatever gets bound to GL_UNIFORM_BUFFER later
+    glBindBufferBase(GL_UNIFORM_BUFFER, Binding, mUBO);
+}
+
+FrameUniforms::~FrameUniforms()
+{
+    glDeleteBuffers(1, &mUBO);
+}
+
+void FrameUniforms::Update(
+    const glm::mat4& view,
+    const glm::mat4& proj,
+    const glm::vec3& viewPos,
+    const PointLight* pointLights,
+    std::size_t pointLightCount)
+{
+    Block block = {};
+    block.view = view;
+    block.projection = proj;
+    block.viewPos = viewPos;
+
+    for(std::size_t i = 0; i < pointLightCount && i < MaxPointLights; i++)
+    {
+        PointLightBlock& light = block.pointLights[i];
+        light.position  = pointLights[i].attr.position;
+        light.constant  = pointLights[i].attr.constant;
+        light.linear    = pointLights[i].attr.linear;
+        light.quadratic = pointLights[i].attr.quadratic;
+        light.ambient   = pointLights[i].ambient;
+        light.diffuse   = pointLights[i].diffuse;
+        light.specular  = pointLights[i].specular;
+    }
+
+    // Whole buffer each frame, so the driver can hand out fresh storage instead of waiting on the last frame
+    glBindBuffer(GL_UNIFORM_BUFFER, mUBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), &block, GL_STREAM_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
\ No newline at end of file
@@ -0,0 +1,76 @@
+#ifndef ELESWORD_FRAMEUNIFORMS_HPP
+#define ELESWORD_FRAMEUNIFORMS_HPP
+
+#include <cstddef>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include "../Util/WarnGuard.hpp"
+WARN_GUARD_ON
+#include <glm/glm.hpp>
+WARN_GUARD_OFF
+
+#include "Light.hpp"
+
+/// Uniform buffer with the data every shader shares in a frame: camera and lights.
+/// Shaders read it through a std140 block named Frame, which Shader::Init binds
+/// to Binding. Must be created and updated from the GL thread
+class FrameUniforms
+{
+public:
+    /// Uniform buffer binding point of the Frame block
+    static const GLuint Binding = 0;
+
+    /// Name of the block in the shaders
+    static const char* const BlockName;
+
+    /// Length of the light array of the block (NR_POINT_LIGHTS in the shaders)
+    static const std::size_t MaxPointLights = 2;
+
+    /// Creates the buffer and binds it to Binding
+    FrameUniforms();
+
+    /// Non copyable
+    FrameUniforms(const FrameUniforms&) = delete;
+    FrameUniforms& operator=(const FrameUniforms&) = delete;
+
+    ~FrameUniforms();
+
+    /// Writes the frame's data. Lights past MaxPointLights are ignored, missing ones are black
+    void Update(
+        const glm::mat4& view,
+        const glm::mat4& proj,
+        const glm::vec3& viewPos,
+        const PointLight* pointLights,
+        std::size_t pointLightCount);
+
+private:
+    /// PointLight of the Frame block. Members are ordered so std140 packs the vec3s with the floats
+    struct PointLightBlock
+    {
+        glm::vec3 position;
+        float     constant;
+        glm::vec3 ambient;
+        float     linear;
+        glm::vec3 diffuse;
+        float     quadratic;
+        glm::vec3 specular;
+        float     padding;
+    };
+
+    /// The Frame block, std140
+    struct Block
+    {
+        glm::mat4 view;
+        glm::mat4 projection;
+        glm::vec3 viewPos;
+        float     padding;
+        PointLightBlock pointLights[MaxPointLights];
+    };
+
+    GLuint mUBO;
+
+}; //~ FrameUniforms
+
+#endif //~ ELESWORD_FRAMEUNIFORMS_HPP
\ No newline at end of file
@@ -0,0 +1,25 @@
+#ifndef ELESWORD_FRUSTUM_HPP
+#define ELESWORD_FRUSTUM_HPP
+
+#include "../Util/WarnGuard.hpp"
+
+WARN_GUARD_ON
+#include <glm/glm.hpp>
+WARN_GUARD_OFF
+
+/// View frustum as six inward facing planes (normal.xyz, distance.w).
+/// The planes live in the space the matrix they are extracted from starts in,
+/// so extracting from proj * view * model gives them in model space
+struct Frustum
+{
+    glm::vec4 planes[6]; /// Left, right, bottom, top, near, far
+
+    /// Extracts the planes of a clip matrix (Gribb & Hartmann)
+    static Frustum FromMatrix(const glm::mat4& clip);
+
+    /// Checks if a sphere is at least partially inside the frustum
+    bool IntersectsSphere(const glm::vec3& center, float radius) const;
+
+}; //~ Frustum
+
+#endif //~ ELESWORD_FRUSTUM_HPP
\ No newline at end of file
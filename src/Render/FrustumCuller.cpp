@@ -0,0 +1,210 @@
+#include "FrustumCuller.hpp"
+#include <cmath>
+
+// SSE is always there on x64. AVX is used when the compiler targets it (/arch:AVX, -mavx)
+#if defined(__AVX__)
+#define ELESWORD_CULL_AVX
+#include <immintrin.h>
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define ELESWORD_CULL_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace
+{
+    /// Boxes tested per iteration at most, the arrays are padded to a multiple of it
+    const std::uint32_t BatchSize = 8;
+
+    const int PlaneCount = 6;
+}
+
+//--------------------------------------------------
+// Public functions
+//--------------------------------------------------
+FrustumCuller::FrustumCuller()
+    : mCount(0)
+    , mFrame(0)
+    , mStats()
+{
+}
+
+void FrustumCuller::Clear()
+{
+    mCenterX.clear();
+    mCenterY.clear();
+    mCenterZ.clear();
+    mExtentX.clear();
+    mExtentY.clear();
+    mExtentZ.clear();
+    mVisible.clear();
+    mCount = 0;
+    mFrame++;
+}
+
+std::uint32_t FrustumCuller::Add(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::mat4& model)
+{
+    const glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    const glm::vec3 extents = (boundsMax - boundsMin) * 0.5f;
+
+    // The world space box around the transformed one reaches as far as the
+    // absolute matrix takes the extents (Arvo)
+    const glm::vec3 worldCenter = glm::vec3(model * glm::vec4(center, 1.0f));
+    glm::vec3 worldExtents;
+    for(int row = 0; row < 3; row++)
+    {
+        worldExtents[row] = std::fabs(model[0][row]) * extents.x
+                          + std::fabs(model[1][row]) * extents.y
+                          + std::fabs(model[2][row]) * extents.z;
+    }
+
+    mCenterX.push_back(worldCenter.x);
+    mCenterY.push_back(worldCenter.y);
+    mCenterZ.push_back(worldCenter.z);
+    mExtentX.push_back(worldExtents.x);
+    mExtentY.push_back(worldExtents.y);
+    mExtentZ.push_back(worldExtents.z);
+    return mCount++;
+}
+
+void FrustumCuller::Cull(const Frustum& frustum)
+{
+    // Padding boxes get tested too, their results are never read
+    const std::uint32_t padded = (mCount + BatchSize - 1) / BatchSize * BatchSize;
+    mCenterX.resize(padded, 0.0f);
+    mCenterY.resize(padded, 0.0f);
+    mCenterZ.resize(padded, 0.0f);
+    mExtentX.resize(padded, 0.0f);
+    mExtentY.resize(padded, 0.0f);
+    mExtentZ.resize(padded, 0.0f);
+    mVisible.resize(padded);
+
+    // A box is outside once it's entirely behind one plane: the center's distance
+    // plus the box's reach along the plane normal is negative
+    std::uint32_t i = 0;
+#if defined(ELESWORD_CULL_AVX)
+    __m256 planeX[PlaneCount], planeY[PlaneCount], planeZ[PlaneCount], planeW[PlaneCount];
+    __m256 reachX[PlaneCount], reachY[PlaneCount], reachZ[PlaneCount];
+    for(int p = 0; p < PlaneCount; p++)
+    {
+        const glm::vec4& plane = frustum.planes[p];
+        planeX[p] = _mm256_set1_ps(plane.x);
+        planeY[p] = _mm256_set1_ps(plane.y);
+        planeZ[p] = _mm256_set1_ps(plane.z);
+        planeW[p] = _mm256_set1_ps(plane.w);
+        reachX[p] = _mm256_set1_ps(std::fabs(plane.x));
+        reachY[p] = _mm256_set1_ps(std::fabs(plane.y));
+        reachZ[p] = _mm256_set1_ps(std::fabs(plane.z));
+    }
+
+    const __m256 zero = _mm256_setzero_ps();
+    for(; i < mCount; i += 8)
+    {
+        const __m256 cx = _mm256_loadu_ps(&mCenterX[i]);
+        const __m256 cy = _mm256_loadu_ps(&mCenterY[i]);
+        const __m256 cz = _mm256_loadu_ps(&mCenterZ[i]);
+        const __m256 ex = _mm256_loadu_ps(&mExtentX[i]);
+        const __m256 ey = _mm256_loadu_ps(&mExtentY[i]);
+        const __m256 ez = _mm256_loadu_ps(&mExtentZ[i]);
+
+        __m256 inside = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+        for(int p = 0; p < PlaneCount; p++)
+        {
+            const __m256 distance = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(planeX[p], cx), _mm256_mul_ps(planeY[p], cy)),
+                _mm256_add_ps(_mm256_mul_ps(planeZ[p], cz), planeW[p]));
+            const __m256 reach = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(reachX[p], ex), _mm256_mul_ps(reachY[p], ey)),
+                _mm256_mul_ps(reachZ[p], ez));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, reach), zero, _CMP_GE_OQ));
+        }
+
+        const int mask = _mm256_movemask_ps(inside);
+        for(int k = 0; k < 8; k++)
+            mVisible[i + k] = (std::uint8_t)((mask >> k) & 1);
+    }
+#elif defined(ELESWORD_CULL_SSE)
+    __m128 planeX[PlaneCount], planeY[PlaneCount], planeZ[PlaneCount], planeW[PlaneCount];
+    __m128 reachX[PlaneCount], reachY[PlaneCount], reachZ[PlaneCount];
+    for(int p = 0; p < PlaneCount; p++)
+    {
+        const glm::vec4& plane = frustum.planes[p];
+        planeX[p] = _mm_set1_ps(plane.x);
+        planeY[p] = _mm_set1_ps(plane.y);
+        planeZ[p] = _mm_set1_ps(plane.z);
+        planeW[p] = _mm_set1_ps(plane.w);
+        reachX[p] = _mm_set1_ps(std::fabs(plane.x));
+        reachY[p] = _mm_set1_ps(std::fabs(plane.y));
+        reachZ[p] = _mm_set1_ps(std::fabs(plane.z));
+    }
+
+    const __m128 zero = _mm_setzero_ps();
+    for(; i < mCount; i += 4)
+    {
+        const __m128 cx = _mm_loadu_ps(&mCenterX[i]);
+        const __m128 cy = _mm_loadu_ps(&mCenterY[i]);
+        const __m128 cz = _mm_loadu_ps(&mCenterZ[i]);
+        const __m128 ex = _mm_loadu_ps(&mExtentX[i]);
+        const __m128 ey = _mm_loadu_ps(&mExtentY[i]);
+        const __m128 ez = _mm_loadu_ps(&mExtentZ[i]);
+
+        __m128 inside = _mm_cmpeq_ps(zero, zero);
+        for(int p = 0; p < PlaneCount; p++)
+        {
+            const __m128 distance = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(planeX[p], cx), _mm_mul_ps(planeY[p], cy)),
+                _mm_add_ps(_mm_mul_ps(planeZ[p], cz), planeW[p]));
+            const __m128 reach = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(reachX[p], ex), _mm_mul_ps(reachY[p], ey)),
+                _mm_mul_ps(reachZ[p], ez));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, reach), zero));
+        }
+
+        const int mask = _mm_movemask_ps(inside);
+        for(int k = 0; k < 4; k++)
+            mVisible[i + k] = (std::uint8_t)((mask >> k) & 1);
+    }
+#endif
+    for(; i < mCount; i++)
+    {
+        bool inside = true;
+        for(int p = 0; p < PlaneCount && inside; p++)
+        {
+            const glm::vec4& plane = frustum.planes[p];
+            const float distance = plane.x * mCenterX[i] + plane.y * mCenterY[i] + plane.z * mCenterZ[i] + plane.w;
+            const float reach = std::fabs(plane.x) * mExtentX[i] + std::fabs(plane.y) * mExtentY[i] + std::fabs(plane.z) * mExtentZ[i];
+            inside = distance + reach >= 0.0f;
+        }
+        mVisible[i] = inside ? 1 : 0;
+    }
+
+    // Drop the padding, boxes added later go right after the real ones
+    mCenterX.resize(mCount);
+    mCenterY.resize(mCount);
+    mCenterZ.resize(mCount);
+    mExtentX.resize(mCount);
+    mExtentY.resize(mCount);
+    mExtentZ.resize(mCount);
+    mVisible.resize(mCount);
+
+    mStats.tested = mCount;
+    mStats.visible = 0;
+    for(std::uint32_t j = 0; j < mCount; j++)
+        mStats.visible += mVisible[j];
+    mStats.culled = mStats.tested - mStats.visible;
+}
+
+bool FrustumCuller::IsVisible(std::uint32_t index) const
+{
+    // Boxes added after the last Cull weren't tested
+    return index >= mVisible.size() || mVisible[index] != 0;
+}
+
+std::uint32_t FrustumCuller::GetFrame() const
+{
+    return mFrame;
+}
+
+const FrustumCuller::Stats& FrustumCuller::GetStats() const
+{
+    return mStats;
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+#ifndef ELESWORD_FRUSTUM_CULLER_HPP
+#define ELESWORD_FRUSTUM_CULLER_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "../Util/WarnGuard.hpp"
+WARN_GUARD_ON
+#include <glm/glm.hpp>
+WARN_GUARD_OFF
+
+#include "Frustum.hpp"
+
+/// World space bounding boxes of a frame, tested against the view frustum in one batch
+/// before anything is queued. Boxes are kept as center and extents in separate arrays
+/// and tested eight at a time with AVX, four with SSE, and one by one otherwise
+class FrustumCuller
+{
+public:
+    /// Boxes tested by the last Cull
+    struct Stats
+    {
+        std::size_t tested;
+        std::size_t visible;
+        std::size_t culled;
+    };
+
+    /// Constructor
+    FrustumCuller();
+
+    /// Forgets the boxes of the last frame
+    void Clear();
+
+    /// Adds a model space box, moved to world space with given model matrix. Returns its index
+    std::uint32_t Add(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::mat4& model);
+
+    /// Tests every box added since Clear against given world space frustum
+    void Cull(const Frustum& frustum);
+
+    /// Checks if a box passed the last Cull
+    bool IsVisible(std::uint32_t index) const;
+
+    /// Retrieves the frame of the boxes, changes with every Clear. Lets callers
+    /// tell the indices they got from indices of an older frame
+    std::uint32_t GetFrame() const;
+
+    /// Retrieves the counts of the last Cull
+    const Stats& GetStats() const;
+
+private:
+    // Boxes, padded to a multiple of 8 while Cull runs
+    std::vector<float> mCenterX, mCenterY, mCenterZ;
+    std::vector<float> mExtentX, mExtentY, mExtentZ;
+    std::vector<std::uint8_t> mVisible; /// 1 for boxes at least partially inside
+
+    std::uint32_t mCount;
+    std::uint32_t mFrame;
+    Stats mStats;
+
+}; //~ FrustumCuller
+
+#endif //~ ELESWORD_FRUSTUM_CULLER_HPP
\ No newline at end of file
@@ -0,0 +1,82 @@
+#include "GpuCulling.hpp"
+
+//--------------------------------------------------
+// Static functions
+//--------------------------------------------------
+const GLuint GpuCulling::InstanceBinding;
+const GLuint GpuCulling::StateBinding;
+const GLuint GpuCulling::AttributeBinding;
+const GLuint GpuCulling::CounterBinding;
+const GLuint GpuCulling::CommandBinding;
+const GLuint GpuCulling::GroupSize;
+
+bool GpuCulling::IsSupported()
+{
+    // The shaders are GLSL 430 and the counters are reset with glClearBufferData,
+    // so the extensions alone on an older context aren't enough
+    return GLEW_VERSION_4_3 != GL_FALSE;
+}
+
+//--------------------------------------------------
+// Public functions
+//--------------------------------------------------
+void GpuCulling::Init(const std::string& computePath)
+{
+    mCullShader.InitCompute(computePath);
+    mCommandShader.InitCompute(computePath, { "WRITE_COMMANDS" });
+
+    mBoundsMin     = mCullShader.GetUniform<glm::vec3>("boundsMin");
+    mBoundsMax     = mCullShader.GetUniform<glm::vec3>("boundsMax");
+    mBoundsCenter  = mCullShader.GetUniform<glm::vec3>("boundsCenter");
+    mBoundsRadius  = mCullShader.GetUniform<GLfloat>("boundsRadius");
+    mLodCount      = mCullShader.GetUniform<GLint>("lodCount");
+    mInstanceCount = mCullShader.GetUniform<GLint>("instanceCount");
+    mCullPass      = mCullShader.GetUniform<GLint>("cullPass");
+
+    mCommandCount         = mCommandShader.GetUniform<GLint>("commandCount");
+    mCommandInstanceCount = mCommandShader.GetUniform<GLint>("instanceCount");
+    mCommandPass          = mCommandShader.GetUniform<GLint>("cullPass");
+}
+
+bool GpuCulling::IsReady() const
+{
+    return mCullShader.IsReady() && mCommandShader.IsReady();
+}
+
+void GpuCulling::Dispatch(
+    const ModelData& data,
+    GLuint instanceCount,
+    GLuint commandCount,
+    Pass pass,
+    const HiZBuffer* hiZ) const
+{
+    if(pass == Pass::Late)
+    {
+        glActiveTexture(GL_TEXTURE0 + HiZBuffer::TextureUnit);
+        glBindTexture(GL_TEXTURE_2D, hiZ->GetTexture());
+    }
+
+    mCullShader.Use();
+    mBoundsMin.Set(data.boundsMin);
+    mBoundsMax.Set(data.boundsMax);
+    mBoundsCenter.Set(data.boundsCenter);
+    mBoundsRadius.Set(data.boundsRadius);
+    mLodCount.Set((GLint)data.lodCount);
+    mInstanceCount.Set((GLint)instanceCount);
+    mCullPass.Set((GLint)pass);
+    glDispatchCompute((instanceCount + GroupSize - 1) / GroupSize, 1, 1);
+
+    // The counters have to be final before they are copied
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    mCommandShader.Use();
+    mCommandCount.Set((GLint)commandCount);
+    mCommandInstanceCount.Set((GLint)instanceCount);
+    mCommandPass.Set((GLint)pass);
+    glDispatchCompute((commandCount + GroupSize - 1) / GroupSize, 1, 1);
+
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+
+    if(pass == Pass::Late)
+        glBindTexture(GL_TEXTURE_2D, 0);
+}
\ No newline at end of file
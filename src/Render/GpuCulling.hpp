@@ -0,0 +1,104 @@
+#ifndef ELESWORD_GPU_CULLING_HPP
+#define ELESWORD_GPU_CULLING_HPP
+
+#include <string>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include "HiZBuffer.hpp"
+#include "Shader.hpp"
+#include "../Model/Model.hpp"
+
+/// Compute programs that cull the instances of a model on the GPU and write their draws
+/// to an indirect buffer, so drawing them costs the CPU the same however many there are
+/// (see ModelInstanceSet::EnableGpuCulling). The first program tests every instance's box
+/// against the view of the Frame block, picks its LOD and appends its attributes to its
+/// LOD's part of the attribute buffer. The second copies the count of every LOD into the
+/// draw commands. With occlusion culling a frame takes two passes: the early one draws the
+/// instances drawn last frame, the late one tests the others against the depth pyramid of
+/// what the early one drew (see HiZBuffer) and draws the ones it doesn't hide. Every
+/// instance is tested against the depth of its own frame, nothing shows up late.
+/// Needs compute shaders, storage buffers and multi draw indirect (GL 4.3)
+class GpuCulling
+{
+public:
+    /// Storage buffer binding points the programs read and write
+    static const GLuint InstanceBinding  = 0; /// Model matrix of every instance
+    static const GLuint StateBinding     = 1; /// LOD and visibility of every instance, kept across frames
+    static const GLuint AttributeBinding = 2; /// InstanceAttributes of the instances in view, LOD after LOD
+    static const GLuint CounterBinding   = 3; /// Counters, zeroed before the first pass of a frame
+    static const GLuint CommandBinding   = 4; /// A DrawCommand per mesh and LOD, mesh after mesh, for each of the two passes
+
+    /// Invocations per work group, local_size_x of the shader
+    static const GLuint GroupSize = 64;
+
+    /// Which instances a dispatch culls
+    enum class Pass : GLint
+    {
+        All = 0,    /// Every instance, without occlusion culling
+        Early,      /// The instances drawn last frame
+        Late        /// The others, against the depth pyramid of what the early pass drew
+    };
+
+    /// Contents of the counter buffer
+    struct Counters
+    {
+        GLuint lodCounts[ModelData::MaxLods];   /// Instances in view of every LOD
+        GLuint earlyCounts[ModelData::MaxLods]; /// Of them, the ones the early pass drew
+        GLuint occluded;                        /// Instances in view the late pass found hidden
+    };
+
+    /// DrawElementsIndirectCommand. Commands draw the instances of their LOD, which
+    /// start at baseInstance = lod * instance count in the attribute buffer. The late
+    /// pass's draw the ones it added after the early pass's
+    struct DrawCommand
+    {
+        GLuint count;
+        GLuint instanceCount; /// Written by the GPU
+        GLuint firstIndex;
+        GLint  baseVertex;
+        GLuint baseInstance;
+    };
+
+    /// Checks if the driver can run the programs. Needs OpenGL 4.3
+    static bool IsSupported();
+
+    /// Builds both programs from the compute shader at given path
+    void Init(const std::string& computePath);
+
+    /// Checks if both programs were built
+    bool IsReady() const;
+
+    /// Culls instanceCount instances of given data and fills the instance counts of
+    /// commandCount commands, the pass's. The buffers have to be bound to their binding
+    /// points, and the late pass needs the pyramid of the early pass's depth. Leaves
+    /// the results visible to vertex attributes, indirect draws and the next pass
+    void Dispatch(
+        const ModelData& data,
+        GLuint instanceCount,
+        GLuint commandCount,
+        Pass pass = Pass::All,
+        const HiZBuffer* hiZ = nullptr) const;
+
+private:
+    Shader mCullShader;
+    Shader mCommandShader;
+
+    // Uniforms of the cull program
+    Uniform<glm::vec3> mBoundsMin;
+    Uniform<glm::vec3> mBoundsMax;
+    Uniform<glm::vec3> mBoundsCenter;
+    Uniform<GLfloat>   mBoundsRadius;
+    Uniform<GLint>     mLodCount;
+    Uniform<GLint>     mInstanceCount;
+    Uniform<GLint>     mCullPass;
+
+    // Uniforms of the command program
+    Uniform<GLint>     mCommandCount;
+    Uniform<GLint>     mCommandInstanceCount;
+    Uniform<GLint>     mCommandPass;
+
+}; //~ GpuCulling
+
+#endif //~ ELESWORD_GPU_CULLING_HPP
\ No newline at end of file
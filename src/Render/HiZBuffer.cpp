@@ -0,0 +1,148 @@
+#include "HiZBuffer.hpp"
+#include <algorithm>
+#include <iostream>
+
+namespace
+{
+    /// Largest power of two not above given size, at least 1
+    GLsizei FloorPowerOfTwo(GLsizei size)
+    {
+        GLsizei power = 1;
+        while(power * 2 <= size)
+            power *= 2;
+        return power;
+    }
+
+    /// Work groups covering given number of texels
+    GLuint GroupCount(GLsizei size)
+    {
+        return ((GLuint)size + HiZBuffer::GroupSize - 1) / HiZBuffer::GroupSize;
+    }
+}
+
+//--------------------------------------------------
+// Static functions
+//--------------------------------------------------
+const GLuint HiZBuffer::TextureUnit;
+const GLuint HiZBuffer::GroupSize;
+
+//--------------------------------------------------
+// Public functions
+//--------------------------------------------------
+HiZBuffer::HiZBuffer()
+    : mDepthTexture(0)
+    , mDepthFbo(0)
+    , mPyramid(0)
+    , mWidth(0)
+    , mHeight(0)
+    , mPyramidWidth(0)
+    , mPyramidHeight(0)
+    , mLevelCount(0)
+{
+}
+
+HiZBuffer::~HiZBuffer()
+{
+    const GLuint textures[] = { mDepthTexture, mPyramid };
+    glDeleteTextures(2, textures);
+    glDeleteFramebuffers(1, &mDepthFbo);
+}
+
+void HiZBuffer::Init(const std::string& computePath)
+{
+    mCopyShader.InitCompute(computePath, { "COPY_DEPTH" });
+    mReduceShader.InitCompute(computePath);
+}
+
+bool HiZBuffer::IsReady() const
+{
+    return mCopyShader.IsReady() && mReduceShader.IsReady();
+}
+
+void HiZBuffer::Build(GLsizei width, GLsizei height)
+{
+    if(width <= 0 || height <= 0)
+        return;
+
+    // Depth can't be sampled from the framebuffer being drawn, copy it and come back
+    GLint target = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target);
+    if(width != mWidth || height != mHeight)
+        Allocate(width, height);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, (GLuint)target);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, mDepthFbo);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)target);
+
+    // Level 0 takes the farthest of the one or two pixels per axis under each texel
+    glActiveTexture(GL_TEXTURE0 + TextureUnit);
+    glBindTexture(GL_TEXTURE_2D, mDepthTexture);
+    mCopyShader.Use();
+    glBindImageTexture(0, mPyramid, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+    glDispatchCompute(GroupCount(mPyramidWidth), GroupCount(mPyramidHeight), 1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // The others the farthest of the 2x2 texels below
+    mReduceShader.Use();
+    GLsizei levelWidth = mPyramidWidth;
+    GLsizei levelHeight = mPyramidHeight;
+    for(GLint level = 1; level < mLevelCount; level++)
+    {
+        levelWidth = std::max(levelWidth / 2, 1);
+        levelHeight = std::max(levelHeight / 2, 1);
+
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        glBindImageTexture(0, mPyramid, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        glBindImageTexture(1, mPyramid, level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+        glDispatchCompute(GroupCount(levelWidth), GroupCount(levelHeight), 1);
+    }
+
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+GLuint HiZBuffer::GetTexture() const
+{
+    return mPyramid;
+}
+
+//--------------------------------------------------
+// Private functions
+//--------------------------------------------------
+void HiZBuffer::Allocate(GLsizei width, GLsizei height)
+{
+    glDeleteTextures(1, &mDepthTexture);
+    glDeleteTextures(1, &mPyramid);
+    if(mDepthFbo == 0)
+        glGenFramebuffers(1, &mDepthFbo);
+
+    // Fetched level 0 texel by texel, it must not need mipmaps to be complete
+    glGenTextures(1, &mDepthTexture);
+    glBindTexture(GL_TEXTURE_2D, mDepthTexture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH24_STENCIL8, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, mDepthFbo);
+    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, mDepthTexture, 0);
+    if(glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::HIZ_BUFFER::DEPTH_FRAMEBUFFER_INCOMPLETE" << std::endl;
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+
+    // Powers of two halve exactly, so every texel of a level covers the same pixels as its 2x2 below
+    mPyramidWidth = FloorPowerOfTwo(width);
+    mPyramidHeight = FloorPowerOfTwo(height);
+    mLevelCount = 1;
+    while((mPyramidWidth >> mLevelCount) > 0 || (mPyramidHeight >> mLevelCount) > 0)
+        mLevelCount++;
+
+    glGenTextures(1, &mPyramid);
+    glBindTexture(GL_TEXTURE_2D, mPyramid);
+    glTexStorage2D(GL_TEXTURE_2D, mLevelCount, GL_R32F, mPyramidWidth, mPyramidHeight);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    mWidth = width;
+    mHeight = height;
+}
\ No newline at end of file
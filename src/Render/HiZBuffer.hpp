@@ -0,0 +1,67 @@
+#ifndef ELESWORD_HIZ_BUFFER_HPP
+#define ELESWORD_HIZ_BUFFER_HPP
+
+#include <string>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include "Shader.hpp"
+
+/// Depth pyramid of what has been drawn so far in the frame, for occlusion culling
+/// (see GpuCulling). Level 0 is the depth buffer shrunk to the powers of two below
+/// the viewport, each level halves the one before, and every texel holds the
+/// farthest depth of the pixels it covers: a box whose closest point is behind
+/// it is hidden wherever the texel reaches. Built by compute programs (GL 4.3)
+class HiZBuffer
+{
+public:
+    /// Texture unit the pyramid is bound to while building and culling
+    static const GLuint TextureUnit = 0;
+
+    /// Invocations per work group along x and y, local_size of the shader
+    static const GLuint GroupSize = 8;
+
+    /// Constructor
+    HiZBuffer();
+
+    /// Destructor
+    ~HiZBuffer();
+
+    HiZBuffer(const HiZBuffer&) = delete;
+    HiZBuffer& operator=(const HiZBuffer&) = delete;
+
+    /// Builds both programs from the compute shader at given path
+    void Init(const std::string& computePath);
+
+    /// Checks if both programs were built
+    bool IsReady() const;
+
+    /// Copies the depth of the framebuffer bound for drawing, given viewport size, and
+    /// reduces it to the pyramid. Its depth format has to be GL_DEPTH24_STENCIL8. Leaves
+    /// the pyramid visible to texture fetches
+    void Build(GLsizei width, GLsizei height);
+
+    /// Retrieves the pyramid texture, GL_R32F with every level. 0 before the first Build
+    GLuint GetTexture() const;
+
+private:
+    Shader mCopyShader;
+    Shader mReduceShader;
+
+    GLuint mDepthTexture;   /// Copy of the depth buffer, viewport sized
+    GLuint mDepthFbo;       /// Draws to mDepthTexture, for the blit
+    GLuint mPyramid;
+
+    GLsizei mWidth;         /// Viewport the textures are sized for
+    GLsizei mHeight;
+    GLsizei mPyramidWidth;  /// Size of level 0
+    GLsizei mPyramidHeight;
+    GLint mLevelCount;
+
+    /// Sizes the textures for a viewport
+    void Allocate(GLsizei width, GLsizei height);
+
+}; //~ HiZBuffer
+
+#endif //~ ELESWORD_HIZ_BUFFER_HPP
\ No newline at end of file
@@ -0,0 +1,192 @@
+#include "RenderQueue.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    //--------------------------------------------------
+    // Sort key
+    //--------------------------------------------------
+    const int PassShift     = 60;
+    const int ProgramShift  = 48;
+    const int MaterialShift = 28;
+    const int VaoShift      = 16;
+
+    const std::uint64_t ProgramMask  = 0xFFF;
+    const std::uint64_t MaterialMask = 0xFFFFF;
+    const std::uint64_t VaoMask      = 0xFFF;
+
+    /// Top 16 bits of the depth. Positive floats order like their bits
+    std::uint64_t DepthBits(float depth)
+    {
+        depth = std::max(depth, 0.0f);
+        std::uint32_t bits;
+        std::memcpy(&bits, &depth, sizeof(bits));
+        return bits >> 16;
+    }
+
+    /// Groups meshes drawn with the same textures. The first texture stands for the material
+    std::uint64_t MaterialBits(const Mesh& mesh)
+    {
+        return mesh.textures.empty() ? 0 : (std::uint64_t)(mesh.textures[0].handle + 1);
+    }
+}
+
+const std::uint32_t RenderQueue::NoTransform;
+
+void RenderQueue::Clear()
+{
+    mCommands.clear();
+    mCounts.clear();
+    mOffsets.clear();
+    mBaseVertices.clear();
+    mTransforms.clear();
+}
+
+std::uint32_t RenderQueue::AddTransform(const glm::mat4& model)
+{
+    mTransforms.push_back(model);
+    return (std::uint32_t)(mTransforms.size() - 1);
+}
+
+void RenderQueue::Submit(
+    Pass pass,
+    const Shader& shader,
+    GLuint vao,
+    const Mesh& mesh,
+    const MeshDraw& draw,
+    std::uint32_t transform,
+    float depth,
+    const DrawMeshCb& drawMesh)
+{
+    if(draw.counts.empty() && draw.indirectCount == 0)
+        return;
+
+    Command command;
+    command.shader         = &shader;
+    command.mesh           = &mesh;
+    command.drawMesh       = &drawMesh;
+    command.vao            = vao;
+    command.transform      = transform;
+    command.firstRange     = (std::uint32_t)mCounts.size();
+    command.rangeCount     = (std::uint32_t)draw.counts.size();
+    command.screenPixels   = draw.screenPixels;
+    command.instanceCount  = draw.instanceCount;
+    command.indirectBuffer = draw.indirectBuffer;
+    command.indirectOffset = draw.indirectOffset;
+    command.indirectCount  = draw.indirectCount;
+    command.depth          = depth;
+    command.pass           = pass;
+    mCommands.push_back(command);
+
+    mCounts.insert(mCounts.end(), draw.counts.begin(), draw.counts.end());
+    mOffsets.insert(mOffsets.end(), draw.offsets.begin(), draw.offsets.end());
+    mBaseVertices.insert(mBaseVertices.end(), draw.baseVertices.begin(), draw.baseVertices.end());
+}
+
+void RenderQueue::Execute()
+{
+    mStats = Stats();
+    mStats.commands = mCommands.size();
+
+    // Sort compact keys, not the commands
+    mOrder.clear();
+    mOrder.reserve(mCommands.size());
+    for(std::uint32_t i = 0; i < (std::uint32_t)mCommands.size(); i++)
+    {
+        const Command& command = mCommands[i];
+        const std::uint64_t key =
+              ((std::uint64_t)command.pass                                   << PassShift)
+            | (((std::uint64_t)command.shader->GetProgID() & ProgramMask)    << ProgramShift)
+            | ((MaterialBits(*command.mesh) & MaterialMask)                  << MaterialShift)
+            | (((std::uint64_t)command.vao & VaoMask)                        << VaoShift)
+            | DepthBits(command.depth);
+        mOrder.push_back({ key, i });
+    }
+    std::sort(mOrder.begin(), mOrder.end());
+
+    // Run them, changing only what differs from the previous command
+    bool first = true;
+    Pass pass = Pass::Opaque;
+    const Shader* shader = nullptr;
+    std::uint32_t transform = 0;
+    GLuint vao = 0;
+    for(const auto& entry : mOrder)
+    {
+        const Command& command = mCommands[entry.second];
+
+        if(first || command.pass != pass)
+        {
+            ApplyPass(command.pass);
+            pass = command.pass;
+            mStats.passChanges++;
+        }
+
+        // The model matrix is program state, a new program needs it again
+        const bool programChanged = first || command.shader != shader;
+        if(programChanged)
+        {
+            command.shader->Use();
+            shader = command.shader;
+            mStats.programChanges++;
+        }
+
+        if(command.transform != NoTransform && (programChanged || command.transform != transform))
+        {
+            command.shader->LoadModel(mTransforms[command.transform]);
+            transform = command.transform;
+            mStats.transformLoads++;
+        }
+
+        if(first || command.vao != vao)
+        {
+            glBindVertexArray(command.vao);
+            vao = command.vao;
+            mStats.vaoChanges++;
+        }
+
+        first = false;
+
+        mDraw.Clear();
+        mDraw.counts.assign(mCounts.begin() + command.firstRange, mCounts.begin() + command.firstRange + command.rangeCount);
+        mDraw.offsets.assign(mOffsets.begin() + command.firstRange, mOffsets.begin() + command.firstRange + command.rangeCount);
+        mDraw.baseVertices.assign(mBaseVertices.begin() + command.firstRange, mBaseVertices.begin() + command.firstRange + command.rangeCount);
+        mDraw.screenPixels = command.screenPixels;
+        mDraw.instanceCount = command.instanceCount;
+        mDraw.indirectBuffer = command.indirectBuffer;
+        mDraw.indirectOffset = command.indirectOffset;
+        mDraw.indirectCount = command.indirectCount;
+        mStats.instances += (std::size_t)command.instanceCount;
+        mStats.indirectDraws += command.indirectCount > 0 ? 1 : 0;
+        (*command.drawMesh)(*command.shader, *command.mesh, mDraw);
+    }
+
+    // Leave the state the way the rest of the frame expects it
+    glBindVertexArray(0);
+    glStencilMask(0xFF);
+    glEnable(GL_DEPTH_TEST);
+}
+
+const RenderQueue::Stats& RenderQueue::GetStats() const
+{
+    return mStats;
+}
+
+void RenderQueue::ApplyPass(Pass pass)
+{
+    switch(pass)
+    {
+        case Pass::Outline:
+            glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
+            glStencilMask(0x00);
+            glDisable(GL_DEPTH_TEST);
+            break;
+
+        case Pass::Opaque:
+        default:
+            glStencilFunc(GL_ALWAYS, 1, 0xFF);
+            glStencilMask(0xFF);
+            glEnable(GL_DEPTH_TEST);
+            break;
+    }
+}
\ No newline at end of file
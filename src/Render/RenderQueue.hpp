@@ -0,0 +1,121 @@
+#ifndef ELESWORD_RENDER_QUEUE_HPP
+#define ELESWORD_RENDER_QUEUE_HPP
+
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include "../Util/WarnGuard.hpp"
+WARN_GUARD_ON
+#include <glm/glm.hpp>
+WARN_GUARD_OFF
+
+#include "Shader.hpp"
+#include "../Model/Mesh.hpp"
+
+/// Draws of a frame, collected first and then executed sorted so state only changes
+/// when it has to. Every command carries a 64 bit key, from the highest bits down:
+///
+///   pass (4) | program (12) | material (20) | VAO (12) | depth (16)
+///
+/// Sorting groups commands by pass, then program, material and VAO, and orders
+/// them front to back inside a group
+class RenderQueue
+{
+public:
+    /// Passes run in this order, each with its own fixed function state
+    enum class Pass : std::uint8_t
+    {
+        Opaque = 0, /// Depth tested, marks the stencil
+        Outline,    /// No depth test, drawn where the stencil isn't marked
+        Count
+    };
+
+    /// Transform of instanced commands, their model matrices come from the VAO
+    static const std::uint32_t NoTransform = 0xFFFFFFFF;
+
+    /// Draws the index ranges of a mesh. Program, model matrix and VAO are bound when it gets called
+    using DrawMeshCb = std::function<void(
+        const Shader& shader,
+        const Mesh& mesh,
+        const MeshDraw& draw)>;
+
+    /// State changes and draws of the last Execute
+    struct Stats
+    {
+        std::size_t commands;
+        std::size_t passChanges;
+        std::size_t programChanges;
+        std::size_t transformLoads;
+        std::size_t vaoChanges;
+        std::size_t instances;      /// Drawn by instanced commands
+        std::size_t indirectDraws;  /// Commands drawn from an indirect buffer, their instances aren't counted
+    };
+
+    /// Empties the queue for a new frame
+    void Clear();
+
+    /// Stores a model matrix for the commands that follow. Returns its index
+    std::uint32_t AddTransform(const glm::mat4& model);
+
+    /// Queues the ranges, or indirect commands, of a mesh. Depth is the distance to the camera, only used
+    /// for ordering. Instanced draws pass NoTransform. Mesh, shader and callback have to stay alive until Execute
+    void Submit(
+        Pass pass,
+        const Shader& shader,
+        GLuint vao,
+        const Mesh& mesh,
+        const MeshDraw& draw,
+        std::uint32_t transform,
+        float depth,
+        const DrawMeshCb& drawMesh);
+
+    /// Sorts the commands and runs them. Leaves no VAO bound, the depth test on and the stencil writable
+    void Execute();
+
+    /// Retrieves the counts of the last Execute
+    const Stats& GetStats() const;
+
+private:
+    /// A queued draw. Its ranges sit in the shared range arrays below
+    struct Command
+    {
+        const Shader*     shader;
+        const Mesh*       mesh;
+        const DrawMeshCb* drawMesh;
+        GLuint            vao;
+        std::uint32_t     transform;
+        std::uint32_t     firstRange;
+        std::uint32_t     rangeCount;
+        float             screenPixels;
+        GLsizei           instanceCount;
+        GLuint            indirectBuffer;
+        GLintptr          indirectOffset;
+        GLsizei           indirectCount;
+        float             depth;
+        Pass              pass;
+    };
+
+    std::vector<Command> mCommands;
+    std::vector<std::pair<std::uint64_t, std::uint32_t>> mOrder; /// Key and command index, sorted by Execute
+
+    // Ranges of every command
+    std::vector<GLsizei> mCounts;
+    std::vector<GLvoid*> mOffsets;
+    std::vector<GLint>   mBaseVertices;
+
+    std::vector<glm::mat4> mTransforms;
+
+    MeshDraw mDraw;     /// Ranges of the command being run, kept to reuse its storage
+    Stats    mStats = {};
+
+    /// Sets the fixed function state of a pass
+    static void ApplyPass(Pass pass);
+
+}; //~ RenderQueue
+
+#endif //~ ELESWORD_RENDER_QUEUE_HPP
\ No newline at end of file
@@ -0,0 +1,25 @@
+#ifndef ELESWORD_RENDER_VIEW_HPP
+#define ELESWORD_RENDER_VIEW_HPP
+
+#include "../Util/WarnGuard.hpp"
+
+WARN_GUARD_ON
+#include <glm/glm.hpp>
+WARN_GUARD_OFF
+
+class FrustumCuller;
+class HiZBuffer;
+
+/// Camera state models need to decide what and how much to draw
+struct RenderView
+{
+    glm::mat4 view;     /// View matrix
+    glm::mat4 proj;     /// Projection matrix
+    glm::vec3 position; /// Camera position in world space
+    float viewportHeight; /// In pixels
+    const FrustumCuller* culler; /// Visibility of the bounds added this frame, null to draw everything
+    const HiZBuffer* hiZ;        /// Depth pyramid of the early draws for GPU occlusion culling, null for none
+
+}; //~ RenderView
+
+#endif //~ ELESWORD_RENDER_VIEW_HPP
\ No newline at end of file
@@ -1,9 +1,56 @@
 #include "Shader.hpp"
+#include "FrameUniforms.hpp"
+#include "ShaderCache.hpp"
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 
-void Shader::Init(const std::string& vertexPath, const std::string& fragmentPath)
+namespace
+{
+    /// Inserts the given defines after the #version line of a GLSL source
+    std::string InjectDefines(const std::string& source, const std::vector<std::string>& defines)
+    {
+        if(defines.empty())
+            return source;
+
+        std::string block;
+        for(const std::string& define : defines)
+            block += "#define " + define + "\n";
+
+        // #version has to stay the first statement
+        std::string::size_type insertAt = 0;
+        if(source.compare(0, 8, "#version") == 0)
+        {
+            insertAt = source.find('\n');
+            insertAt = (insertAt == std::string::npos) ? source.size() : insertAt + 1;
+            if(insertAt == source.size() && source.back() != '\n')
+                block = "\n" + block;
+        }
+
+        return source.substr(0, insertAt) + block + source.substr(insertAt);
+    }
+
+    /// Checks if the driver compiles in the background and can tell when it's done
+    bool HasParallelCompile()
+    {
+        return GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile;
+    }
+}
+
+void Shader::Init(
+    const std::string& vertexPath,
+    const std::string& fragmentPath,
+    const std::vector<std::string>& defines)
+{
+    Submit(vertexPath, fragmentPath, defines);
+    Finish();
+}
+
+void Shader::Submit(
+    const std::string& vertexPath,
+    const std::string& fragmentPath,
+    const std::vector<std::string>& defines)
 {
     // Retrieve the vertex/fragment source code from filePath
     std::string vertexCode;
@@ -26,50 +73,206 @@ void Shader::Init(const std::string& vertexPath, const std::string& fragmentPath
         vShaderFile.close();
         fShaderFile.close();
         // Convert stream into GLchar array
-        vertexCode = vShaderStream.str();
-        fragmentCode = fShaderStream.str();
+        vertexCode = InjectDefines(vShaderStream.str(), defines);
+        fragmentCode = InjectDefines(fShaderStream.str(), defines);
+    }
+    catch(std::ifstream::failure e)
+    {
+        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+    }
+
+    // 2. Reuse the program linked on an earlier run, unless the driver refuses it
+    mReady = false;
+    mBuild = PendingBuild();
+    mBuild.active = true;
+    mBuild.cacheBinary = ShaderCache::IsSupported();
+    mBuild.cacheKey = mBuild.cacheBinary ? ShaderCache::Key(vertexCode, fragmentCode) : 0;
+    mBuild.cachedPath = ShaderCache::CachedPath(vertexPath, fragmentPath, defines);
+
+    mProgramID = glCreateProgram();
+    if(mBuild.cacheBinary && ShaderCache::Load(mBuild.cachedPath, mBuild.cacheKey, mProgramID))
+    {
+        // Finish reads whether the driver took it, the sources rebuild it otherwise
+        mBuild.cacheBinary = false;
+        mBuild.vertexCode = std::move(vertexCode);
+        mBuild.fragmentCode = std::move(fragmentCode);
+        return;
+    }
+
+    // 3. Compile and link from source, keeping the binary for the next run
+    if(mBuild.cacheBinary)
+        glProgramParameteri(mProgramID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+    LinkFromSource(vertexCode, fragmentCode);
+}
+
+void Shader::InitCompute(
+    const std::string& computePath,
+    const std::vector<std::string>& defines)
+{
+    std::string computeCode;
+    std::ifstream cShaderFile;
+    cShaderFile.exceptions(std::ifstream::badbit);
+    try
+    {
+        cShaderFile.open(computePath);
+        std::stringstream cShaderStream;
+        cShaderStream << cShaderFile.rdbuf();
+        cShaderFile.close();
+        computeCode = InjectDefines(cShaderStream.str(), defines);
     }
     catch(std::ifstream::failure e)
     {
         std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
     }
 
+    // Compute programs are few and small, they are built in place without the binary cache
+    mReady = false;
+    mBuild = PendingBuild();
+    mProgramID = glCreateProgram();
+
+    const GLchar* cShaderCode = computeCode.c_str();
+    GLuint compute = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(compute, 1, &cShaderCode, NULL);
+    glCompileShader(compute);
+    glAttachShader(mProgramID, compute);
+    glLinkProgram(mProgramID);
+
+    GLint success;
+    GLchar infoLog[512];
+    glGetShaderiv(compute, GL_COMPILE_STATUS, &success);
+    if(!success)
+    {
+        glGetShaderInfoLog(compute, 512, NULL, infoLog);
+        std::cout << "ERROR::SHADER::COMPUTE::COMPILATION_FAILED" << std::endl << infoLog << std::endl;
+    }
+
+    glGetProgramiv(mProgramID, GL_LINK_STATUS, &success);
+    if(!success)
+    {
+        glGetProgramInfoLog(mProgramID, 512, NULL, infoLog);
+        std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED" << std::endl << infoLog << std::endl;
+    }
+    glDeleteShader(compute);
+
+    if(!success)
+        return;
+
+    GLuint frameBlock = glGetUniformBlockIndex(mProgramID, FrameUniforms::BlockName);
+    if(frameBlock != GL_INVALID_INDEX)
+        glUniformBlockBinding(mProgramID, frameBlock, FrameUniforms::Binding);
+
+    ReflectUniforms();
+    mReady = true;
+}
+
+bool Shader::IsCompiled() const
+{
+    // Loading a binary is a link too, the driver tells when it's done the same way
+    if(!mBuild.active || !HasParallelCompile())
+        return true;
+
+    GLint completed = GL_TRUE;
+    glGetProgramiv(mProgramID, GL_COMPLETION_STATUS_KHR, &completed);
+    return completed == GL_TRUE;
+}
+
+void Shader::Finish()
+{
+    if(!mBuild.active)
+        return;
+
+    // Read the statuses, that's where the driver blocks
+    bool linked;
+    if(mBuild.fromSource)
+        linked = CheckLink();
+    else
+    {
+        GLint success = 0;
+        glGetProgramiv(mProgramID, GL_LINK_STATUS, &success);
+        linked = success != 0;
+
+        // The driver refused the binary it wrote (after an update, say). Build from source and cache it again
+        if(!linked)
+        {
+            std::cout << "WARNING::SHADER:: Program binary " << mBuild.cachedPath << " refused, building from source" << std::endl;
+            mBuild.cacheBinary = true;
+            glProgramParameteri(mProgramID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+            LinkFromSource(mBuild.vertexCode, mBuild.fragmentCode);
+            linked = CheckLink();
+        }
+    }
+
+    if(linked
+    && mBuild.cacheBinary
+    && !ShaderCache::Save(mBuild.cachedPath, mBuild.cacheKey, mProgramID))
+        std::cout << "WARNING::SHADER:: Couldn't cache program binary " << mBuild.cachedPath << std::endl;
+
+    mBuild = PendingBuild();
+
+    // Not usable, stays not ready
+    if(!linked)
+        return;
+
+    // Read the shared frame data from its fixed binding point
+    GLuint frameBlock = glGetUniformBlockIndex(mProgramID, FrameUniforms::BlockName);
+    if(frameBlock != GL_INVALID_INDEX)
+        glUniformBlockBinding(mProgramID, frameBlock, FrameUniforms::Binding);
+
+    // Look the uniforms up once, drawing only uses the locations
+    ReflectUniforms();
+    mModel = GetUniform<glm::mat4>("model");
+    mReady = true;
+}
+
+bool Shader::IsReady() const
+{
+    return mReady;
+}
+
+void Shader::LinkFromSource(const std::string& vertexCode, const std::string& fragmentCode)
+{
     const GLchar* vShaderCode = vertexCode.c_str();
     const GLchar* fShaderCode = fragmentCode.c_str();
 
-    // 2. Compile shaders
-    GLuint vertex, fragment;
+    mBuild.fromSource = true;
+
+    // Vertex Shader
+    mBuild.vertex = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(mBuild.vertex, 1, &vShaderCode, NULL);
+    glCompileShader(mBuild.vertex);
+
+    // Similiar for Fragment Shader
+    mBuild.fragment = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(mBuild.fragment, 1, &fShaderCode, NULL);
+    glCompileShader(mBuild.fragment);
+
+    // Shader Program. Errors are read by CheckLink, asking now would wait for the compile
+    glAttachShader(mProgramID, mBuild.vertex);
+    glAttachShader(mProgramID, mBuild.fragment);
+    glLinkProgram(mProgramID);
+}
+
+bool Shader::CheckLink()
+{
     GLint success;
     GLchar infoLog[512];
 
-    // Vertex Shader
-    vertex = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex, 1, &vShaderCode, NULL);
-    glCompileShader(vertex);
     // Print compile errors if any
-    glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
+    glGetShaderiv(mBuild.vertex, GL_COMPILE_STATUS, &success);
     if(!success)
     {
-        glGetShaderInfoLog(vertex, 512, NULL, infoLog);
+        glGetShaderInfoLog(mBuild.vertex, 512, NULL, infoLog);
         std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED" << std::endl << infoLog << std::endl;
     };
 
-    // Similiar for Fragment Shader
-    fragment = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment, 1, &fShaderCode, NULL);
-    glCompileShader(fragment);
-    glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
+    glGetShaderiv(mBuild.fragment, GL_COMPILE_STATUS, &success);
     if(!success)
     {
-        glGetShaderInfoLog(vertex, 512, NULL, infoLog);
+        glGetShaderInfoLog(mBuild.fragment, 512, NULL, infoLog);
         std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED" << std::endl << infoLog << std::endl;
     }
 
-    // Shader Program
-    mProgramID = glCreateProgram();
-    glAttachShader(mProgramID, vertex);
-    glAttachShader(mProgramID, fragment);
-    glLinkProgram(mProgramID);
     // Print linking errors if any
     glGetProgramiv(mProgramID, GL_LINK_STATUS, &success);
     if(!success)
@@ -79,8 +282,10 @@ void Shader::Init(const std::string& vertexPath, const std::string& fragmentPath
     }
 
     // Delete the shaders as they're linked into our program now and no longer necessery
-    glDeleteShader(vertex);
-    glDeleteShader(fragment);
+    glDeleteShader(mBuild.vertex);
+    glDeleteShader(mBuild.fragment);
+
+    return success != 0;
 }
 
 void Shader::Use() const
@@ -88,18 +293,59 @@ void Shader::Use() const
     glUseProgram(mProgramID);
 }
 
-void Shader::LoadView(const glm::mat4& view) const
+void Shader::LoadModel(const glm::mat4& model) const
 {
-    glUniformMatrix4fv(glGetUniformLocation(GetProgID(), "view"), 1, GL_FALSE, glm::value_ptr(view));
+    mModel.Set(model);
 }
 
-void Shader::LoadProjection(const glm::mat4& proj) const
+GLuint Shader::GetProgID() const
 {
-    glUniformMatrix4fv(glGetUniformLocation(GetProgID(), "projection"), 1, GL_FALSE, glm::value_ptr(proj));
+    return mProgramID;
+}
+
+void Shader::ReflectUniforms()
+{
+    mUniforms.clear();
+
+    GLint count = 0;
+    GLint maxLength = 0;
+    glGetProgramiv(mProgramID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(mProgramID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+    std::vector<GLchar> buffer(std::max(maxLength, 1));
+    for(GLint i = 0; i < count; i++)
+    {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(mProgramID, (GLuint)i, (GLsizei)buffer.size(), &length, &size, &type, buffer.data());
+        const std::string name(buffer.data(), length);
+
+        // Members of uniform blocks have no location
+        const GLint location = glGetUniformLocation(mProgramID, name.c_str());
+        if(location < 0)
+            continue;
+
+        // Arrays of basic types are listed once, as "name[0]". Element 0 also goes by the bare name
+        if(name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+        {
+            const std::string base = name.substr(0, name.size() - 3);
+            mUniforms.push_back({ base, location, type });
+            for(GLint element = 0; element < size; element++)
+            {
+                const std::string elementName = base + "[" + std::to_string(element) + "]";
+                mUniforms.push_back({ elementName, glGetUniformLocation(mProgramID, elementName.c_str()), type });
+            }
+        }
+        else
+            mUniforms.push_back({ name, location, type });
+    }
 
+    std::sort(mUniforms.begin(), mUniforms.end(), [](const UniformInfo& a, const UniformInfo& b) { return a.name < b.name; });
 }
 
-GLuint Shader::GetProgID() const
+const Shader::UniformInfo* Shader::FindUniform(const std::string& name) const
 {
-    return mProgramID;
+    auto it = std::lower_bound(mUniforms.begin(), mUniforms.end(), name, [](const UniformInfo& info, const std::string& n) { return info.name < n; });
+    return (it != mUniforms.end() && it->name == name) ? &*it : nullptr;
 }
\ No newline at end of file
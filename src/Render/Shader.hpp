@@ -1,7 +1,10 @@
 #ifndef ELESWORD_SHADER_HPP
 #define ELESWORD_SHADER_HPP
 
+#include <cstdint>
+#include <iostream>
 #include <string>
+#include <vector>
 
 #define GLEW_STATIC
 #include <GL/glew.h>
@@ -13,25 +16,194 @@ WARN_GUARD_ON
 #include <glm/gtc/type_ptr.hpp>
 WARN_GUARD_OFF
 
+/// A uniform of type T of a shader, resolved once with Shader::GetUniform.
+/// Setting it applies to the program in use
+template <typename T>
+struct Uniform
+{
+    GLint location = -1;    /// -1 if the shader has no such uniform, setting it then does nothing
+
+    /// Checks if the shader has this uniform
+    bool IsValid() const { return location >= 0; }
+
+    /// Sets the uniform of the program in use
+    void Set(const T& value) const;
+
+    /// Checks if a uniform of given GL type can be set as T
+    static bool Matches(GLenum type);
+
+}; //~ Uniform
+
 class Shader
 {
 public:
-    /// Initialize the shader
-    void Init(const std::string& vertexPath, const std::string& fragmentPath);
+    /// Initialize the shader. Every define is injected as "#define <define>" right after the #version line
+    void Init(
+        const std::string& vertexPath,
+        const std::string& fragmentPath,
+        const std::vector<std::string>& defines = std::vector<std::string>());
+
+    /// Starts building the shader like Init, without reading any status back, so the
+    /// driver can go on with it while other shaders get submitted. Call Finish (or let
+    /// a ShaderBatch do it) before using the shader
+    void Submit(
+        const std::string& vertexPath,
+        const std::string& fragmentPath,
+        const std::vector<std::string>& defines = std::vector<std::string>());
+
+    /// Builds a compute program, blocking until it's linked. Defines are injected like
+    /// Init does. The program isn't ready if it failed to build
+    void InitCompute(
+        const std::string& computePath,
+        const std::vector<std::string>& defines = std::vector<std::string>());
+
+    /// Checks if the driver is done building, without blocking. Always true when
+    /// the driver can't tell (no KHR_parallel_shader_compile), Finish blocks then
+    bool IsCompiled() const;
+
+    /// Reads the build results, blocking until the driver is done, and reflects the
+    /// program. Does nothing if there is no build in flight. The shader isn't ready
+    /// if it failed to build
+    void Finish();
+
+    /// Checks if the shader has been built and can be used
+    bool IsReady() const;
 
     /// Use the program
     void Use() const;
 
-    void LoadView(const glm::mat4& view) const;
-    void LoadProjection(const glm::mat4& proj) const;
+    /// View, projection and lights come from the Frame block (see FrameUniforms)
+    void LoadModel(const glm::mat4& model) const;
+
+    /// Retrieves the uniform with given name, like "pointLights[0].position", from
+    /// the table built at link time. Invalid if the program has none of that name
+    /// and type. Resolve uniforms once and keep them, it's a search by name
+    template <typename T>
+    Uniform<T> GetUniform(const std::string& name) const;
 
     /// Retrieves the id of this shader
     GLuint GetProgID() const;
 
 private:
+    /// An active uniform of the program
+    struct UniformInfo
+    {
+        std::string name;       /// Arrays of basic types get an entry per element
+        GLint       location;
+        GLenum      type;
+    };
+
+    /// A build between Submit and Finish
+    struct PendingBuild
+    {
+        bool          active = false;
+        bool          fromSource = false; /// Not loaded from a binary
+        GLuint        vertex = 0;
+        GLuint        fragment = 0;
+        bool          cacheBinary = false; /// Save the binary once linked
+        std::uint64_t cacheKey = 0;
+        std::string   cachedPath;
+        std::string   vertexCode;   /// Sources of a binary load, built if the driver refuses it
+        std::string   fragmentCode;
+    };
+
     /// Program ID
     GLuint mProgramID;
 
+    /// Build in flight, if any
+    PendingBuild mBuild;
+
+    /// Set by Finish
+    bool mReady = false;
+
+    /// Active uniforms, sorted by name
+    std::vector<UniformInfo> mUniforms;
+
+    /// Transform every shader has
+    Uniform<glm::mat4> mModel;
+
+    /// Submits both stages and their link into the program, without reading any status back
+    void LinkFromSource(const std::string& vertexCode, const std::string& fragmentCode);
+
+    /// Reads the compile and link status of a build from source and deletes its stages. Returns false on failure
+    bool CheckLink();
+
+    /// Fills the uniform table from the linked program
+    void ReflectUniforms();
+
+    /// Retrieves the uniform with given name from the table, null if there's none
+    const UniformInfo* FindUniform(const std::string& name) const;
+
 }; //~ Shader
 
+template <typename T>
+Uniform<T> Shader::GetUniform(const std::string& name) const
+{
+    Uniform<T> uniform;
+    const UniformInfo* info = FindUniform(name);
+    if(info == nullptr)
+        return uniform;
+
+    if(!Uniform<T>::Matches(info->type))
+    {
+        std::cout << "WARNING::SHADER:: Uniform " << name << " has another type" << std::endl;
+        return uniform;
+    }
+
+    uniform.location = info->location;
+    return uniform;
+}
+
+//--------------------------------------------------
+// Uniform types
+//--------------------------------------------------
+template <>
+inline void Uniform<GLint>::Set(const GLint& value) const
+{
+    glUniform1i(location, value);
+}
+
+template <>
+inline bool Uniform<GLint>::Matches(GLenum type)
+{
+    // Samplers are set with the texture unit
+    return type == GL_INT || type == GL_BOOL || type == GL_SAMPLER_2D || type == GL_SAMPLER_2D_ARRAY;
+}
+
+template <>
+inline void Uniform<GLfloat>::Set(const GLfloat& value) const
+{
+    glUniform1f(location, value);
+}
+
+template <>
+inline bool Uniform<GLfloat>::Matches(GLenum type)
+{
+    return type == GL_FLOAT;
+}
+
+template <>
+inline void Uniform<glm::vec3>::Set(const glm::vec3& value) const
+{
+    glUniform3fv(location, 1, glm::value_ptr(value));
+}
+
+template <>
+inline bool Uniform<glm::vec3>::Matches(GLenum type)
+{
+    return type == GL_FLOAT_VEC3;
+}
+
+template <>
+inline void Uniform<glm::mat4>::Set(const glm::mat4& value) const
+{
+    glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+template <>
+inline bool Uniform<glm::mat4>::Matches(GLenum type)
+{
+    return type == GL_FLOAT_MAT4;
+}
+
 #endif //~ ELESWORD_SHADER_HPP
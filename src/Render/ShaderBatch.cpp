@@ -0,0 +1,44 @@
+#include "ShaderBatch.hpp"
+#include <algorithm>
+
+ShaderBatch::ShaderBatch()
+{
+    // 0xFFFFFFFF leaves the thread count to the implementation
+    if(GLEW_KHR_parallel_shader_compile)
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+    else if(GLEW_ARB_parallel_shader_compile)
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+}
+
+void ShaderBatch::Add(
+    Shader& shader,
+    const std::string& vertexPath,
+    const std::string& fragmentPath,
+    const std::vector<std::string>& defines)
+{
+    shader.Submit(vertexPath, fragmentPath, defines);
+    mPending.push_back(&shader);
+}
+
+bool ShaderBatch::Poll()
+{
+    auto done = std::remove_if(mPending.begin(), mPending.end(), [](Shader* shader)
+    {
+        if(!shader->IsCompiled())
+            return false;
+
+        shader->Finish();
+        return true;
+    });
+    mPending.erase(done, mPending.end());
+
+    return mPending.empty();
+}
+
+void ShaderBatch::Wait()
+{
+    for(Shader* shader : mPending)
+        shader->Finish();
+
+    mPending.clear();
+}
\ No newline at end of file
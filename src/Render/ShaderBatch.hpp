@@ -0,0 +1,39 @@
+#ifndef ELESWORD_SHADER_BATCH_HPP
+#define ELESWORD_SHADER_BATCH_HPP
+
+#include <string>
+#include <vector>
+
+#include "Shader.hpp"
+
+/// Builds shaders together. Every shader is submitted before any status is read,
+/// so with KHR_parallel_shader_compile the driver compiles them side by side on
+/// its own threads. Shaders are usable once IsReady says so.
+/// Must be used from the GL thread, shaders must outlive the batch
+class ShaderBatch
+{
+public:
+    /// Lets the driver use as many compiler threads as it likes
+    ShaderBatch();
+
+    /// Submits a shader (see Shader::Submit)
+    void Add(
+        Shader& shader,
+        const std::string& vertexPath,
+        const std::string& fragmentPath,
+        const std::vector<std::string>& defines = std::vector<std::string>());
+
+    /// Finishes the shaders the driver is done with, without blocking.
+    /// Returns true once every shader is ready
+    bool Poll();
+
+    /// Finishes every shader, blocking until the driver is done with them
+    void Wait();
+
+private:
+    /// Submitted shaders not finished yet
+    std::vector<Shader*> mPending;
+
+}; //~ ShaderBatch
+
+#endif //~ ELESWORD_SHADER_BATCH_HPP
\ No newline at end of file
@@ -0,0 +1,138 @@
+#include "ShaderCache.hpp"
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include "../Util/Hash.hpp"
+#include "../Util/MappedFile.hpp"
+
+namespace
+{
+    //--------------------------------------------------
+    // File layout
+    //--------------------------------------------------
+    // Header | Program binary
+
+    const char Magic[4] = { 'E', 'P', 'R', 'G' };
+
+    struct Header
+    {
+        char          magic[4];
+        std::uint32_t version;
+        std::uint64_t key;
+        std::uint32_t binaryFormat;
+        std::uint32_t binaryBytes;
+    };
+
+    /// Retrieves a driver string, empty if there's none
+    std::string DriverString(GLenum name)
+    {
+        const GLubyte* str = glGetString(name);
+        return str ? std::string(reinterpret_cast<const char*>(str)) : std::string();
+    }
+}
+
+//--------------------------------------------------
+// ShaderCache
+//--------------------------------------------------
+namespace ShaderCache
+{
+    bool IsSupported()
+    {
+        // Core since 4.1, an extension before
+        if(!GLEW_VERSION_4_1 && !GLEW_ARB_get_program_binary)
+            return false;
+
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        return formats > 0;
+    }
+
+    std::string CachedPath(
+        const std::string& vertexPath,
+        const std::string& fragmentPath,
+        const std::vector<std::string>& defines)
+    {
+        // Same vertex shader, other fragment shader or defines: other file
+        std::uint64_t hash = Hash::Fnv1a(fragmentPath);
+        for(const std::string& define : defines)
+            hash = Hash::Fnv1a(define + "\n", hash);
+
+        std::ostringstream path;
+        path << vertexPath << "." << std::hex << std::setw(16) << std::setfill('0') << hash << ".glbin";
+        return path.str();
+    }
+
+    std::uint64_t Key(const std::string& vertexCode, const std::string& fragmentCode)
+    {
+        // Lengths go in too, so moving text from one stage to the other changes the key
+        const std::uint64_t lengths[2] = { vertexCode.size(), fragmentCode.size() };
+        std::uint64_t key = Hash::Fnv1a(lengths, sizeof(lengths));
+        key = Hash::Fnv1a(vertexCode, key);
+        key = Hash::Fnv1a(fragmentCode, key);
+        key = Hash::Fnv1a(DriverString(GL_VENDOR), key);
+        key = Hash::Fnv1a(DriverString(GL_RENDERER), key);
+        key = Hash::Fnv1a(DriverString(GL_VERSION), key);
+        return key;
+    }
+
+    bool Save(const std::string& cachedPath, std::uint64_t key, GLuint program)
+    {
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if(length <= 0)
+            return false;
+
+        std::vector<char> binary((std::size_t)length);
+        GLsizei written = 0;
+        GLenum format = 0;
+        glGetProgramBinary(program, length, &written, &format, binary.data());
+        if(written <= 0)
+            return false;
+
+        Header header = {};
+        std::memcpy(header.magic, Magic, sizeof(Magic));
+        header.version      = Version;
+        header.key          = key;
+        header.binaryFormat = format;
+        header.binaryBytes  = (std::uint32_t)written;
+
+        std::ofstream out(cachedPath, std::ios::binary | std::ios::trunc);
+        if(!out)
+            return false;
+
+        out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        out.write(binary.data(), written);
+
+        return (bool)out;
+    }
+
+    bool Load(const std::string& cachedPath, std::uint64_t key, GLuint program)
+    {
+        MappedFile file;
+        if(!file.Open(cachedPath) || file.Size() < sizeof(Header))
+            return false;
+
+        Header header;
+        std::memcpy(&header, file.Data(), sizeof(Header));
+
+        // Validate
+        if(std::memcmp(header.magic, Magic, sizeof(Magic)) != 0
+        || header.version != Version
+        || header.key     != key)
+            return false;
+
+        if(sizeof(Header) + header.binaryBytes != file.Size())
+        {
+            std::cout << "WARNING::SHADER_CACHE:: Truncated program binary " << cachedPath << std::endl;
+            return false;
+        }
+
+        // The link status isn't read here, so the driver can load it in the background
+        glProgramBinary(program, header.binaryFormat, file.Data() + sizeof(Header), (GLsizei)header.binaryBytes);
+        return true;
+    }
+
+} //~ namespace ShaderCache
\ No newline at end of file
@@ -0,0 +1,44 @@
+#ifndef ELESWORD_SHADER_CACHE_HPP
+#define ELESWORD_SHADER_CACHE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+/// Cache of linked program binaries.
+/// A cached program sits next to its vertex shader, one file per fragment shader
+/// and define set. It is keyed by a hash of both final sources and the driver
+/// strings, and rejected when they or the version change. The driver may still
+/// refuse a binary it wrote (after an update, say), so callers compile from
+/// source whenever Load fails or the program doesn't link.
+namespace ShaderCache
+{
+    /// Bump whenever the file layout changes
+    const std::uint32_t Version = 1;
+
+    /// Checks if the driver can hand out program binaries. Needs a current context
+    bool IsSupported();
+
+    /// Retrieves the path of the cached program for given sources and defines
+    std::string CachedPath(
+        const std::string& vertexPath,
+        const std::string& fragmentPath,
+        const std::vector<std::string>& defines);
+
+    /// Hashes the final sources (defines injected) with the vendor, renderer and version strings
+    std::uint64_t Key(const std::string& vertexCode, const std::string& fragmentCode);
+
+    /// Writes the binary of given linked program. Returns false on failure
+    bool Save(const std::string& cachedPath, std::uint64_t key, GLuint program);
+
+    /// Hands a cached binary to given program without waiting for the driver.
+    /// Returns false if it is missing or stale. Read GL_LINK_STATUS before using
+    /// the program, it is left unlinked if the driver refuses the binary
+    bool Load(const std::string& cachedPath, std::uint64_t key, GLuint program);
+
+} //~ namespace ShaderCache
+
+#endif //~ ELESWORD_SHADER_CACHE_HPP
\ No newline at end of file
@@ -0,0 +1,87 @@
+#include "ShaderVariants.hpp"
+
+#include "FrameUniforms.hpp"
+
+namespace
+{
+    /// Lights past the block's would be read outside it
+    unsigned int ClampPointLights(unsigned int pointLights)
+    {
+        return (pointLights < FrameUniforms::MaxPointLights) ? pointLights : (unsigned int)FrameUniforms::MaxPointLights;
+    }
+}
+
+//--------------------------------------------------
+// ShaderFeatures
+//--------------------------------------------------
+std::uint32_t ShaderFeatures::GetKey() const
+{
+    return (std::uint32_t)ClampPointLights(pointLights)
+         | ((specularMap ? 1u : 0u) << 8)
+         | ((alphaTest   ? 1u : 0u) << 9)
+         | ((instanced   ? 1u : 0u) << 10);
+}
+
+std::vector<std::string> ShaderFeatures::GetDefines() const
+{
+    std::vector<std::string> defines;
+    defines.push_back("NR_POINT_LIGHTS " + std::to_string(ClampPointLights(pointLights)));
+    if(specularMap)
+        defines.push_back("HAS_SPECULAR_MAP");
+    if(alphaTest)
+        defines.push_back("ALPHA_TEST");
+    if(instanced)
+        defines.push_back("INSTANCED");
+    return defines;
+}
+
+//--------------------------------------------------
+// ShaderVariants
+//--------------------------------------------------
+void ShaderVariants::Init(
+    const std::string& vertexPath,
+    const std::string& fragmentPath,
+    const std::vector<std::string>& defines)
+{
+    mVertexPath = vertexPath;
+    mFragmentPath = fragmentPath;
+    mDefines = defines;
+    mVariants.clear();
+}
+
+void ShaderVariants::Prepare(const ShaderFeatures& features, ShaderBatch& batch)
+{
+    std::unique_ptr<Shader>& variant = mVariants[features.GetKey()];
+    if(variant)
+        return;
+
+    variant = std::make_unique<Shader>();
+    batch.Add(*variant, mVertexPath, mFragmentPath, GetDefines(features));
+}
+
+const Shader& ShaderVariants::Get(const ShaderFeatures& features)
+{
+    std::unique_ptr<Shader>& variant = mVariants[features.GetKey()];
+    if(!variant)
+    {
+        variant = std::make_unique<Shader>();
+        variant->Init(mVertexPath, mFragmentPath, GetDefines(features));
+    }
+    else if(!variant->IsReady())
+        variant->Finish();
+
+    return *variant;
+}
+
+std::size_t ShaderVariants::GetVariantCount() const
+{
+    return mVariants.size();
+}
+
+std::vector<std::string> ShaderVariants::GetDefines(const ShaderFeatures& features) const
+{
+    std::vector<std::string> defines = mDefines;
+    const std::vector<std::string> featureDefines = features.GetDefines();
+    defines.insert(defines.end(), featureDefines.begin(), featureDefines.end());
+    return defines;
+}
\ No newline at end of file
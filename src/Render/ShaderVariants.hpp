@@ -0,0 +1,66 @@
+#ifndef ELESWORD_SHADER_VARIANTS_HPP
+#define ELESWORD_SHADER_VARIANTS_HPP
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Shader.hpp"
+#include "ShaderBatch.hpp"
+
+/// What a shader variant is specialized for. Each feature becomes a define:
+/// NR_POINT_LIGHTS <n>, HAS_SPECULAR_MAP, ALPHA_TEST and INSTANCED
+struct ShaderFeatures
+{
+    unsigned int pointLights = 0;     /// Lights shaded, clamped to FrameUniforms::MaxPointLights
+    bool         specularMap = false; /// Samples material.texture_specular1
+    bool         alphaTest   = false; /// Discards where the diffuse alpha is under 0.1
+    bool         instanced   = false; /// Reads the model matrix from instance attributes (see ModelInstanceSet)
+
+    /// Packs the features in a key, unique per variant
+    std::uint32_t GetKey() const;
+
+    /// Retrieves the defines selecting these features
+    std::vector<std::string> GetDefines() const;
+
+}; //~ ShaderFeatures
+
+/// Variants of one vertex/fragment shader pair, built from the same sources with
+/// the defines of their features. Every variant is built once and kept.
+/// Must be used from the GL thread
+class ShaderVariants
+{
+public:
+    /// Sets the sources of the variants. Given defines go to every variant, before the feature ones
+    void Init(
+        const std::string& vertexPath,
+        const std::string& fragmentPath,
+        const std::vector<std::string>& defines = std::vector<std::string>());
+
+    /// Submits the variant with given features to a batch, unless it's already known.
+    /// Use it for the variants you expect, Get won't have to wait for the compile then
+    void Prepare(const ShaderFeatures& features, ShaderBatch& batch);
+
+    /// Retrieves the variant with given features. Builds it on the spot if it
+    /// wasn't prepared, and waits for it if it's still compiling
+    const Shader& Get(const ShaderFeatures& features);
+
+    /// Retrieves the number of variants built or being built
+    std::size_t GetVariantCount() const;
+
+private:
+    std::string mVertexPath;
+    std::string mFragmentPath;
+    std::vector<std::string> mDefines;
+
+    /// Variants by feature key. Pointers, a batch may hold on to them
+    std::map<std::uint32_t, std::unique_ptr<Shader>> mVariants;
+
+    /// Retrieves the defines of a variant
+    std::vector<std::string> GetDefines(const ShaderFeatures& features) const;
+
+}; //~ ShaderVariants
+
+#endif //~ ELESWORD_SHADER_VARIANTS_HPP
\ No newline at end of file
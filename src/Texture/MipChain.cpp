@@ -0,0 +1,299 @@
+#include "MipChain.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// SSE2 is always there on x64. AVX is used when the compiler targets it (/arch:AVX, -mavx)
+#if defined(__AVX__)
+#define ELESWORD_MIP_AVX
+#define ELESWORD_MIP_SSE2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ELESWORD_MIP_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    /// Conversions between sRGB encoded bytes and linear values
+    struct SrgbTables
+    {
+        static const int EncodeSize = 1 << 16;
+
+        float         decode[256];          /// Linear value of every byte
+        float         unorm[256];           /// Value of every byte taken as is
+        unsigned char encode[EncodeSize];   /// Byte of every linear value, scaled to the table size
+
+        SrgbTables()
+        {
+            for(int i = 0; i < 256; i++)
+            {
+                const float c = i / 255.0f;
+                decode[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+                unorm[i] = c;
+            }
+            for(int i = 0; i < EncodeSize; i++)
+            {
+                const float l = (float)i / (EncodeSize - 1);
+                const float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+                encode[i] = (unsigned char)(c * 255.0f + 0.5f);
+            }
+        }
+    };
+
+    const SrgbTables& GetSrgbTables()
+    {
+        static const SrgbTables tables;
+        return tables;
+    }
+
+    /// Writes the average of four RGBA float pixels to out
+    inline void Average(const float* a, const float* b, const float* c, const float* d, float* out)
+    {
+#if defined(ELESWORD_MIP_SSE2)
+        const __m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(a), _mm_loadu_ps(b)), _mm_add_ps(_mm_loadu_ps(c), _mm_loadu_ps(d)));
+        _mm_storeu_ps(out, _mm_mul_ps(sum, _mm_set1_ps(0.25f)));
+#else
+        for(int i = 0; i < 4; i++)
+            out[i] = ((a[i] + b[i]) + (c[i] + d[i])) * 0.25f;
+#endif
+    }
+
+    /// Halves an RGBA float level. Odd sizes clamp the last row and column
+    void Downsample(
+        const float* src,
+        int srcWidth,
+        int srcHeight,
+        float* dst,
+        int dstWidth,
+        int dstHeight)
+    {
+        for(int y = 0; y < dstHeight; y++)
+        {
+            const float* row0 = src + 4 * std::min(2 * y, srcHeight - 1) * srcWidth;
+            const float* row1 = src + 4 * std::min(2 * y + 1, srcHeight - 1) * srcWidth;
+            float* out = dst + 4 * y * dstWidth;
+
+            int x = 0;
+#if defined(ELESWORD_MIP_AVX)
+            // Two pixels out of four columns at a time, as long as none is clamped.
+            // Sums pairs of each row first, in the same order as Average
+            for(; 2 * x + 3 < srcWidth; x += 2)
+            {
+                const __m256 top0 = _mm256_loadu_ps(row0 + 8 * x);
+                const __m256 top1 = _mm256_loadu_ps(row0 + 8 * x + 8);
+                const __m256 bottom0 = _mm256_loadu_ps(row1 + 8 * x);
+                const __m256 bottom1 = _mm256_loadu_ps(row1 + 8 * x + 8);
+                const __m256 top = _mm256_add_ps(_mm256_permute2f128_ps(top0, top1, 0x20), _mm256_permute2f128_ps(top0, top1, 0x31));
+                const __m256 bottom = _mm256_add_ps(_mm256_permute2f128_ps(bottom0, bottom1, 0x20), _mm256_permute2f128_ps(bottom0, bottom1, 0x31));
+                _mm256_storeu_ps(out + 4 * x, _mm256_mul_ps(_mm256_add_ps(top, bottom), _mm256_set1_ps(0.25f)));
+            }
+#endif
+            for(; x < dstWidth; x++)
+            {
+                const int x0 = std::min(2 * x, srcWidth - 1);
+                const int x1 = std::min(2 * x + 1, srcWidth - 1);
+                Average(row0 + 4 * x0, row0 + 4 * x1, row1 + 4 * x0, row1 + 4 * x1, out + 4 * x);
+            }
+        }
+    }
+
+#if defined(ELESWORD_MIP_SSE2)
+    /// Loads an RGBA8 pixel as floats, colors decoded with given table and alpha as is
+    inline __m128 Load(const unsigned char* pixel, const float* colors, const float* unorm)
+    {
+        return _mm_set_ps(unorm[pixel[3]], colors[pixel[2]], colors[pixel[1]], colors[pixel[0]]);
+    }
+#endif
+
+    /// Halves an RGBA8 level into an RGBA float one, in linear space
+    void DownsampleEncoded(
+        const unsigned char* src,
+        int srcWidth,
+        int srcHeight,
+        bool gammaCorrect,
+        float* dst,
+        int dstWidth,
+        int dstHeight)
+    {
+        const float* colors = gammaCorrect ? GetSrgbTables().decode : GetSrgbTables().unorm;
+        const float* unorm = GetSrgbTables().unorm;
+
+        for(int y = 0; y < dstHeight; y++)
+        {
+            const unsigned char* row0 = src + 4 * std::min(2 * y, srcHeight - 1) * srcWidth;
+            const unsigned char* row1 = src + 4 * std::min(2 * y + 1, srcHeight - 1) * srcWidth;
+
+            for(int x = 0; x < dstWidth; x++)
+            {
+                const unsigned char* a = row0 + 4 * std::min(2 * x, srcWidth - 1);
+                const unsigned char* b = row0 + 4 * std::min(2 * x + 1, srcWidth - 1);
+                const unsigned char* c = row1 + 4 * std::min(2 * x, srcWidth - 1);
+                const unsigned char* d = row1 + 4 * std::min(2 * x + 1, srcWidth - 1);
+                float* out = dst + 4 * (y * dstWidth + x);
+#if defined(ELESWORD_MIP_SSE2)
+                const __m128 sum = _mm_add_ps(
+                    _mm_add_ps(Load(a, colors, unorm), Load(b, colors, unorm)),
+                    _mm_add_ps(Load(c, colors, unorm), Load(d, colors, unorm)));
+                _mm_storeu_ps(out, _mm_mul_ps(sum, _mm_set1_ps(0.25f)));
+#else
+                for(int i = 0; i < 4; i++)
+                {
+                    const float* table = i < 3 ? colors : unorm;
+                    out[i] = ((table[a[i]] + table[b[i]]) + (table[c[i]] + table[d[i]])) * 0.25f;
+                }
+#endif
+            }
+        }
+    }
+
+    /// Encodes an RGBA float level to RGBA8, with its alpha scaled by alphaScale
+    void Encode(const float* src, std::size_t count, bool gammaCorrect, float alphaScale, unsigned char* dst)
+    {
+        // Colors become indices in the encoding table, or bytes right away
+        const unsigned char* encode = GetSrgbTables().encode;
+        const float colorScale = gammaCorrect ? (float)(SrgbTables::EncodeSize - 1) : 255.0f;
+
+#if defined(ELESWORD_MIP_SSE2)
+        const __m128 scale = _mm_set_ps(255.0f * alphaScale, colorScale, colorScale, colorScale);
+        const __m128 limit = _mm_set_ps(255.0f, colorScale, colorScale, colorScale);
+        const __m128 half = _mm_set1_ps(0.5f);
+        const __m128 zero = _mm_setzero_ps();
+#endif
+        for(std::size_t i = 0; i < 4 * count; i += 4)
+        {
+            int scaled[4];
+#if defined(ELESWORD_MIP_SSE2)
+            const __m128 value = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i), scale), zero), limit);
+            _mm_storeu_si128((__m128i*)scaled, _mm_cvttps_epi32(_mm_add_ps(value, half)));
+#else
+            for(int c = 0; c < 3; c++)
+                scaled[c] = (int)(std::min(std::max(src[i + c] * colorScale, 0.0f), colorScale) + 0.5f);
+            scaled[3] = (int)(std::min(std::max(src[i + 3] * alphaScale * 255.0f, 0.0f), 255.0f) + 0.5f);
+#endif
+            for(int c = 0; c < 3; c++)
+                dst[i + c] = gammaCorrect ? encode[scaled[c]] : (unsigned char)scaled[c];
+            dst[i + 3] = (unsigned char)scaled[3];
+        }
+    }
+
+    /// Retrieves the fraction of the pixels of an RGBA float level that pass
+    /// the alpha test against given reference once their alpha is scaled
+    float Coverage(const float* rgba, std::size_t count, float alphaScale, float alphaReference)
+    {
+        std::size_t covered = 0;
+        for(std::size_t i = 0; i < count; i++)
+        {
+            // Tested as it will be encoded
+            const unsigned char alpha = (unsigned char)(std::min(rgba[4 * i + 3] * alphaScale, 1.0f) * 255.0f + 0.5f);
+            if(alpha >= alphaReference * 255.0f)
+                covered++;
+        }
+        return (float)covered / count;
+    }
+
+    /// Retrieves the alpha scale that gives an RGBA float level given coverage
+    float CoverageScale(const float* rgba, std::size_t count, float coverage, float alphaReference)
+    {
+        // Coverage only grows with the scale. Search for the smallest scale that reaches it
+        float low = 0.0f;
+        float high = 1.0f / alphaReference;
+        for(int i = 0; i < 16; i++)
+        {
+            const float scale = (low + high) * 0.5f;
+            if(Coverage(rgba, count, scale, alphaReference) < coverage)
+                low = scale;
+            else
+                high = scale;
+        }
+        return high;
+    }
+}
+
+//--------------------------------------------------
+// MipChain
+//--------------------------------------------------
+namespace MipChain
+{
+    unsigned int LevelCount(int width, int height)
+    {
+        unsigned int levels = 1;
+        while(width > 1 || height > 1)
+        {
+            width = std::max(1, width / 2);
+            height = std::max(1, height / 2);
+            levels++;
+        }
+        return levels;
+    }
+
+    std::vector<MipLevel> Build(
+        const unsigned char* rgba,
+        int width,
+        int height,
+        std::vector<unsigned char>& pixels,
+        bool gammaCorrect /*= true*/,
+        float alphaReference /*= 0.0f*/)
+    {
+        std::vector<MipLevel> levels(LevelCount(width, height));
+
+        // Lay the levels out first so the storage is only grown once
+        std::size_t offset = pixels.size();
+        for(std::size_t i = 0; i < levels.size(); i++)
+        {
+            levels[i].width = width;
+            levels[i].height = height;
+            levels[i].offset = offset;
+            levels[i].size = (std::size_t)width * height * 4;
+            offset += levels[i].size;
+
+            width = std::max(1, width / 2);
+            height = std::max(1, height / 2);
+        }
+        pixels.resize(offset);
+
+        std::memcpy(pixels.data() + levels[0].offset, rgba, levels[0].size);
+        if(levels.size() == 1)
+            return levels;
+
+        // Cutout textures keep the share of pixels that pass the alpha test at every level
+        float coverage = 0.0f;
+        if(alphaReference > 0.0f)
+        {
+            std::size_t covered = 0;
+            for(std::size_t i = 0; i < levels[0].size; i += 4)
+            {
+                if(rgba[i + 3] >= alphaReference * 255.0f)
+                    covered++;
+            }
+            coverage = (float)covered / (levels[0].width * levels[0].height);
+        }
+
+        // Filtered in linear space from float levels, only the encoded ones are kept.
+        // The first one comes straight from the image, the others from the one before
+        std::vector<float> source((std::size_t)levels[1].width * levels[1].height * 4);
+        std::vector<float> destination(levels.size() > 2 ? (std::size_t)levels[2].width * levels[2].height * 4 : 0);
+        DownsampleEncoded(rgba, levels[0].width, levels[0].height, gammaCorrect, source.data(), levels[1].width, levels[1].height);
+
+        for(std::size_t i = 1; i < levels.size(); i++)
+        {
+            const MipLevel& level = levels[i];
+            const std::size_t count = (std::size_t)level.width * level.height;
+
+            if(i > 1)
+            {
+                const MipLevel& previous = levels[i - 1];
+                Downsample(source.data(), previous.width, previous.height, destination.data(), level.width, level.height);
+                source.swap(destination);
+            }
+
+            const float alphaScale = alphaReference > 0.0f
+                ? CoverageScale(source.data(), count, coverage, alphaReference)
+                : 1.0f;
+            Encode(source.data(), count, gammaCorrect, alphaScale, pixels.data() + level.offset);
+        }
+
+        return levels;
+    }
+
+} //~ namespace MipChain
\ No newline at end of file
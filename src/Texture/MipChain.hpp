@@ -0,0 +1,39 @@
+#ifndef ELESWORD_MIP_CHAIN_HPP
+#define ELESWORD_MIP_CHAIN_HPP
+
+#include <cstddef>
+#include <vector>
+
+/// A level of a mip chain stored back to back with the others
+struct MipLevel
+{
+    int         width;
+    int         height;
+    std::size_t offset;   /// Byte offset of the level in the chain's storage
+    std::size_t size;     /// Size of the level in bytes
+
+}; //~ MipLevel
+
+/// CPU generation of texture mip chains, filtered in linear space.
+/// The filter runs on SSE2, or on AVX when the compiler targets it
+namespace MipChain
+{
+    /// Retrieves the number of levels of a full chain for given size, down to 1x1
+    unsigned int LevelCount(int width, int height);
+
+    /// Builds the full chain of an RGBA8 image, level 0 included, with a box filter.
+    /// The levels are appended to pixels. Returns their layout.
+    /// Colors are taken as sRGB if gammaCorrect is set, as linear data otherwise.
+    /// With an alphaReference, alpha is scaled so every level keeps the share of
+    /// pixels whose alpha reaches it, for alpha tested textures
+    std::vector<MipLevel> Build(
+        const unsigned char* rgba,
+        int width,
+        int height,
+        std::vector<unsigned char>& pixels,
+        bool gammaCorrect = true,
+        float alphaReference = 0.0f);
+
+} //~ namespace MipChain
+
+#endif //~ ELESWORD_MIP_CHAIN_HPP
\ No newline at end of file
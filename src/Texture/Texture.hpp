@@ -2,6 +2,7 @@
 #define TEXTURE_HPP
 
 #include <array>
+#include <string>
 
 #define GLEW_STATIC
 #include <GL/glew.h>
@@ -20,8 +21,9 @@ const std::array<std::string, sizeof(TextureType)> TextureTypeNames = {{
 
 struct Texture
 {
-    GLuint      id;
+    GLint       handle; /// TextureStore handle, resolved to an array layer when drawing
     TextureType type;
+    std::string path;
 }; //~ Texture
 
 #endif //~ TEXTURE_HPP
\ No newline at end of file
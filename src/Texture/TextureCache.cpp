@@ -0,0 +1,193 @@
+#include "TextureCache.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "../Util/Hash.hpp"
+#include "../Util/MappedFile.hpp"
+
+namespace
+{
+    //--------------------------------------------------
+    // File layout
+    //--------------------------------------------------
+    // "DDS " | Header | Level 0 blocks | Level 1 blocks | ... | 1x1 level blocks
+
+    const char Magic[4] = { 'D', 'D', 'S', ' ' };
+
+    /// Tag of the files written by this cache, in the first reserved word
+    const std::uint32_t CacheTag = 0x57534C45; // "ELSW"
+
+    const std::uint32_t FlagCaps        = 0x1;
+    const std::uint32_t FlagHeight      = 0x2;
+    const std::uint32_t FlagWidth       = 0x4;
+    const std::uint32_t FlagPixelFormat = 0x1000;
+    const std::uint32_t FlagMipmapCount = 0x20000;
+    const std::uint32_t FlagLinearSize  = 0x80000;
+    const std::uint32_t PixelFourCC     = 0x4;
+    const std::uint32_t CapsComplex     = 0x8;
+    const std::uint32_t CapsTexture     = 0x1000;
+    const std::uint32_t CapsMipmap      = 0x400000;
+
+    struct PixelFormat
+    {
+        std::uint32_t size;
+        std::uint32_t flags;
+        std::uint32_t fourCC;
+        std::uint32_t rgbBitCount;
+        std::uint32_t masks[4];
+    };
+
+    struct Header
+    {
+        std::uint32_t size;
+        std::uint32_t flags;
+        std::uint32_t height;
+        std::uint32_t width;
+        std::uint32_t linearSize;
+        std::uint32_t depth;
+        std::uint32_t mipmapCount;
+        std::uint32_t reserved[11];  /// Cache tag | Version | Source hash low | Source hash high
+        PixelFormat   pixelFormat;
+        std::uint32_t caps[4];
+        std::uint32_t reserved2;
+    };
+    static_assert(sizeof(Header) == 124, "DDS header must be 124 bytes");
+
+    std::uint32_t MakeFourCC(char a, char b, char c, char d)
+    {
+        return (std::uint32_t)(unsigned char)a
+             | ((std::uint32_t)(unsigned char)b << 8)
+             | ((std::uint32_t)(unsigned char)c << 16)
+             | ((std::uint32_t)(unsigned char)d << 24);
+    }
+
+    std::uint32_t FourCC(TextureCompressor::BlockFormat format)
+    {
+        switch(format)
+        {
+            case TextureCompressor::BlockFormat::BC3:
+                return MakeFourCC('D', 'X', 'T', '5');
+
+            case TextureCompressor::BlockFormat::BC5:
+                return MakeFourCC('A', 'T', 'I', '2');
+
+            case TextureCompressor::BlockFormat::BC1:
+            default:
+                return MakeFourCC('D', 'X', 'T', '1');
+        }
+    }
+}
+
+//--------------------------------------------------
+// TextureCache
+//--------------------------------------------------
+namespace TextureCache
+{
+    std::string CookedPath(const std::string& sourcePath)
+    {
+        return sourcePath + ".dds";
+    }
+
+    std::uint64_t HashSource(const std::string& sourcePath)
+    {
+        MappedFile source;
+        if(!source.Open(sourcePath))
+            return 0;
+
+        return Hash::Fnv1a(source.Data(), source.Size());
+    }
+
+    bool Save(
+        const std::string& cookedPath,
+        std::uint64_t sourceHash,
+        const CookedTexture& texture)
+    {
+        if(texture.levels.empty())
+            return false;
+
+        Header header = {};
+        header.size        = sizeof(Header);
+        header.flags       = FlagCaps | FlagHeight | FlagWidth | FlagPixelFormat | FlagMipmapCount | FlagLinearSize;
+        header.height      = (std::uint32_t)texture.levels[0].height;
+        header.width       = (std::uint32_t)texture.levels[0].width;
+        header.linearSize  = (std::uint32_t)texture.levels[0].size;
+        header.mipmapCount = (std::uint32_t)texture.levels.size();
+        header.reserved[0] = CacheTag;
+        header.reserved[1] = Version;
+        header.reserved[2] = (std::uint32_t)(sourceHash & 0xFFFFFFFF);
+        header.reserved[3] = (std::uint32_t)(sourceHash >> 32);
+        header.pixelFormat.size   = sizeof(PixelFormat);
+        header.pixelFormat.flags  = PixelFourCC;
+        header.pixelFormat.fourCC = FourCC(texture.format);
+        header.caps[0]     = CapsTexture | CapsMipmap | CapsComplex;
+
+        std::ofstream out(cookedPath, std::ios::binary | std::ios::trunc);
+        if(!out)
+            return false;
+
+        out.write(Magic, sizeof(Magic));
+        out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        out.write(reinterpret_cast<const char*>(texture.data.data()), (std::streamsize)texture.data.size());
+
+        return (bool)out;
+    }
+
+    bool Load(
+        const std::string& cookedPath,
+        std::uint64_t sourceHash,
+        TextureCompressor::BlockFormat format,
+        CookedTexture& texture)
+    {
+        MappedFile file;
+        if(!file.Open(cookedPath) || file.Size() < sizeof(Magic) + sizeof(Header))
+            return false;
+
+        const unsigned char* base = file.Data();
+        Header header;
+        std::memcpy(&header, base + sizeof(Magic), sizeof(Header));
+
+        // Validate
+        if(std::memcmp(base, Magic, sizeof(Magic)) != 0
+        || header.size               != sizeof(Header)
+        || header.reserved[0]        != CacheTag
+        || header.reserved[1]        != Version
+        || header.reserved[2]        != (std::uint32_t)(sourceHash & 0xFFFFFFFF)
+        || header.reserved[3]        != (std::uint32_t)(sourceHash >> 32)
+        || header.pixelFormat.fourCC != FourCC(format)
+        || header.width == 0 || header.height == 0
+        || header.mipmapCount != MipChain::LevelCount((int)header.width, (int)header.height))
+            return false;
+
+        // Lay the levels out like the encoder did
+        texture.format = format;
+        texture.levels.resize(header.mipmapCount);
+
+        int width = (int)header.width;
+        int height = (int)header.height;
+        std::size_t offset = 0;
+        for(MipLevel& level : texture.levels)
+        {
+            level.width = width;
+            level.height = height;
+            level.offset = offset;
+            level.size = TextureCompressor::CompressedSize(format, width, height);
+            offset += level.size;
+
+            width = std::max(1, width / 2);
+            height = std::max(1, height / 2);
+        }
+
+        const std::size_t dataStart = sizeof(Magic) + sizeof(Header);
+        if(dataStart + offset != file.Size())
+        {
+            std::cout << "WARNING::TEXTURE_CACHE:: Truncated cooked file " << cookedPath << std::endl;
+            return false;
+        }
+
+        texture.data.assign(base + dataStart, base + dataStart + offset);
+        return true;
+    }
+
+} //~ namespace TextureCache
\ No newline at end of file
@@ -0,0 +1,51 @@
+#ifndef ELESWORD_TEXTURE_CACHE_HPP
+#define ELESWORD_TEXTURE_CACHE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MipChain.hpp"
+#include "TextureCompressor.hpp"
+
+/// A block compressed texture with its full mip chain
+struct CookedTexture
+{
+    TextureCompressor::BlockFormat format;
+    std::vector<MipLevel>          levels;  /// Level 0 first, down to 1x1
+    std::vector<unsigned char>     data;    /// Compressed blocks of all levels
+
+}; //~ CookedTexture
+
+/// Cache of block compressed textures.
+/// A cooked texture is a DDS file next to its source. The source hash and the
+/// cache version sit in the reserved words of the DDS header, so the files stay
+/// readable by other DDS tools. It is rejected when the source contents, the
+/// format or the version change.
+namespace TextureCache
+{
+    /// Bump whenever the encoders or the mip generation change
+    const std::uint32_t Version = 2;
+
+    /// Retrieves the path of the cooked file for given source texture
+    std::string CookedPath(const std::string& sourcePath);
+
+    /// Hashes the contents of given source texture. Returns 0 if it can't be read
+    std::uint64_t HashSource(const std::string& sourcePath);
+
+    /// Writes a cooked file for given texture. Returns false on failure
+    bool Save(
+        const std::string& cookedPath,
+        std::uint64_t sourceHash,
+        const CookedTexture& texture);
+
+    /// Reads a cooked file. Returns false if it is missing, corrupt or stale
+    bool Load(
+        const std::string& cookedPath,
+        std::uint64_t sourceHash,
+        TextureCompressor::BlockFormat format,
+        CookedTexture& texture);
+
+} //~ namespace TextureCache
+
+#endif //~ ELESWORD_TEXTURE_CACHE_HPP
\ No newline at end of file
@@ -0,0 +1,260 @@
+#include "TextureCompressor.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace
+{
+    /// Copies the 4x4 block at given block coordinates. Texels past the edges repeat the last ones
+    void FetchBlock(const unsigned char* rgba, int width, int height, int blockX, int blockY, unsigned char block[64])
+    {
+        for(int y = 0; y < 4; y++)
+        {
+            const int srcY = std::min(blockY * 4 + y, height - 1);
+            for(int x = 0; x < 4; x++)
+            {
+                const int srcX = std::min(blockX * 4 + x, width - 1);
+                const unsigned char* src = rgba + 4 * (srcY * width + srcX);
+                std::copy(src, src + 4, block + 4 * (y * 4 + x));
+            }
+        }
+    }
+
+    std::uint16_t PackColor565(const float color[3])
+    {
+        const int r = std::min(31, std::max(0, (int)std::lround(color[0] * 31.0f / 255.0f)));
+        const int g = std::min(63, std::max(0, (int)std::lround(color[1] * 63.0f / 255.0f)));
+        const int b = std::min(31, std::max(0, (int)std::lround(color[2] * 31.0f / 255.0f)));
+        return (std::uint16_t)((r << 11) | (g << 5) | b);
+    }
+
+    void UnpackColor565(std::uint16_t packed, int color[3])
+    {
+        const int r = (packed >> 11) & 31;
+        const int g = (packed >> 5) & 63;
+        const int b = packed & 31;
+        color[0] = (r << 3) | (r >> 2);
+        color[1] = (g << 2) | (g >> 4);
+        color[2] = (b << 3) | (b >> 2);
+    }
+
+    /// Encodes the RGB of a block in 4 color mode. The endpoints span the block
+    /// along its principal axis, found with a few power iterations
+    void EncodeColorBlock(const unsigned char block[64], unsigned char out[8])
+    {
+        float mean[3] = { 0.0f, 0.0f, 0.0f };
+        for(int i = 0; i < 16; i++)
+        {
+            for(int c = 0; c < 3; c++)
+                mean[c] += block[4 * i + c] / 16.0f;
+        }
+
+        float cov[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+        for(int i = 0; i < 16; i++)
+        {
+            const float r = block[4 * i + 0] - mean[0];
+            const float g = block[4 * i + 1] - mean[1];
+            const float b = block[4 * i + 2] - mean[2];
+            cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+            cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+        }
+
+        float axis[3] = { 1.0f, 1.0f, 1.0f };
+        for(int iteration = 0; iteration < 8; iteration++)
+        {
+            const float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+            const float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+            const float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+            const float length = std::max(std::fabs(x), std::max(std::fabs(y), std::fabs(z)));
+            if(length == 0.0f)
+                break;
+            axis[0] = x / length;
+            axis[1] = y / length;
+            axis[2] = z / length;
+        }
+
+        float minProj = 0.0f, maxProj = 0.0f;
+        for(int i = 0; i < 16; i++)
+        {
+            const float proj =
+                (block[4 * i + 0] - mean[0]) * axis[0] +
+                (block[4 * i + 1] - mean[1]) * axis[1] +
+                (block[4 * i + 2] - mean[2]) * axis[2];
+            minProj = std::min(minProj, proj);
+            maxProj = std::max(maxProj, proj);
+        }
+
+        const float axisLength2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+        float high[3], low[3];
+        for(int c = 0; c < 3; c++)
+        {
+            high[c] = mean[c] + axis[c] * maxProj / std::max(axisLength2, 1e-6f);
+            low[c]  = mean[c] + axis[c] * minProj / std::max(axisLength2, 1e-6f);
+        }
+
+        std::uint16_t color0 = PackColor565(high);
+        std::uint16_t color1 = PackColor565(low);
+        if(color0 < color1)
+            std::swap(color0, color1);
+
+        std::uint32_t indices = 0;
+        if(color0 != color1)
+        {
+            int palette[4][3];
+            UnpackColor565(color0, palette[0]);
+            UnpackColor565(color1, palette[1]);
+            for(int c = 0; c < 3; c++)
+            {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+
+            for(int i = 0; i < 16; i++)
+            {
+                int best = 0, bestError = 0x7FFFFFFF;
+                for(int p = 0; p < 4; p++)
+                {
+                    int error = 0;
+                    for(int c = 0; c < 3; c++)
+                    {
+                        const int d = block[4 * i + c] - palette[p][c];
+                        error += d * d;
+                    }
+                    if(error < bestError)
+                    {
+                        bestError = error;
+                        best = p;
+                    }
+                }
+                indices |= (std::uint32_t)best << (2 * i);
+            }
+        }
+
+        out[0] = (unsigned char)(color0 & 0xFF);
+        out[1] = (unsigned char)(color0 >> 8);
+        out[2] = (unsigned char)(color1 & 0xFF);
+        out[3] = (unsigned char)(color1 >> 8);
+        for(int i = 0; i < 4; i++)
+            out[4 + i] = (unsigned char)(indices >> (8 * i));
+    }
+
+    /// Encodes a single channel of a block in 8 value mode. The endpoints are the channel's range
+    void EncodeChannelBlock(const unsigned char block[64], int channel, unsigned char out[8])
+    {
+        int high = 0, low = 255;
+        for(int i = 0; i < 16; i++)
+        {
+            high = std::max(high, (int)block[4 * i + channel]);
+            low = std::min(low, (int)block[4 * i + channel]);
+        }
+
+        std::uint64_t indices = 0;
+        if(high != low)
+        {
+            int palette[8] = { high, low };
+            for(int p = 1; p < 7; p++)
+                palette[p + 1] = ((7 - p) * high + p * low) / 7;
+
+            for(int i = 0; i < 16; i++)
+            {
+                int best = 0, bestError = 256;
+                for(int p = 0; p < 8; p++)
+                {
+                    const int error = std::abs(block[4 * i + channel] - palette[p]);
+                    if(error < bestError)
+                    {
+                        bestError = error;
+                        best = p;
+                    }
+                }
+                indices |= (std::uint64_t)best << (3 * i);
+            }
+        }
+
+        out[0] = (unsigned char)high;
+        out[1] = (unsigned char)low;
+        for(int i = 0; i < 6; i++)
+            out[2 + i] = (unsigned char)(indices >> (8 * i));
+    }
+}
+
+//--------------------------------------------------
+// TextureCompressor
+//--------------------------------------------------
+namespace TextureCompressor
+{
+    BlockFormat PickFormat(const std::string& path, bool alpha)
+    {
+        const std::string normalSuffix = "_ddn";
+        const std::size_t extension = path.find_last_of('.');
+        const std::string stem = path.substr(0, extension);
+        if(stem.size() >= normalSuffix.size() && stem.compare(stem.size() - normalSuffix.size(), normalSuffix.size(), normalSuffix) == 0)
+            return BlockFormat::BC5;
+
+        return alpha ? BlockFormat::BC3 : BlockFormat::BC1;
+    }
+
+    GLenum GLFormat(BlockFormat format)
+    {
+        switch(format)
+        {
+            case BlockFormat::BC3:
+                return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+
+            case BlockFormat::BC5:
+                return GL_COMPRESSED_RG_RGTC2;
+
+            case BlockFormat::BC1:
+            default:
+                return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        }
+    }
+
+    std::size_t CompressedSize(BlockFormat format, int width, int height)
+    {
+        const std::size_t blockBytes = (format == BlockFormat::BC1) ? 8 : 16;
+        return (std::size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes;
+    }
+
+    void Compress(
+        const unsigned char* rgba,
+        int width,
+        int height,
+        BlockFormat format,
+        unsigned char* out)
+    {
+        const int blocksX = (width + 3) / 4;
+        const int blocksY = (height + 3) / 4;
+
+        unsigned char block[64];
+        for(int blockY = 0; blockY < blocksY; blockY++)
+        {
+            for(int blockX = 0; blockX < blocksX; blockX++)
+            {
+                FetchBlock(rgba, width, height, blockX, blockY, block);
+
+                switch(format)
+                {
+                    case BlockFormat::BC3:
+                        EncodeChannelBlock(block, 3, out);
+                        EncodeColorBlock(block, out + 8);
+                        out += 16;
+                        break;
+
+                    case BlockFormat::BC5:
+                        EncodeChannelBlock(block, 0, out);
+                        EncodeChannelBlock(block, 1, out + 8);
+                        out += 16;
+                        break;
+
+                    case BlockFormat::BC1:
+                    default:
+                        EncodeColorBlock(block, out);
+                        out += 8;
+                        break;
+                }
+            }
+        }
+    }
+
+} //~ namespace TextureCompressor
\ No newline at end of file
@@ -0,0 +1,40 @@
+#ifndef ELESWORD_TEXTURE_COMPRESSOR_HPP
+#define ELESWORD_TEXTURE_COMPRESSOR_HPP
+
+#include <cstddef>
+#include <string>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+/// CPU encoders of the GPU block compressed formats.
+/// Every format stores 4x4 texel blocks, partial blocks at the edges repeat the last texels
+namespace TextureCompressor
+{
+    enum class BlockFormat
+    {
+        BC1 = 0,  /// RGB, 8 bytes per block (S3TC DXT1)
+        BC3,      /// RGBA, 16 bytes per block (S3TC DXT5)
+        BC5       /// RG, 16 bytes per block (RGTC2). For tangent space normal maps
+    }; //~ BlockFormat
+
+    /// Picks the format of a texture file. Normal maps are named *_ddn
+    BlockFormat PickFormat(const std::string& path, bool alpha);
+
+    /// Retrieves the GL internal format of given block format
+    GLenum GLFormat(BlockFormat format);
+
+    /// Retrieves the size in bytes of a compressed image of given size
+    std::size_t CompressedSize(BlockFormat format, int width, int height);
+
+    /// Compresses an RGBA8 image. Writes CompressedSize() bytes to out
+    void Compress(
+        const unsigned char* rgba,
+        int width,
+        int height,
+        BlockFormat format,
+        unsigned char* out);
+
+} //~ namespace TextureCompressor
+
+#endif //~ ELESWORD_TEXTURE_COMPRESSOR_HPP
\ No newline at end of file
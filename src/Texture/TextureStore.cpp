@@ -1,65 +1,766 @@
 #include "TextureStore.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <numeric>
 #include <SOIL.h>
 
-//--------------------------------------------------
-// Util functions
-//--------------------------------------------------
-GLint TextureFromFile(const std::string& path, bool alpha)
+#include "TextureCache.hpp"
+#include "TextureCompressor.hpp"
+
+namespace
 {
-    GLuint textureID;
-    glGenTextures(1, &textureID);
+    /// Texel of the textures whose image isn't uploaded yet
+    const GLubyte FallbackTexel[4] = { 128, 128, 128, 255 };
 
-    // Load image
-    int width, height;
-    unsigned char* image =
-        SOIL_load_image(path.c_str(), &width, &height, 0, alpha ? SOIL_LOAD_RGBA : SOIL_LOAD_RGB);
-
-    // Assign texture to ID
-    glBindTexture(GL_TEXTURE_2D, textureID);
-    glTexImage2D(
-        GL_TEXTURE_2D,
-        0,
-        alpha ? GL_RGBA : GL_RGB,
-        width,
-        height,
-        0,
-        alpha ? GL_RGBA : GL_RGB,
-        GL_UNSIGNED_BYTE,
-        image);
-    glGenerateMipmap(GL_TEXTURE_2D);
+    /// Alpha below which the shaders discard the pixels of alpha textures
+    const float AlphaTestReference = 0.1f;
+
+    /// Sets the sampling parameters of the bound texture array
+    void SetTextureParameters(bool alpha)
+    {
+        // Use GL_CLAMP_TO_EDGE to prevent semi-transparent borders.
+        // Due to interpolation it takes value from next repeat
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, alpha ? GL_CLAMP_TO_EDGE : GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, alpha ? GL_CLAMP_TO_EDGE : GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
 
-    // Parameters
-    // Use GL_CLAMP_TO_EDGE to prevent semi-transparent borders.
-    // Due to interpolation it takes value from next repeat 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, alpha ? GL_CLAMP_TO_EDGE : GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, alpha ? GL_CLAMP_TO_EDGE : GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    /// Retrieves the finest level a texture of given size starts with
+    unsigned StartLevel(int width, int height, unsigned levels)
+    {
+        unsigned level = 0;
+        while(level + 1 < levels && std::max(width >> level, height >> level) > TextureStore::StreamedMipSize)
+            level++;
+        return level;
+    }
 
-    SOIL_free_image_data(image);
-    return textureID;
+    /// Uploads a level of an image to a layer of the bound array.
+    /// Pixels are an offset in the bound pixel buffer if there's one
+    void UploadLevel(
+        bool compressed,
+        GLenum internalFormat,
+        const MipLevel& level,
+        unsigned mip,
+        GLint layer,
+        const GLvoid* pixels)
+    {
+        if(compressed)
+        {
+            glCompressedTexSubImage3D(
+                GL_TEXTURE_2D_ARRAY,
+                (GLint)mip,
+                0,
+                0,
+                layer,
+                level.width,
+                level.height,
+                1,
+                internalFormat,
+                (GLsizei)level.size,
+                pixels);
+        }
+        else
+        {
+            // RGBA8 rows are always 4 byte aligned
+            glTexSubImage3D(
+                GL_TEXTURE_2D_ARRAY,
+                (GLint)mip,
+                0,
+                0,
+                layer,
+                level.width,
+                level.height,
+                1,
+                GL_RGBA,
+                GL_UNSIGNED_BYTE,
+                pixels);
+        }
+    }
 }
 
 //--------------------------------------------------
 // public functions
 //--------------------------------------------------
-TextureStore::TextureStore()
+const GLsizei TextureStore::ArrayLayers;
+const GLint TextureStore::FallbackHandle;
+const unsigned int TextureStore::DefaultIdleFrames;
+const int TextureStore::StreamedMipSize;
+const unsigned int TextureStore::StreamOutFrames;
+
+TextureStore::TextureStore(ThreadPool* threadPool)
+    : mThreadPool(threadPool)
+    , mCompress(GLEW_EXT_texture_compression_s3tc != GL_FALSE)
+    , mPixelBuffer(0)
+    , mStreamBuffer(0)
+    , mFrame(0)
+    , mBudgetBytes(0)
+    , mIdleFrames(DefaultIdleFrames)
+    , mBytesUsed(0)
+    , mPeakBytesUsed(0)
 {
+    // The fallback is a single layer 1x1 array, every handle resolves to it until its image lands
+    TextureArray fallback = { 0, GL_RGBA, 1, 1, 1, false, 1, {}, { FallbackHandle }, { sizeof(FallbackTexel) }, 0, 0, 0, 0, 0 };
+    glGenTextures(1, &fallback.id);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, fallback.id);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA, 1, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, FallbackTexel);
+    SetTextureParameters(false);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    mArrays.push_back(fallback);
+    mRecords.push_back(TextureRecord(std::string(), false, { fallback.id, 0 }, 0, Residency::Resident));
+    mBytesUsed = mPeakBytesUsed = sizeof(FallbackTexel);
 }
 
 TextureStore::~TextureStore()
 {
-    for(const auto& p : mTextures)
-        glDeleteTextures(1, &p.second);
+    for(const std::shared_ptr<PendingTexture>& texture : mPending)
+    {
+        if(texture->decode.valid())
+            texture->decode.wait();
+    }
+    mPending.clear();
+
+    for(const TextureRecord& record : mRecords)
+    {
+        if(record.detailLoad.valid())
+            record.detailLoad.wait();
+    }
+
+    for(const TextureArray& array : mArrays)
+        glDeleteTextures(1, &array.id);
+    mArrays.clear();
+    mRecords.clear();
     mTextures.clear();
+
+    glDeleteBuffers(1, &mPixelBuffer);
+    glDeleteBuffers(1, &mStreamBuffer);
 }
 
 GLint TextureStore::LoadTexture(const std::string& filepath, bool alpha /*= false*/)
 {
     // Check if texture isn't already loaded and if not, load it
-    if(mTextures.count(filepath) == 0)
-        mTextures.insert({filepath, TextureFromFile(filepath, alpha)});
+    auto it = mTextures.find(filepath);
+    if(it != mTextures.end())
+        return it->second;
+
+    const GLint handle = (GLint)mRecords.size();
+    mRecords.push_back(TextureRecord(filepath, alpha, mRecords[FallbackHandle].slot, mFrame, Residency::Loading));
+    mTextures.insert({filepath, handle});
+
+    Queue(handle);
+    return handle;
+}
+
+std::vector<GLint> TextureStore::LoadTextures(const std::vector<std::string>& filepaths, bool alpha /*= false*/)
+{
+    std::vector<GLint> handles;
+    handles.reserve(filepaths.size());
+    for(const std::string& filepath : filepaths)
+        handles.push_back(LoadTexture(filepath, alpha));
+    return handles;
+}
+
+void TextureStore::ProcessUploads(std::size_t budgetBytes)
+{
+    mFrame++;
+    Evict();
+
+    const std::size_t frameBudgetBytes = budgetBytes;
+    UploadPending(budgetBytes);
+    Stream(budgetBytes, frameBudgetBytes);
+}
+
+std::size_t TextureStore::GetPendingUploads() const
+{
+    return mPending.size();
+}
+
+void TextureStore::SetBudget(std::size_t budgetBytes, unsigned int idleFrames /*= DefaultIdleFrames*/)
+{
+    mBudgetBytes = budgetBytes;
+    mIdleFrames = idleFrames;
+}
+
+const TextureSlot& TextureStore::GetSlot(GLint handle)
+{
+    if(handle < 0 || (std::size_t)handle >= mRecords.size())
+        return mRecords[FallbackHandle].slot;
+
+    TextureRecord& record = mRecords[handle];
+    record.lastUsed = mFrame;
+
+    // Evicted since its last use, bring it back
+    if(record.residency == Residency::Evicted)
+        Queue(handle);
+
+    return record.slot;
+}
+
+void TextureStore::RequestDetail(GLint handle, float screenPixels)
+{
+    if(handle <= FallbackHandle || (std::size_t)handle >= mRecords.size())
+        return;
+
+    const TextureRecord& record = mRecords[handle];
+    if(record.residency != Residency::Resident)
+        return;
+
+    // Coarsest level still as large as the texture is drawn
+    TextureArray* array = GetArray(record.slot.array);
+    unsigned level = 0;
+    while(level + 1 < array->levels
+       && (float)std::max(array->width >> (level + 1), array->height >> (level + 1)) >= screenPixels)
+        level++;
+
+    // The array keeps the finest level its textures asked for, until it's left unasked for a while
+    if(level <= array->requestedLevel || mFrame - array->requestedFrame > StreamOutFrames)
+    {
+        array->requestedLevel = level;
+        array->requestedFrame = mFrame;
+    }
+}
+
+std::size_t TextureStore::GetTextureBytes(GLint handle) const
+{
+    if(handle < 0 || (std::size_t)handle >= mRecords.size())
+        return 0;
+
+    const TextureRecord& record = mRecords[handle];
+    if(record.residency != Residency::Resident)
+        return 0;
+
+    auto array = std::find_if(mArrays.begin(), mArrays.end(), [&record](const TextureArray& a) { return a.id == record.slot.array; });
+    return std::accumulate(array->levelBytes.begin() + array->baseLevel, array->levelBytes.end(), (std::size_t)0);
+}
+
+std::size_t TextureStore::GetBytesUsed() const
+{
+    return mBytesUsed;
+}
+
+std::size_t TextureStore::GetPeakBytesUsed() const
+{
+    return mPeakBytesUsed;
+}
+
+std::size_t TextureStore::GetArrayCount() const
+{
+    return mArrays.size();
+}
+
+//--------------------------------------------------
+// private functions
+//--------------------------------------------------
+void TextureStore::Queue(GLint handle)
+{
+    TextureRecord& record = mRecords[handle];
+    record.residency = Residency::Loading;
+
+    std::shared_ptr<PendingTexture> texture(std::make_shared<PendingTexture>());
+    texture->handle = handle;
+    texture->alpha = record.alpha;
+    texture->path = record.path;
+
+    const std::string filepath = record.path;
+    const bool alpha = record.alpha;
+    const bool compress = mCompress;
+    texture->decode = mThreadPool->Submit([filepath, alpha, compress]()
+    {
+        return Decode(filepath, alpha, compress);
+    });
+
+    mPending.push_back(texture);
+}
+
+void TextureStore::Evict()
+{
+    while(mBudgetBytes != 0 && mBytesUsed > mBudgetBytes)
+    {
+        // Memory is only given back once a whole array is unused, so arrays are evicted
+        // whole. The victim is the one whose most recently used texture is the oldest,
+        // among those whose textures have all been idle long enough
+        std::size_t victim = 0;
+        unsigned victimLastUsed = 0;
+        for(std::size_t i = 1; i < mArrays.size(); i++)
+        {
+            const TextureArray& array = mArrays[i];
+
+            bool idle = true;
+            unsigned lastUsed = 0;
+            for(GLint layer = 0; layer < array.layersUsed && idle; layer++)
+            {
+                const GLint handle = array.layerHandles[layer];
+                if(handle < 0)
+                    continue;
+
+                idle = mFrame - mRecords[handle].lastUsed >= mIdleFrames;
+                lastUsed = std::max(lastUsed, mRecords[handle].lastUsed);
+            }
+
+            if(idle && (victim == 0 || lastUsed < victimLastUsed))
+            {
+                victim = i;
+                victimLastUsed = lastUsed;
+            }
+        }
+
+        // Nothing left that can be reclaimed
+        if(victim == 0)
+            return;
+
+        TextureArray& array = mArrays[victim];
+        for(GLint layer = 0; layer < array.layersUsed; layer++)
+        {
+            const GLint handle = array.layerHandles[layer];
+            if(handle < 0)
+                continue;
+
+            TextureRecord& record = mRecords[handle];
+            record.slot = mRecords[FallbackHandle].slot;
+            record.residency = Residency::Evicted;
+            record.detail = Image();
+            record.detailLoad = std::future<Image>();
+        }
+
+        glDeleteTextures(1, &array.id);
+        mBytesUsed -= std::accumulate(array.levelBytes.begin() + array.allocatedLevel, array.levelBytes.end(), (std::size_t)0) * ArrayLayers;
+        mArrays.erase(mArrays.begin() + victim);
+    }
+}
+
+TextureStore::Image TextureStore::Decode(const std::string& filepath, bool alpha, bool compress)
+{
+    Image image;
+    const TextureCompressor::BlockFormat format = TextureCompressor::PickFormat(filepath, alpha);
+    const std::string cookedPath = TextureCache::CookedPath(filepath);
+    const std::uint64_t sourceHash = compress ? TextureCache::HashSource(filepath) : 0;
+
+    // Warm start: the cooked mip chain goes straight to the GPU
+    CookedTexture cooked;
+    if(sourceHash != 0 && TextureCache::Load(cookedPath, sourceHash, format, cooked))
+    {
+        image.internalFormat = TextureCompressor::GLFormat(format);
+        image.compressed = true;
+        image.levels = std::move(cooked.levels);
+        image.data = std::move(cooked.data);
+        return image;
+    }
+
+    int width, height;
+    unsigned char* pixels = SOIL_load_image(filepath.c_str(), &width, &height, 0, SOIL_LOAD_RGBA);
+    if(pixels == nullptr)
+        return image;
+
+    // Every level is built here, so the finer ones can be streamed in later.
+    // Normal maps aren't colors and are filtered as they are
+    std::vector<unsigned char> mips;
+    std::vector<MipLevel> mipLevels = MipChain::Build(
+        pixels,
+        width,
+        height,
+        mips,
+        format != TextureCompressor::BlockFormat::BC5,
+        alpha ? AlphaTestReference : 0.0f);
+    SOIL_free_image_data(pixels);
+
+    if(!compress)
+    {
+        image.internalFormat = alpha ? GL_RGBA : GL_RGB;
+        image.levels = std::move(mipLevels);
+        image.data = std::move(mips);
+        return image;
+    }
+
+    // Cold start: compress every level and cook the result for the next run
+
+    cooked.format = format;
+    cooked.levels = mipLevels;
+    std::size_t offset = 0;
+    for(MipLevel& level : cooked.levels)
+    {
+        level.offset = offset;
+        level.size = TextureCompressor::CompressedSize(format, level.width, level.height);
+        offset += level.size;
+    }
+    cooked.data.resize(offset);
+
+    for(std::size_t i = 0; i < mipLevels.size(); i++)
+    {
+        TextureCompressor::Compress(
+            mips.data() + mipLevels[i].offset,
+            mipLevels[i].width,
+            mipLevels[i].height,
+            format,
+            cooked.data.data() + cooked.levels[i].offset);
+    }
+
+    if(sourceHash != 0 && !TextureCache::Save(cookedPath, sourceHash, cooked))
+        std::cout << "WARNING::TEXTURE_CACHE:: Could not write " << cookedPath << std::endl;
+
+    image.internalFormat = TextureCompressor::GLFormat(format);
+    image.compressed = true;
+    image.levels = std::move(cooked.levels);
+    image.data = std::move(cooked.data);
+    return image;
+}
+
+void TextureStore::UploadPending(std::size_t& budgetBytes)
+{
+    auto it = mPending.begin();
+
+    while(it != mPending.end())
+    {
+        PendingTexture& texture = **it;
+
+        if(texture.decode.valid())
+        {
+            // Still decoding, try the next one
+            if(texture.decode.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            {
+                ++it;
+                continue;
+            }
+            texture.image = texture.decode.get();
+        }
+
+        if(budgetBytes == 0)
+            return;
+
+        // The pixel buffer stages one image at a time. Keep this one first until it's done
+        mPending.splice(mPending.begin(), mPending, it);
+        if(!UploadStep(texture, budgetBytes))
+            return;
+
+        mPending.pop_front();
+        it = mPending.begin();
+    }
+}
+
+void TextureStore::Stream(std::size_t& budgetBytes, std::size_t frameBudgetBytes)
+{
+    // The fallback never streams
+    for(std::size_t i = 1; i < mArrays.size(); i++)
+    {
+        TextureArray& array = mArrays[i];
+
+        // Coarse levels always stay, finer ones only while they are asked for
+        unsigned wantedLevel = StartLevel(array.width, array.height, array.levels);
+        if(mFrame - array.requestedFrame <= StreamOutFrames)
+            wantedLevel = std::min(wantedLevel, array.requestedLevel);
+
+        if(wantedLevel >= array.baseLevel)
+        {
+            if(array.allocatedLevel == array.baseLevel && wantedLevel == array.baseLevel)
+                continue;
+
+            // Drop the level being streamed in, or else the finest one sampled
+            ReleaseDetail(array);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, array.id);
+            if(array.allocatedLevel == array.baseLevel)
+            {
+                array.baseLevel++;
+                glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, (GLint)array.baseLevel);
+            }
+            AllocateLevel(array, array.allocatedLevel, false);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+            mBytesUsed -= array.levelBytes[array.allocatedLevel] * ArrayLayers;
+            array.allocatedLevel++;
+            array.streamedLayers = 0;
+            continue;
+        }
+
+        // A finer level is wanted. Give it storage, then upload it a layer at a time
+        const unsigned level = array.baseLevel - 1;
+        glBindTexture(GL_TEXTURE_2D_ARRAY, array.id);
+        if(array.allocatedLevel > level)
+        {
+            AllocateLevel(array, level, true);
+            mBytesUsed += array.levelBytes[level] * ArrayLayers;
+            mPeakBytesUsed = std::max(mPeakBytesUsed, mBytesUsed);
+            array.allocatedLevel = level;
+            array.streamedLayers = 0;
+        }
+
+        if(mStreamBuffer == 0)
+            glGenBuffers(1, &mStreamBuffer);
+
+        // Images aren't kept once uploaded. Read the layers left back in, all at once
+        for(GLint layer = array.streamedLayers; layer < array.layersUsed; layer++)
+        {
+            if(array.layerHandles[layer] >= 0)
+                LoadDetail(array.layerHandles[layer]);
+        }
+
+        // Free layers and layers still uploading get the level with the rest of their image
+        while(array.streamedLayers < array.layersUsed)
+        {
+            const GLint handle = array.layerHandles[array.streamedLayers];
+            if(handle >= 0)
+            {
+                TextureRecord& record = mRecords[handle];
+                if(record.detailLoad.valid())
+                {
+                    if(record.detailLoad.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                        break;
+                    record.detail = record.detailLoad.get();
+                }
+
+                // Changed or gone since it was uploaded, its layer is left undefined at this level
+                const Image& image = record.detail;
+                if(image.internalFormat == array.internalFormat && image.levels.size() == array.levels)
+                {
+                    // Past the budget, unless nothing was uploaded this frame
+                    const MipLevel& mip = image.levels[level];
+                    if(budgetBytes == 0 || (mip.size > budgetBytes && budgetBytes < frameBudgetBytes))
+                        break;
+
+                    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, mStreamBuffer);
+                    glBufferData(GL_PIXEL_UNPACK_BUFFER, mip.size, image.data.data() + mip.offset, GL_STREAM_DRAW);
+                    UploadLevel(image.compressed, image.internalFormat, mip, level, array.streamedLayers, nullptr);
+                    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+                    budgetBytes -= std::min(budgetBytes, mip.size);
+                }
+                else
+                    std::cout << "ERROR::TEXTURE:: Could not reload " << record.path << std::endl;
+            }
+            array.streamedLayers++;
+        }
+
+        // Every resident layer has it, sample from it. The images go once no finer level is wanted
+        if(array.streamedLayers == array.layersUsed)
+        {
+            array.baseLevel = level;
+            array.streamedLayers = 0;
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, (GLint)array.baseLevel);
+
+            if(array.baseLevel == wantedLevel)
+                ReleaseDetail(array);
+        }
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    }
+}
+
+void TextureStore::LoadDetail(GLint handle)
+{
+    TextureRecord& record = mRecords[handle];
+    if(!record.detail.levels.empty() || record.detailLoad.valid())
+        return;
+
+    // Comes from the cooked file, unless block compression is off or it couldn't be written
+    const std::string filepath = record.path;
+    const bool alpha = record.alpha;
+    const bool compress = mCompress;
+    record.detailLoad = mThreadPool->Submit([filepath, alpha, compress]()
+    {
+        return Decode(filepath, alpha, compress);
+    });
+}
+
+void TextureStore::ReleaseDetail(const TextureArray& array)
+{
+    for(GLint layer = 0; layer < array.layersUsed; layer++)
+    {
+        const GLint handle = array.layerHandles[layer];
+        if(handle < 0)
+            continue;
+
+        // A read still running is left to finish, its result is dropped
+        mRecords[handle].detail = Image();
+        mRecords[handle].detailLoad = std::future<Image>();
+    }
+}
+
+TextureStore::TextureArray* TextureStore::GetArray(GLuint id)
+{
+    auto array = std::find_if(mArrays.begin(), mArrays.end(), [id](const TextureArray& a) { return a.id == id; });
+    return array == mArrays.end() ? nullptr : &*array;
+}
+
+TextureStore::TextureArray* TextureStore::MatchArray(const Image& image, bool alpha)
+{
+    const MipLevel& base = image.levels[0];
+
+    for(TextureArray& array : mArrays)
+    {
+        if(array.internalFormat == image.internalFormat
+        && array.width == base.width
+        && array.height == base.height
+        && array.levels == image.levels.size()
+        && array.alpha == alpha
+        && (array.layersUsed < ArrayLayers || !array.freeLayers.empty()))
+            return &array;
+    }
+
+    return nullptr;
+}
+
+TextureStore::TextureArray& TextureStore::FindArray(const Image& image, bool alpha)
+{
+    TextureArray* match = MatchArray(image, alpha);
+    if(match != nullptr)
+        return *match;
+
+    // None with room, allocate the coarse levels of a new one
+    const MipLevel& base = image.levels[0];
+    const unsigned levels = (unsigned)image.levels.size();
+    const unsigned startLevel = StartLevel(base.width, base.height, levels);
+    TextureArray array = {
+        0, image.internalFormat, base.width, base.height, levels, alpha, 0, {},
+        std::vector<GLint>(ArrayLayers, -1), {}, startLevel, startLevel, 0, startLevel, mFrame };
+
+    for(const MipLevel& level : image.levels)
+    {
+        array.levelBytes.push_back(image.compressed
+            ? level.size
+            : (std::size_t)level.width * level.height * (image.internalFormat == GL_RGBA ? 4 : 3));
+    }
+
+    glGenTextures(1, &array.id);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, array.id);
+    for(unsigned level = startLevel; level < levels; level++)
+    {
+        AllocateLevel(array, level, true);
+        mBytesUsed += array.levelBytes[level] * ArrayLayers;
+    }
+    SetTextureParameters(alpha);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, (GLint)startLevel);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, (GLint)levels - 1);
+
+    mPeakBytesUsed = std::max(mPeakBytesUsed, mBytesUsed);
+
+    mArrays.push_back(array);
+    return mArrays.back();
+}
+
+void TextureStore::AllocateLevel(const TextureArray& array, unsigned level, bool allocate)
+{
+    // A level without layers has no storage. Levels below the base one don't need any
+    const GLsizei layers = allocate ? ArrayLayers : 0;
+    const GLsizei width = std::max(1, array.width >> level);
+    const GLsizei height = std::max(1, array.height >> level);
+
+    if(array.internalFormat != GL_RGB && array.internalFormat != GL_RGBA)
+    {
+        glCompressedTexImage3D(
+            GL_TEXTURE_2D_ARRAY,
+            (GLint)level,
+            array.internalFormat,
+            width,
+            height,
+            layers,
+            0,
+            (GLsizei)(array.levelBytes[level] * layers),
+            nullptr);
+    }
+    else
+    {
+        glTexImage3D(
+            GL_TEXTURE_2D_ARRAY,
+            (GLint)level,
+            array.internalFormat,
+            width,
+            height,
+            layers,
+            0,
+            GL_RGBA,
+            GL_UNSIGNED_BYTE,
+            nullptr);
+    }
+}
+
+bool TextureStore::UploadStep(PendingTexture& texture, std::size_t& budgetBytes)
+{
+    Image& image = texture.image;
+    if(image.internalFormat == 0)
+    {
+        std::cout << "ERROR::TEXTURE:: Could not load " << texture.path << std::endl;
+        mRecords[texture.handle].residency = Residency::Failed;
+        return true;
+    }
+
+    // Only the levels with storage are staged, the array it'll likely go to tells which
+    if(texture.bytesStaged == 0)
+    {
+        const TextureArray* match = MatchArray(image, texture.alpha);
+        texture.firstLevel = match != nullptr
+            ? match->allocatedLevel
+            : StartLevel(image.levels[0].width, image.levels[0].height, (unsigned)image.levels.size());
+    }
+    const std::size_t stagedOffset = image.levels[texture.firstLevel].offset;
+    const std::size_t imageBytes = image.data.size() - stagedOffset;
+    const unsigned char* staged = image.data.data() + stagedOffset;
+
+    if(mPixelBuffer == 0)
+        glGenBuffers(1, &mPixelBuffer);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, mPixelBuffer);
+
+    // Copy the image to the pixel buffer, as much as the budget allows
+    if(texture.bytesStaged < imageBytes)
+    {
+        if(texture.bytesStaged == 0)
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, imageBytes, nullptr, GL_STREAM_DRAW);
+
+        const std::size_t size = std::min(budgetBytes, imageBytes - texture.bytesStaged);
+        void* staging = glMapBufferRange(
+            GL_PIXEL_UNPACK_BUFFER,
+            texture.bytesStaged,
+            size,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if(staging != nullptr)
+        {
+            std::memcpy(staging, staged + texture.bytesStaged, size);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        }
+        else
+            glBufferSubData(GL_PIXEL_UNPACK_BUFFER, texture.bytesStaged, size, staged + texture.bytesStaged);
+
+        texture.bytesStaged += size;
+        budgetBytes -= size;
+
+        if(texture.bytesStaged < imageBytes)
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            return false;
+        }
+    }
+
+    // All staged: the driver copies from the pixel buffer without stalling on the image
+    // Allocating a new array must not read from the pixel buffer
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    TextureArray& array = FindArray(image, texture.alpha);
+    GLint layer;
+    if(!array.freeLayers.empty())
+    {
+        layer = array.freeLayers.back();
+        array.freeLayers.pop_back();
+    }
+    else
+        layer = array.layersUsed++;
+    array.layerHandles[layer] = texture.handle;
+
+    // Levels that got storage while it was staged come straight from the image
+    glBindTexture(GL_TEXTURE_2D_ARRAY, array.id);
+    for(unsigned i = array.allocatedLevel; i < texture.firstLevel; i++)
+        UploadLevel(image.compressed, image.internalFormat, image.levels[i], i, layer, image.data.data() + image.levels[i].offset);
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, mPixelBuffer);
+    for(unsigned i = std::max(array.allocatedLevel, texture.firstLevel); i < image.levels.size(); i++)
+    {
+        const MipLevel& level = image.levels[i];
+        UploadLevel(image.compressed, image.internalFormat, level, i, layer, (GLvoid*)(level.offset - stagedOffset));
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
 
-    return mTextures[filepath];
+    // The image goes with the pending texture, finer levels are read back when they're streamed in
+    TextureRecord& record = mRecords[texture.handle];
+    record.slot = { array.id, layer };
+    record.lastUsed = mFrame;
+    record.residency = Residency::Resident;
+    return true;
 }
\ No newline at end of file
@@ -1,36 +1,225 @@
 #ifndef ELESWORD_TEXTURE_STORE_HPP
 #define ELESWORD_TEXTURE_STORE_HPP
 
+#include <cstddef>
+#include <future>
+#include <list>
+#include <memory>
 #include <unordered_map>
 #include <string>
+#include <vector>
 
 #define GLEW_STATIC
 #include <GL/glew.h>
 
+#include "MipChain.hpp"
 #include "Texture.hpp"
+#include "../Util/ThreadPool.hpp"
 
+/// Where a texture lives on the GPU
+struct TextureSlot
+{
+    GLuint array;   /// GL_TEXTURE_2D_ARRAY holding the texture
+    GLint  layer;   /// Layer of the texture in the array
+
+}; //~ TextureSlot
+
+/// Loads textures and groups them in texture arrays.
+/// Textures of the same format, size and wrap mode share arrays, so meshes
+/// that use them can be drawn with the same bindings and only switch layers.
+/// Textures are referred to by handles, resolved to a slot with GetSlot.
+/// With a budget set, arrays whose textures are all left unused are evicted least
+/// recently used first. Their textures load again the next time their slot is asked for.
+/// Textures start with their coarse mips only. The finer levels an array needs
+/// are streamed in and out following the sizes its textures are drawn at, read
+/// back from the cooked files or the sources as they are streamed in
 class TextureStore
 {
 public:
-    /// Default Constructor
-    TextureStore();
+    /// Layers allocated per texture array
+    static const GLsizei ArrayLayers = 16;
+
+    /// Handle of the 1x1 fallback
+    static const GLint FallbackHandle = 0;
+
+    /// Frames a texture has to be left unused before it can be evicted, by default
+    static const unsigned int DefaultIdleFrames = 300;
+
+    /// Largest side of the finest level textures start with. Finer ones are streamed in
+    static const int StreamedMipSize = 64;
+
+    /// Frames a streamed level has to be left unasked for before it is dropped
+    static const unsigned int StreamOutFrames = 60;
+
+    /// Constructor. Images get decoded on given thread pool.
+    /// Needs the GL context, to check for block compression support
+    explicit TextureStore(ThreadPool* threadPool);
 
     /// Disable copy construction
     TextureStore(const TextureStore&) = delete;
     TextureStore& operator=(const TextureStore&) = delete;
 
-    /// Enable move construction
-    TextureStore(TextureStore&& other) = default;
-    TextureStore& operator=(TextureStore&& other) = default;
-
-    /// Destructor
+    /// Destructor. Waits for the images being decoded
     ~TextureStore();
 
-    /// Loads to gpu the texture with given filename, if it isn't loaded before
+    /// Retrieves the handle of the texture with given filename, loading it if it
+    /// isn't loaded before. The handle is usable right away and resolves to a 1x1
+    /// fallback until ProcessUploads has moved the decoded image to the GPU
     GLint LoadTexture(const std::string& filepath, bool alpha = false);
 
+    /// Same as LoadTexture for a batch of files. Their images are decoded in parallel
+    std::vector<GLint> LoadTextures(const std::vector<std::string>& filepaths, bool alpha = false);
+
+    /// Evicts unused textures if over budget, then uploads the decoded images and
+    /// streams mip levels, about given number of bytes at most. Call once per frame
+    /// from the GL thread. Evictions delete emptied arrays, so cached bindings are stale after it
+    void ProcessUploads(std::size_t budgetBytes);
+
+    /// Sets the texture memory the store tries to stay under, 0 for no limit,
+    /// and the frames a texture has to be left unused before it can be evicted
+    void SetBudget(std::size_t budgetBytes, unsigned int idleFrames = DefaultIdleFrames);
+
+    /// Retrieves the number of textures still showing their fallback
+    std::size_t GetPendingUploads() const;
+
+    /// Retrieves where the texture with given handle currently lives and marks it
+    /// used this frame. An evicted texture is loaded again and shows the fallback meanwhile
+    const TextureSlot& GetSlot(GLint handle);
+
+    /// Asks for the texture with given handle to be sharp when drawn across given
+    /// number of pixels. Call every frame it is drawn, its finer mips are dropped otherwise
+    void RequestDetail(GLint handle, float screenPixels);
+
+    /// Retrieves the size in bytes of the resident mips of the texture with given handle. 0 if not resident
+    std::size_t GetTextureBytes(GLint handle) const;
+
+    /// Retrieves the bytes of texture memory allocated by the store
+    std::size_t GetBytesUsed() const;
+
+    /// Retrieves the most bytes of texture memory the store has allocated at once
+    std::size_t GetPeakBytesUsed() const;
+
+    /// Retrieves the number of texture arrays, the fallback's included
+    std::size_t GetArrayCount() const;
+
 private:
-    std::unordered_map<std::string, GLuint> mTextures;
+    /// Image decoded from a file or a cooked texture
+    struct Image
+    {
+        GLenum                     internalFormat = 0; /// 0 if the file couldn't be decoded
+        bool                       compressed = false; /// Block compressed, RGBA8 otherwise
+        std::vector<MipLevel>      levels;             /// Full mip chain, level 0 first
+        std::vector<unsigned char> data;               /// Texels of all levels
+    };
+
+    /// Where a texture is in its life
+    enum class Residency
+    {
+        Loading = 0,
+        Resident,
+        Evicted,
+        Failed
+    };
+
+    /// What the store knows about a texture
+    struct TextureRecord
+    {
+        TextureRecord(const std::string& filepath, bool hasAlpha, TextureSlot initialSlot, unsigned frame, Residency initialResidency)
+            : path(filepath), alpha(hasAlpha), slot(initialSlot), lastUsed(frame), residency(initialResidency) {}
+
+        std::string path;
+        bool        alpha;
+        TextureSlot slot;       /// The fallback's unless resident
+        unsigned    lastUsed;   /// Frame of the last GetSlot
+        Residency   residency;
+        Image       detail;     /// Read back to stream its finer mips in. Empty unless its array is streaming in
+        std::future<Image> detailLoad; /// Read of detail in flight
+    };
+
+    /// A texture array and the kind of textures it holds
+    struct TextureArray
+    {
+        GLuint   id;
+        GLenum   internalFormat;
+        int      width;
+        int      height;
+        unsigned levels;
+        bool     alpha;
+        GLsizei  layersUsed;           /// Layers handed out so far, freed ones included
+        std::vector<GLint> freeLayers; /// Layers of evicted textures
+        std::vector<GLint> layerHandles; /// Handle of the texture resident in every layer, -1 if none
+        std::vector<std::size_t> levelBytes; /// Size of a layer of every level
+        unsigned baseLevel;            /// Finest level every resident layer has, sampling starts there
+        unsigned allocatedLevel;       /// Finest level with storage. Finer than baseLevel while streaming in
+        GLint    streamedLayers;       /// Layers the level being streamed in was uploaded to
+        unsigned requestedLevel;       /// Finest level asked for lately
+        unsigned requestedFrame;       /// Frame requestedLevel was last asked for
+    };
+
+    /// A texture on its way to the GPU
+    struct PendingTexture
+    {
+        GLint              handle;         /// Resolves to the fallback meanwhile
+        bool               alpha;          /// RGBA if set, RGB otherwise
+        std::string        path;
+        std::future<Image> decode;         /// Result of the background decode
+        Image              image;          /// Valid once decode was read
+        unsigned           firstLevel = 0; /// Finest level staged, those finer have no storage yet
+        std::size_t        bytesStaged = 0; /// Bytes of image already copied to the pixel buffer
+    };
+
+    ThreadPool* mThreadPool;
+    bool        mCompress;                                /// Block compressed textures are supported
+    std::unordered_map<std::string, GLint> mTextures;    /// Handles by path
+    std::vector<TextureRecord> mRecords;                  /// Records by handle
+    std::vector<TextureArray> mArrays;                    /// The fallback's first
+    std::list<std::shared_ptr<PendingTexture>> mPending; /// Textures still showing their fallback
+    GLuint mPixelBuffer;                                  /// Staging buffer of the texture being uploaded
+    GLuint mStreamBuffer;                                 /// Staging buffer of the level being streamed in
+    unsigned int mFrame;                                  /// Frames processed so far
+    std::size_t  mBudgetBytes;                            /// 0 for no limit
+    unsigned int mIdleFrames;
+    std::size_t  mBytesUsed;                              /// Allocated by the arrays
+    std::size_t  mPeakBytesUsed;
+
+    /// Decodes the image of a texture file. Compressed images come from the
+    /// cooked file when it's up to date, otherwise they are cooked for the next run
+    static Image Decode(const std::string& filepath, bool alpha, bool compress);
+
+    /// Starts loading the texture with given handle
+    void Queue(GLint handle);
+
+    /// Evicts the least recently used arrays whose textures are all idle,
+    /// until the store is under budget or none is left
+    void Evict();
+
+    /// Moves decoded images to the GPU until the budget runs out
+    void UploadPending(std::size_t& budgetBytes);
+
+    /// Streams the mip levels of every array toward the finest one it was asked for,
+    /// a level or a layer at a time. Given frameBudgetBytes is all ProcessUploads had
+    void Stream(std::size_t& budgetBytes, std::size_t frameBudgetBytes);
+
+    /// Starts reading back the image of the texture with given handle, unless it's read already
+    void LoadDetail(GLint handle);
+
+    /// Drops the images read back for the textures of given array
+    void ReleaseDetail(const TextureArray& array);
+
+    /// Retrieves the array with given id, null if there's none
+    TextureArray* GetArray(GLuint id);
+
+    /// Retrieves an array with a free layer for given image, null if there's none
+    TextureArray* MatchArray(const Image& image, bool alpha);
+
+    /// Retrieves an array with a free layer for given image, creating it if needed
+    TextureArray& FindArray(const Image& image, bool alpha);
+
+    /// Gives storage to given level of the bound array, or frees it. No pixel buffer must be bound
+    static void AllocateLevel(const TextureArray& array, unsigned level, bool allocate);
+
+    /// Does one bounded piece of work of an upload. Returns true when it's done
+    bool UploadStep(PendingTexture& texture, std::size_t& budgetBytes);
 
 }; //~ TextureStore
 
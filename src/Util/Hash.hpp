@@ -0,0 +1,34 @@
+#ifndef ELESWORD_HASH_HPP
+#define ELESWORD_HASH_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+namespace Hash
+{
+    const std::uint64_t FnvOffsetBasis = 14695981039346656037ULL;
+    const std::uint64_t FnvPrime       = 1099511628211ULL;
+
+    /// 64bit FNV-1a over a block of memory. Pass the previous result as seed to chain blocks
+    inline std::uint64_t Fnv1a(const void* data, std::size_t size, std::uint64_t seed = FnvOffsetBasis)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        std::uint64_t hash = seed;
+        for(std::size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= FnvPrime;
+        }
+        return hash;
+    }
+
+    /// 64bit FNV-1a over a string
+    inline std::uint64_t Fnv1a(const std::string& str, std::uint64_t seed = FnvOffsetBasis)
+    {
+        return Fnv1a(str.data(), str.size(), seed);
+    }
+
+} //~ namespace Hash
+
+#endif //~ ELESWORD_HASH_HPP
\ No newline at end of file
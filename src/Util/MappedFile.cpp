@@ -0,0 +1,157 @@
+#include "MappedFile.hpp"
+#include <utility>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//--------------------------------------------------
+// public functions
+//--------------------------------------------------
+MappedFile::MappedFile()
+    : mData(nullptr)
+    , mSize(0)
+#ifdef _WIN32
+    , mFile(nullptr)
+    , mMapping(nullptr)
+#endif
+{
+}
+
+MappedFile::MappedFile(MappedFile&& other)
+    : MappedFile()
+{
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other)
+{
+    if(this != &other)
+    {
+        Close();
+
+        mData = other.mData;
+        mSize = other.mSize;
+        other.mData = nullptr;
+        other.mSize = 0;
+
+#ifdef _WIN32
+        mFile = other.mFile;
+        mMapping = other.mMapping;
+        other.mFile = nullptr;
+        other.mMapping = nullptr;
+#endif
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+bool MappedFile::Open(const std::string& filepath)
+{
+    Close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(
+        filepath.c_str(),
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+        nullptr);
+    if(file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(mapping == nullptr)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if(view == nullptr)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    mFile = file;
+    mMapping = mapping;
+    mData = static_cast<const unsigned char*>(view);
+    mSize = (std::size_t)size.QuadPart;
+#else
+    int fd = open(filepath.c_str(), O_RDONLY);
+    if(fd < 0)
+        return false;
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    void* view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps its own reference to the file
+    close(fd);
+    if(view == MAP_FAILED)
+        return false;
+
+    mData = static_cast<const unsigned char*>(view);
+    mSize = (std::size_t)st.st_size;
+#endif
+
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if(mData == nullptr)
+        return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(mData);
+    CloseHandle(mMapping);
+    CloseHandle(mFile);
+    mMapping = nullptr;
+    mFile = nullptr;
+#else
+    munmap(const_cast<unsigned char*>(mData), mSize);
+#endif
+
+    mData = nullptr;
+    mSize = 0;
+}
+
+bool MappedFile::IsOpen() const
+{
+    return mData != nullptr;
+}
+
+const unsigned char* MappedFile::Data() const
+{
+    return mData;
+}
+
+std::size_t MappedFile::Size() const
+{
+    return mSize;
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#ifndef ELESWORD_MAPPED_FILE_HPP
+#define ELESWORD_MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <string>
+
+/// Read only memory mapping of a whole file
+class MappedFile
+{
+public:
+    /// Default Constructor
+    MappedFile();
+
+    /// Disable copy construction
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /// Enable move construction
+    MappedFile(MappedFile&& other);
+    MappedFile& operator=(MappedFile&& other);
+
+    /// Destructor
+    ~MappedFile();
+
+    /// Maps the file with given path. Returns false if the file can't be opened or is empty
+    bool Open(const std::string& filepath);
+
+    /// Unmaps the file, if mapped
+    void Close();
+
+    /// Shows if a file is currently mapped
+    bool IsOpen() const;
+
+    /// Retrieves the start of the mapped bytes
+    const unsigned char* Data() const;
+
+    /// Retrieves the number of mapped bytes
+    std::size_t Size() const;
+
+private:
+    const unsigned char* mData;   /// Start of the mapping
+    std::size_t          mSize;   /// Size of the mapping in bytes
+
+#ifdef _WIN32
+    void* mFile;                  /// File HANDLE
+    void* mMapping;               /// File mapping HANDLE
+#endif
+
+}; //~ MappedFile
+
+#endif //~ ELESWORD_MAPPED_FILE_HPP
\ No newline at end of file
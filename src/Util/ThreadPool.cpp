@@ -0,0 +1,111 @@
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <atomic>
+
+//--------------------------------------------------
+// public functions
+//--------------------------------------------------
+ThreadPool::ThreadPool(unsigned int threadCount)
+    : mStop(false)
+{
+    if(threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    for(unsigned int i = 0; i < threadCount; i++)
+        mWorkers.emplace_back(&ThreadPool::WorkerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStop = true;
+    }
+    mWakeUp.notify_all();
+
+    for(std::thread& worker : mWorkers)
+        worker.join();
+}
+
+void ThreadPool::ParallelFor(std::size_t count, const std::function<void(std::size_t)>& body)
+{
+    if(count == 0)
+        return;
+
+    // Shared between the caller and the helpers. Helpers that start after all the
+    // work is claimed just return, so the state has to outlive this call.
+    struct State
+    {
+        std::atomic<std::size_t> next;
+        std::atomic<std::size_t> done;
+        std::size_t              count;
+        std::function<void(std::size_t)> body;
+        std::mutex               mutex;
+        std::condition_variable  finished;
+    };
+    auto state = std::make_shared<State>();
+    state->next = 0;
+    state->done = 0;
+    state->count = count;
+    state->body = body;
+
+    auto work = [state]()
+    {
+        std::size_t i;
+        while((i = state->next++) < state->count)
+        {
+            state->body(i);
+            if(++state->done == state->count)
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->finished.notify_all();
+            }
+        }
+    };
+
+    // One helper per worker at most, the calling thread takes a share too
+    std::size_t helpers = std::min<std::size_t>(mWorkers.size(), count - 1);
+    for(std::size_t i = 0; i < helpers; i++)
+        Enqueue(work);
+
+    work();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(lock, [&state]() { return state->done == state->count; });
+}
+
+unsigned int ThreadPool::GetThreadCount() const
+{
+    return (unsigned int)mWorkers.size();
+}
+
+//--------------------------------------------------
+// private functions
+//--------------------------------------------------
+void ThreadPool::Enqueue(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mTasks.push_back(std::move(task));
+    }
+    mWakeUp.notify_one();
+}
+
+void ThreadPool::WorkerLoop()
+{
+    for(;;)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mWakeUp.wait(lock, [this]() { return mStop || !mTasks.empty(); });
+
+            if(mStop && mTasks.empty())
+                return;
+
+            task = std::move(mTasks.front());
+            mTasks.pop_front();
+        }
+        task();
+    }
+}
\ No newline at end of file
@@ -0,0 +1,67 @@
+#ifndef ELESWORD_THREAD_POOL_HPP
+#define ELESWORD_THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/// Fixed size pool of worker threads fed from a FIFO task queue
+class ThreadPool
+{
+public:
+    /// Constructor. A thread count of 0 uses one worker per hardware thread
+    explicit ThreadPool(unsigned int threadCount = 0);
+
+    /// Disable copy construction
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /// Destructor. Finishes the queued tasks and joins the workers
+    ~ThreadPool();
+
+    /// Queues a task and returns a future to its result
+    template <typename Task>
+    std::future<typename std::result_of<Task()>::type> Submit(Task&& task);
+
+    /// Runs body(i) for every i in [0, count) on the pool and the calling thread.
+    /// Returns when all iterations are done. Safe to call from a worker thread.
+    void ParallelFor(std::size_t count, const std::function<void(std::size_t)>& body);
+
+    /// Retrieves the number of worker threads
+    unsigned int GetThreadCount() const;
+
+private:
+    std::vector<std::thread>          mWorkers;   /// Worker threads
+    std::deque<std::function<void()>> mTasks;     /// Queued tasks
+    std::mutex                        mMutex;     /// Guards mTasks and mStop
+    std::condition_variable           mWakeUp;    /// Signaled when a task is queued or on stop
+    bool                              mStop;      /// Set on destruction
+
+    /// Pushes a type erased task to the queue
+    void Enqueue(std::function<void()> task);
+
+    /// Worker thread body
+    void WorkerLoop();
+
+}; //~ ThreadPool
+
+template <typename Task>
+std::future<typename std::result_of<Task()>::type> ThreadPool::Submit(Task&& task)
+{
+    using Result = typename std::result_of<Task()>::type;
+
+    // std::function needs copyable targets, so keep the packaged task on the heap
+    auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<Task>(task));
+    std::future<Result> result = packaged->get_future();
+    Enqueue([packaged]() { (*packaged)(); });
+    return result;
+}
+
+#endif //~ ELESWORD_THREAD_POOL_HPP
\ No newline at end of file